@@ -0,0 +1,244 @@
+#define _GNU_SOURCE //Per utmpxname()
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per i codici di errore
+#include <fcntl.h> //Per open()
+#include <ftw.h> //Per la rimozione ricorsiva delle fixture
+#include <time.h> //Per clock_gettime()
+#include <unistd.h> //Per fork() ed execv()
+#include <utmpx.h> //Per la struttura utmpx
+#include <sys/resource.h> //Per getrusage()
+#include <sys/stat.h> //Per mkdir()
+#include <sys/wait.h> //Per waitpid()
+#include "../finger.h"
+
+/*
+ * Synthetic-load benchmark for the query paths of myFinger.
+ *
+ * For every size a fixture directory is generated: a utmpx file with N
+ * USER_PROCESS sessions (read through utmpxname()), a passwd file with N/4
+ * users, terminal nodes under dev/, mailboxes under mail/ and homes with
+ * `.plan` files. Each path (default listing, handleUser() for every user,
+ * -ls) runs in a fresh process so the peak RSS belongs to that path alone.
+ *
+ * Output, one line per size and path:
+ *   sessions=N path=P load_ns_per_session=X ns_per_session=Y peak_rss_kb=Z
+ */
+
+#define BENCH_MAX_TTYS 4096    /**< Terminal nodes shared by the sessions */
+#define BENCH_MAX_HOMES 1024   /**< Home directories shared by the users */
+#define BENCH_MAX_MAILBOXES 65536 /**< Mailboxes created (one user in eight) */
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ *
+ * @return The time in nanoseconds.
+ */
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Creates a file with the given contents, exiting on error.
+ *
+ * @param path The path of the file.
+ * @param data The contents.
+ * @param len The length of the contents.
+ */
+static void writeFixture(const char *path, const char *data, size_t len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, data, len) != (ssize_t)len) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
+
+/**
+ * Generates the fixtures for a number of sessions.
+ *
+ * @param dir The fixture directory (created).
+ * @param sessions The number of sessions.
+ */
+static void generateFixtures(const char *dir, size_t sessions) {
+    size_t users = sessions / 4 ? sessions / 4 : 1;
+    size_t ttys = sessions < BENCH_MAX_TTYS ? sessions : BENCH_MAX_TTYS;
+    size_t homes = users < BENCH_MAX_HOMES ? users : BENCH_MAX_HOMES;
+    time_t base = time(NULL);
+    char path[512];
+
+    mkdir(dir, 0755);
+    snprintf(path, sizeof(path), "%s/dev", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/dev/pts", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/mail", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/home", dir);
+    mkdir(path, 0755);
+
+    //Terminali con tempi di accesso diversi, per avere tempi di inattività diversi
+    for (size_t t = 0; t < ttys; t++) {
+        snprintf(path, sizeof(path), "%s/dev/pts/%zu", dir, t);
+        writeFixture(path, "", 0);
+        struct timespec times[2] = {{base - (time_t)(t * 37 % 200000), 0}, {base - 1, 0}};
+        utimensat(AT_FDCWD, path, times, 0);
+    }
+    for (size_t h = 0; h < homes; h++) {
+        snprintf(path, sizeof(path), "%s/home/h%zu", dir, h);
+        mkdir(path, 0755);
+        if (h % 2 == 0) {
+            static const char plan[] = "Benchmarking myFinger.\nSecond line of the plan.\n";
+            snprintf(path, sizeof(path), "%s/home/h%zu/.plan", dir, h);
+            writeFixture(path, plan, sizeof(plan) - 1);
+        }
+    }
+
+    //File passwd: un utente ogni quattro sessioni, GECOS completo per un utente su due
+    FILE *passwd;
+    snprintf(path, sizeof(path), "%s/passwd", dir);
+    passwd = fopen(path, "w");
+    if (passwd == NULL) {
+        perror(path);
+        exit(1);
+    }
+    for (size_t u = 0; u < users; u++) {
+        fprintf(passwd, "u%zu:x:%zu:%zu:%s%zu%s:%s/home/h%zu:/bin/sh\n", u, 10000 + u, 10000 + u,
+                "User ", u, u % 2 ? ",Room 1,0612345678" : "", dir, u % homes);
+        if (u % 8 == 0 && u / 8 < BENCH_MAX_MAILBOXES) {
+            snprintf(path, sizeof(path), "%s/mail/u%zu", dir, u);
+            writeFixture(path, "From bench\n", 11);
+        }
+    }
+    fclose(passwd);
+
+    //Tabella utmpx scritta direttamente nel formato su disco
+    struct utmpx *records = calloc(sessions, sizeof(struct utmpx));
+    if (records == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (size_t i = 0; i < sessions; i++) {
+        struct utmpx *ut = &records[i];
+        ut->ut_type = USER_PROCESS;
+        ut->ut_pid = 1000 + i % 30000;
+        snprintf(ut->ut_line, sizeof(ut->ut_line), "pts/%zu", i % ttys);
+        snprintf(ut->ut_id, sizeof(ut->ut_id), "%zu", i % 1000);
+        snprintf(ut->ut_user, sizeof(ut->ut_user), "u%zu", i % users);
+        ut->ut_tv.tv_sec = base - (time_t)(i % 86400);
+    }
+    snprintf(path, sizeof(path), "%s/utmp", dir);
+    writeFixture(path, (const char *)records, sessions * sizeof(struct utmpx));
+    free(records);
+}
+
+/**
+ * Callback of nftw() that removes a file or an empty directory.
+ */
+static int removeEntry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+/**
+ * Runs one path on the fixtures and prints its line. Executed in a fresh process.
+ *
+ * @param dir The fixture directory.
+ * @param sessions The number of sessions in the fixtures.
+ * @param pathName "list", "user" or "ls".
+ * @return 0 on success, 1 on error.
+ */
+static int runPath(const char *dir, size_t sessions, const char *pathName) {
+    SessionIndex index;
+    PasswdCache cache;
+    char utmp[512], passwd[512], devDir[512], mailDir[512];
+    snprintf(utmp, sizeof(utmp), "%s/utmp", dir);
+    snprintf(passwd, sizeof(passwd), "%s/passwd", dir);
+    snprintf(devDir, sizeof(devDir), "%s/dev", dir);
+    snprintf(mailDir, sizeof(mailDir), "%s/mail", dir);
+
+    //Caricamento: tabella utmpx e passwd delle fixture
+    double start = nowNs();
+    if (utmpxname(utmp) != 0 || loadSessionIndex(&index) != 0 || initPasswdCache(&cache) != 0 ||
+        preloadPasswdCacheFile(&cache, passwd) < 0) {
+        fprintf(stderr, "fingerbench: unable to load %s\n", dir);
+        return 1;
+    }
+    double loaded = nowNs();
+
+    FingerContext ctx = {&index, &cache, NULL, EXPORT_TEXT, devDir, mailDir};
+    OutBuf out;
+    int devNull = open("/dev/null", O_WRONLY);
+    initOutBuf(&out, devNull);
+
+    if (strcmp(pathName, "list") == 0) {
+        listLoggedUsers(&out, &ctx, 0);
+    } else if (strcmp(pathName, "user") == 0) {
+        for (size_t u = 0; u < index.userCount; u++) handleUser(&out, &ctx, index.users[u].login, 0);
+    } else {
+        listUsersDetailed(&out, &ctx);
+    }
+    outFlush(&out);
+    double done = nowNs();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("sessions=%zu path=%s load_ns_per_session=%.1f ns_per_session=%.1f peak_rss_kb=%ld\n",
+           sessions, pathName, (loaded - start) / sessions, (done - loaded) / sessions, usage.ru_maxrss);
+
+    freeOutBuf(&out);
+    close(devNull);
+    freePasswdCache(&cache);
+    freeSessionIndex(&index);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    static const char *const paths[] = {"list", "user", "ls"};
+    const char *base = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+
+    //Processo figlio: fingerbench --run DIR SESSIONS PATH
+    if (argc == 5 && strcmp(argv[1], "--run") == 0) {
+        return runPath(argv[2], strtoul(argv[3], NULL, 10), argv[4]);
+    }
+
+    static char *const defaults[] = {"10", "1000", "100000", "1000000"};
+    char *const *sizes = argc > 1 ? argv + 1 : defaults;
+    int sizeCount = argc > 1 ? argc - 1 : 4;
+    int status = 0;
+
+    for (int s = 0; s < sizeCount; s++) {
+        size_t sessions = strtoul(sizes[s], NULL, 10);
+        char dir[512];
+        if (sessions == 0) {
+            fprintf(stderr, "Usage: fingerbench [sessions ...]\n");
+            return 1;
+        }
+        snprintf(dir, sizeof(dir), "%s/myfinger-bench-%zu-%d", base, sessions, (int)getpid());
+        generateFixtures(dir, sessions);
+        fflush(stdout);
+
+        for (int p = 0; p < 3; p++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                char count[32];
+                snprintf(count, sizeof(count), "%zu", sessions);
+                char *args[] = {"/proc/self/exe", "--run", dir, count, (char *)paths[p], NULL};
+                execv("/proc/self/exe", args); //Processo nuovo: il picco di RSS è solo di questo percorso
+                _exit(127);
+            }
+            int wstatus;
+            if (pid < 0 || waitpid(pid, &wstatus, 0) < 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+                fprintf(stderr, "fingerbench: %s path failed for %zu sessions\n", paths[p], sessions);
+                status = 1;
+            }
+        }
+        nftw(dir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    return status;
+}
@@ -0,0 +1,194 @@
+#define _GNU_SOURCE
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per i codici di errore
+#include <time.h> //Per clock_gettime()
+#include <unistd.h> //Per close() e getopt()
+#include <arpa/inet.h> //Per inet_pton()
+#include <netinet/in.h> //Per gli indirizzi IPv4
+#include <sys/epoll.h> //Per il ciclo di eventi
+#include <sys/resource.h> //Per il limite dei descrittori aperti
+#include <sys/socket.h> //Per i socket
+
+/*
+ * Loopback load generator for `myFinger --serve`.
+ * Keeps a fixed number of queries in flight, one connection per query as in
+ * RFC 1288, and reports throughput and latency percentiles.
+ */
+
+/**
+ * A query in flight.
+ */
+typedef struct {
+    int fd;             /**< Client socket, -1 if the slot is idle */
+    size_t sent;        /**< Bytes of the query already sent */
+    double started;     /**< Start time of the query in seconds */
+} Slot;
+
+static struct sockaddr_in target;
+static const char *query = "\r\n";
+static size_t queryLen = 2;
+
+/**
+ * Returns the current monotonic time in seconds.
+ *
+ * @return The time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Starts a new query on a slot.
+ *
+ * @param epfd The epoll descriptor.
+ * @param slot The slot to use.
+ * @return 0 on success, -1 on error.
+ */
+static int startQuery(int epfd, Slot *slot) {
+    slot->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (slot->fd < 0) return -1;
+    slot->sent = 0;
+    slot->started = now();
+    if (connect(slot->fd, (struct sockaddr *)&target, sizeof(target)) != 0 && errno != EINPROGRESS) {
+        close(slot->fd);
+        slot->fd = -1;
+        return -1;
+    }
+    struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = slot};
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, slot->fd, &ev);
+}
+
+/**
+ * Compares two latencies for qsort().
+ */
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int port = 7979, concurrency = 100;
+    long total = 10000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "h:p:c:n:q:")) != -1) {
+        switch (opt) {
+            case 'h': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'c': concurrency = atoi(optarg); break;
+            case 'n': total = atol(optarg); break;
+            case 'q': {
+                //La richiesta va terminata con CRLF come previsto da RFC 1288
+                char *q = malloc(strlen(optarg) + 3);
+                sprintf(q, "%s\r\n", optarg);
+                query = q;
+                queryLen = strlen(q);
+                break;
+            }
+            default:
+                fprintf(stderr, "Usage: fingerload [-h host] [-p port] [-c concurrency] [-n requests] [-q query]\n");
+                return 1;
+        }
+    }
+    if (concurrency <= 0 || total <= 0) {
+        fprintf(stderr, "fingerload: concurrency and requests must be positive\n");
+        return 1;
+    }
+    if (concurrency > total) concurrency = total;
+
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &target.sin_addr) != 1) {
+        fprintf(stderr, "fingerload: invalid IPv4 address %s\n", host);
+        return 1;
+    }
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    Slot *slots = calloc(concurrency, sizeof(Slot));
+    double *latencies = malloc(total * sizeof(double));
+    struct epoll_event *events = malloc(concurrency * sizeof(struct epoll_event));
+    int epfd = epoll_create1(0);
+    if (slots == NULL || latencies == NULL || events == NULL || epfd < 0) {
+        perror("fingerload");
+        return 1;
+    }
+
+    long started = 0, completed = 0, errors = 0;
+    size_t bytes = 0;
+    char buf[65536];
+    double begin = now();
+
+    for (int i = 0; i < concurrency; i++) {
+        slots[i].fd = -1;
+        if (startQuery(epfd, &slots[i]) != 0) errors++;
+        started++;
+    }
+
+    while (completed + errors < total) {
+        int n = epoll_wait(epfd, events, concurrency, 5000);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            fprintf(stderr, "fingerload: no progress, giving up\n");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            Slot *slot = events[i].data.ptr;
+            int finished = 0, failed = 0;
+
+            if (events[i].events & EPOLLERR) {
+                failed = 1;
+            } else if (slot->sent < queryLen) {
+                ssize_t w = send(slot->fd, query + slot->sent, queryLen - slot->sent, MSG_NOSIGNAL);
+                if (w < 0) {
+                    failed = errno != EAGAIN;
+                } else if ((slot->sent += w) == queryLen) {
+                    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = slot};
+                    epoll_ctl(epfd, EPOLL_CTL_MOD, slot->fd, &ev);
+                }
+            } else {
+                //Legge la risposta fino alla chiusura da parte del server
+                for (;;) {
+                    ssize_t r = recv(slot->fd, buf, sizeof(buf), 0);
+                    if (r > 0) {
+                        bytes += r;
+                        continue;
+                    }
+                    if (r == 0) finished = 1;
+                    else if (errno != EAGAIN) failed = 1;
+                    break;
+                }
+            }
+
+            if (finished || failed) {
+                close(slot->fd);
+                slot->fd = -1;
+                if (finished) latencies[completed++] = now() - slot->started;
+                else errors++;
+                if (started < total) {
+                    started++;
+                    if (startQuery(epfd, slot) != 0) errors++;
+                }
+            }
+        }
+    }
+
+    double elapsed = now() - begin;
+    qsort(latencies, completed, sizeof(double), compareDouble);
+    double p50 = completed ? latencies[completed / 2] : 0;
+    double p99 = completed ? latencies[(size_t)(completed * 0.99) < (size_t)completed ? (size_t)(completed * 0.99) : completed - 1] : 0;
+
+    printf("requests=%ld errors=%ld concurrency=%d elapsed_s=%.3f rps=%.0f p50_us=%.0f p99_us=%.0f bytes=%zu\n",
+           completed, errors, concurrency, elapsed, completed / elapsed, p50 * 1e6, p99 * 1e6, bytes);
+    return errors != 0;
+}
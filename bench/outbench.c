@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <time.h> //Per clock_gettime()
+#include <unistd.h> //Per pipe(), fork() e getopt()
+#include <sys/wait.h> //Per waitpid()
+#include "../outbuf.h"
+
+/*
+ * Output benchmark: renders the default listing of myFinger for N synthetic
+ * sessions once with fprintf() (the previous output path) and once with the
+ * OutBuf writer, into a pipe drained by a child process as a log collector
+ * would. Reports time per row and number of write calls for both.
+ */
+
+/**
+ * One synthetic row of the listing.
+ */
+typedef struct {
+    char login[16], name[32], tty[16], idle[16], weekDay[16], hoursMinutes[16], office[16], phone[16];
+} Row;
+
+static unsigned long stdioWrites = 0;
+
+/**
+ * Write callback of the counting stdio stream.
+ *
+ * @param cookie Pointer to the destination descriptor.
+ * @param buf The data to write.
+ * @param size The number of bytes.
+ * @return The number of bytes written, or -1 on error.
+ */
+static ssize_t countingWrite(void *cookie, const char *buf, size_t size) {
+    stdioWrites++;
+    return write(*(int *)cookie, buf, size);
+}
+
+/**
+ * Returns the current monotonic time in seconds.
+ *
+ * @return The time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Starts a child that reads and discards everything from a pipe.
+ *
+ * @param writeEnd Receives the end of the pipe to write to.
+ * @return The pid of the child.
+ */
+static pid_t startDrain(int *writeEnd) {
+    int fds[2];
+    char buf[65536];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[1]);
+        while (read(fds[0], buf, sizeof(buf)) > 0) {
+        }
+        _exit(0);
+    }
+    close(fds[0]);
+    *writeEnd = fds[1];
+    return pid;
+}
+
+/**
+ * Renders the rows with fprintf(), as printUserInfo() and listLoggedUsers() did.
+ *
+ * @param rows The rows.
+ * @param count The number of rows.
+ * @return The elapsed time in seconds.
+ */
+static double runStdio(const Row *rows, size_t count) {
+    int fd;
+    pid_t pid = startDrain(&fd);
+    cookie_io_functions_t io = {.write = countingWrite};
+    FILE *out = fopencookie(&fd, "w", io);
+    setvbuf(out, NULL, _IOFBF, 4096); //Dimensione scelta da stdio per una pipe (st_blksize)
+
+    double start = now();
+    fprintf(out, "%-15s %-10s %-6s %-8s %-10s %-10s %-10s %-12s\n",
+            "Login", "Name", "TTY", "Idle", "Login", "Time", "Office", "Phone");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%-15s %-10s %-5s %-8s %-10s %-10s %-10s %-12s\n",
+                rows[i].login, rows[i].name, rows[i].tty, rows[i].idle,
+                rows[i].weekDay, rows[i].hoursMinutes, rows[i].office, rows[i].phone);
+    }
+    fclose(out);
+    double elapsed = now() - start;
+    close(fd);
+    waitpid(pid, NULL, 0);
+    return elapsed;
+}
+
+/**
+ * Renders the rows with the OutBuf writer.
+ *
+ * @param rows The rows.
+ * @param count The number of rows.
+ * @param writes Receives the number of writev() calls.
+ * @return The elapsed time in seconds.
+ */
+static double runOutBuf(const Row *rows, size_t count, unsigned long *writes) {
+    static const int head[] = {15, 10, 6, 8, 10, 10, 10, 12};
+    static const int widths[] = {15, 10, 5, 8, 10, 10, 10, 12};
+    static const char *const titles[] = {"Login", "Name", "TTY", "Idle", "Login", "Time", "Office", "Phone"};
+    int fd;
+    pid_t pid = startDrain(&fd);
+    OutBuf out;
+    initOutBuf(&out, fd);
+
+    double start = now();
+    for (int c = 0; c < 8; c++) {
+        if (c < 7) outColumn(&out, titles[c], head[c]);
+        else outPad(&out, titles[c], head[c]);
+    }
+    outPutc(&out, '\n');
+    for (size_t i = 0; i < count; i++) {
+        const char *fields[] = {rows[i].login, rows[i].name, rows[i].tty, rows[i].idle,
+                                rows[i].weekDay, rows[i].hoursMinutes, rows[i].office, rows[i].phone};
+        for (int c = 0; c < 7; c++) outColumn(&out, fields[c], widths[c]);
+        outPad(&out, fields[7], widths[7]);
+        outPutc(&out, '\n');
+    }
+    outFlush(&out);
+    double elapsed = now() - start;
+    *writes = out.writes;
+    freeOutBuf(&out);
+    close(fd);
+    waitpid(pid, NULL, 0);
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    size_t count = 10000;
+    int rounds = 5, opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        if (opt == 'n') count = strtoul(optarg, NULL, 10);
+        else if (opt == 'r') rounds = atoi(optarg);
+        else {
+            fprintf(stderr, "Usage: outbench [-n rows] [-r rounds]\n");
+            return 1;
+        }
+    }
+
+    Row *rows = calloc(count ? count : 1, sizeof(Row));
+    if (rows == NULL) return 1;
+    for (size_t i = 0; i < count; i++) {
+        snprintf(rows[i].login, sizeof(rows[i].login), "user%zu", i % 5000);
+        snprintf(rows[i].name, sizeof(rows[i].name), "User %zu", i % 5000);
+        snprintf(rows[i].tty, sizeof(rows[i].tty), "*pts/%zu", i % 1000);
+        snprintf(rows[i].idle, sizeof(rows[i].idle), "%zu:%02zu", i % 24, i % 60);
+        strcpy(rows[i].weekDay, "Oct 17");
+        snprintf(rows[i].hoursMinutes, sizeof(rows[i].hoursMinutes), "%02zu:%02zu", i % 24, i % 60);
+        strcpy(rows[i].office, i % 3 ? "" : "Room 12");
+        strcpy(rows[i].phone, i % 3 ? "" : "061-234-5678");
+    }
+
+    //Miglior tempo su più ripetizioni per ciascun percorso
+    double bestStdio = 0, bestOut = 0;
+    unsigned long outWrites = 0, stdioPerRun = 0;
+    for (int r = 0; r < rounds; r++) {
+        stdioWrites = 0;
+        double t = runStdio(rows, count);
+        stdioPerRun = stdioWrites;
+        if (r == 0 || t < bestStdio) bestStdio = t;
+        t = runOutBuf(rows, count, &outWrites);
+        if (r == 0 || t < bestOut) bestOut = t;
+    }
+
+    double div = count ? (double)count : 1;
+    printf("rows=%zu printf_ns_row=%.1f printf_writes=%lu outbuf_ns_row=%.1f outbuf_writes=%lu speedup=%.2f\n",
+           count, bestStdio * 1e9 / div, stdioPerRun, bestOut * 1e9 / div, outWrites,
+           bestOut > 0 ? bestStdio / bestOut : 0);
+    free(rows);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <time.h> //Per time()
+#include <pthread.h> //Per i thread concorrenti
+#include "../lib.h"
+
+/*
+ * Stress test for the reentrant formatters of lib.h.
+ *
+ * Every _r function is called once on a fixed set of inputs in a single
+ * thread to build the reference output. Then REENTRANT_THREADS threads format
+ * the same inputs concurrently, each starting at a different offset, for
+ * REENTRANT_ROUNDS rounds, and every result is compared with the reference.
+ * The inputs cover idle times from seconds to years and login times over the
+ * last year, so the per-thread caches of timefmt change hour and day.
+ *
+ * Usage: reentrant [rounds]
+ * Exit status 0 if every result matches, 1 otherwise.
+ */
+
+#define REENTRANT_THREADS 16   /**< Concurrent threads */
+#define REENTRANT_ROUNDS 50    /**< Default passes of each thread over the inputs */
+#define REENTRANT_INPUTS 2048  /**< Inputs per function */
+#define REENTRANT_FUNCTIONS 6  /**< Formatters checked */
+#define REENTRANT_LEN 64       /**< Size of every output buffer */
+
+/**
+ * Inputs and reference output shared by the threads.
+ */
+typedef struct {
+    double seconds[REENTRANT_INPUTS];  /**< Idle times */
+    time_t times[REENTRANT_INPUTS];    /**< Login times */
+    char expected[REENTRANT_FUNCTIONS][REENTRANT_INPUTS][REENTRANT_LEN]; /**< Single-threaded results */
+    unsigned long rounds;              /**< Passes of each thread */
+} Fixture;
+
+/**
+ * A thread and its count of wrong results.
+ */
+typedef struct {
+    const Fixture *fixture;   /**< Shared inputs */
+    size_t offset;            /**< First input of every pass */
+    unsigned long mismatches; /**< Results different from the reference */
+} Worker;
+
+static const char *const functionNames[REENTRANT_FUNCTIONS] = {
+    "getIdleTimeFormatted_r(short)", "getIdleTimeFormatted_r(detailed)", "calculateIdleTime_r",
+    "getCompleteIdle_r", "getWeekDayString_r", "getTimeHoursMinutes_r",
+};
+
+/**
+ * Formats one input with one of the functions.
+ *
+ * @param fixture The inputs.
+ * @param function The index of the function.
+ * @param i The index of the input.
+ * @param buf The buffer that receives the result.
+ */
+static void formatInput(const Fixture *fixture, int function, size_t i, char *buf) {
+    switch (function) {
+    case 0: getIdleTimeFormatted_r(fixture->seconds[i], false, buf, REENTRANT_LEN); break;
+    case 1: getIdleTimeFormatted_r(fixture->seconds[i], true, buf, REENTRANT_LEN); break;
+    case 2: calculateIdleTime_r(fixture->seconds[i], buf, REENTRANT_LEN); break;
+    case 3: getCompleteIdle_r(fixture->seconds[i], buf, REENTRANT_LEN); break;
+    case 4: getWeekDayString_r(fixture->times[i], buf, REENTRANT_LEN); break;
+    default: getTimeHoursMinutes_r(fixture->times[i], buf, REENTRANT_LEN); break;
+    }
+}
+
+/**
+ * Thread body: formats every input from its offset and counts the mismatches.
+ *
+ * @param arg The Worker.
+ * @return Always NULL.
+ */
+static void *runWorker(void *arg) {
+    Worker *worker = arg;
+    const Fixture *fixture = worker->fixture;
+    char buf[REENTRANT_LEN];
+
+    for (unsigned long round = 0; round < fixture->rounds; round++) {
+        for (size_t k = 0; k < REENTRANT_INPUTS; k++) {
+            size_t i = (worker->offset + k) % REENTRANT_INPUTS;
+            for (int function = 0; function < REENTRANT_FUNCTIONS; function++) {
+                memset(buf, 0, sizeof(buf));
+                formatInput(fixture, function, i, buf);
+                if (strcmp(buf, fixture->expected[function][i]) != 0) {
+                    if (worker->mismatches++ == 0) {
+                        fprintf(stderr, "%s input %zu: \"%s\" instead of \"%s\"\n", functionNames[function], i,
+                                buf, fixture->expected[function][i]);
+                    }
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    Fixture *fixture = calloc(1, sizeof(Fixture));
+    Worker workers[REENTRANT_THREADS];
+    pthread_t threads[REENTRANT_THREADS];
+    time_t now = time(NULL);
+    unsigned long mismatches = 0;
+
+    if (fixture == NULL) {
+        perror("reentrant");
+        return 1;
+    }
+    fixture->rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : REENTRANT_ROUNDS;
+
+    //Tempi di inattività da pochi secondi a oltre un anno, istanti sparsi sull'ultimo anno
+    srand(1288);
+    for (size_t i = 0; i < REENTRANT_INPUTS; i++) {
+        double scale = (double)(1UL << (i % 26));
+        fixture->seconds[i] = scale * (rand() % 1000) / 1000.0 + (i % 26);
+        fixture->times[i] = now - (time_t)(rand() % (366 * 24)) * 3600 - rand() % 3600;
+    }
+    for (int function = 0; function < REENTRANT_FUNCTIONS; function++) {
+        for (size_t i = 0; i < REENTRANT_INPUTS; i++) {
+            formatInput(fixture, function, i, fixture->expected[function][i]);
+        }
+    }
+
+    size_t started = 0;
+    for (; started < REENTRANT_THREADS; started++) {
+        workers[started] = (Worker){fixture, started * REENTRANT_INPUTS / REENTRANT_THREADS, 0};
+        if (pthread_create(&threads[started], NULL, runWorker, &workers[started]) != 0) break;
+    }
+    for (size_t t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+        mismatches += workers[t].mismatches;
+    }
+
+    printf("threads=%zu calls=%lu mismatches=%lu\n", started,
+           (unsigned long)started * fixture->rounds * REENTRANT_INPUTS * REENTRANT_FUNCTIONS, mismatches);
+    free(fixture);
+    return started == REENTRANT_THREADS && mismatches == 0 ? 0 : 1;
+}
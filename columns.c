@@ -0,0 +1,223 @@
+#include <stdio.h> //Per snprintf()
+#include <string.h> //Per operazioni sulle stringhe
+#include "columns.h"
+#include "lib.h"
+#include "timefmt.h"
+#include "stats.h"
+
+/**
+ * Description of a column.
+ */
+typedef struct {
+    const char *key;     /**< Name of the column in -o */
+    const char *header;  /**< Text of the header */
+    int width;           /**< Width of the values */
+    int headWidth;       /**< Width of the header */
+    unsigned needs;      /**< COLUMN_NEEDS_* of the values */
+} ColumnSpec;
+
+/**
+ * Every column, in the order of ColumnKind.
+ */
+static const ColumnSpec columnSpecs[COLUMN_KIND_COUNT] = {
+    [COLUMN_LOGIN] = {"login", "Login", 15, 15, 0},
+    [COLUMN_NAME] = {"name", "Name", 10, 10, COLUMN_NEEDS_GECOS},
+    [COLUMN_TTY] = {"tty", "TTY", 5, 6, 0},
+    [COLUMN_IDLE] = {"idle", "Idle", 8, 8, COLUMN_NEEDS_TTY},
+    [COLUMN_DIRECTORY] = {"directory", "Directory", 20, 20, 0},
+    [COLUMN_SHELL] = {"shell", "Shell", 20, 20, 0},
+    [COLUMN_DATE] = {"date", "Login", 10, 10, 0},
+    [COLUMN_TIME] = {"time", "Time", 10, 10, 0},
+    [COLUMN_OFFICE] = {"office", "Office", 10, 10, COLUMN_NEEDS_GECOS},
+    [COLUMN_PHONE] = {"phone", "Phone", 12, 12, COLUMN_NEEDS_GECOS},
+    [COLUMN_WHAT] = {"what", "What", 0, 0, COLUMN_NEEDS_TTY | COLUMN_NEEDS_PROCESS},
+};
+
+/**
+ * Width of the name in the rows of the users named on the command line.
+ */
+#define USER_NAME_WIDTH 15
+
+/**
+ * The columns of a mode.
+ */
+typedef struct {
+    char mode;                             /**< The mode, 0 for the default list */
+    int count;                             /**< Number of columns */
+    ColumnKind kinds[COLUMN_KIND_COUNT];   /**< The columns */
+} ModeColumns;
+
+/**
+ * Columns of every mode. The default list is the last entry.
+ */
+static const ModeColumns modeTable[] = {
+    {'s', 4, {COLUMN_LOGIN, COLUMN_NAME, COLUMN_TTY, COLUMN_IDLE}},
+    {'p', 6, {COLUMN_LOGIN, COLUMN_NAME, COLUMN_TTY, COLUMN_IDLE, COLUMN_DATE, COLUMN_TIME}},
+    {'l', 10, {COLUMN_LOGIN, COLUMN_NAME, COLUMN_TTY, COLUMN_IDLE, COLUMN_DIRECTORY, COLUMN_SHELL, COLUMN_DATE,
+               COLUMN_TIME, COLUMN_OFFICE, COLUMN_PHONE}},
+    {'w', 7, {COLUMN_LOGIN, COLUMN_NAME, COLUMN_TTY, COLUMN_IDLE, COLUMN_DATE, COLUMN_TIME, COLUMN_WHAT}},
+    {0, 8, {COLUMN_LOGIN, COLUMN_NAME, COLUMN_TTY, COLUMN_IDLE, COLUMN_DATE, COLUMN_TIME, COLUMN_OFFICE,
+            COLUMN_PHONE}},
+};
+
+#define MODE_COUNT (sizeof(modeTable) / sizeof(modeTable[0]))
+
+/**
+ * Appends a column to a layout.
+ *
+ * @param layout The layout.
+ * @param kind The column.
+ * @param width The width of its values.
+ * @return 0 on success, -1 if the layout is full.
+ */
+static int addColumn(ColumnLayout *layout, ColumnKind kind, int width) {
+    if (layout->count == COLUMN_MAX) return -1;
+    layout->kinds[layout->count] = kind;
+    layout->widths[layout->count] = width;
+    layout->count++;
+    layout->needs |= columnSpecs[kind].needs;
+    return 0;
+}
+
+/**
+ * Compiles the columns of a mode.
+ *
+ * @param layout The ColumnLayout structure to populate.
+ * @param mode The mode: 's', 'p', 'l', 'w' or any other for the default list.
+ * @param scope Where the table is printed.
+ * @return 0 on success, -1 if the mode has no table in the scope (long format).
+ */
+int modeColumns(ColumnLayout *layout, char mode, ColumnScope scope) {
+    const ModeColumns *columns = &modeTable[MODE_COUNT - 1];
+
+    for (size_t i = 0; i < MODE_COUNT - 1; i++) {
+        if (modeTable[i].mode == mode) columns = &modeTable[i];
+    }
+    //Per gli utenti indicati solo -s, -p e -l sono tabelle; le altre modalità usano il formato esteso
+    if (scope == COLUMN_SCOPE_USER && (columns->mode == 0 || columns->mode == 'w')) return -1;
+
+    memset(layout, 0, sizeof(*layout));
+    layout->markLocal = scope == COLUMN_SCOPE_LIST;
+    for (int i = 0; i < columns->count; i++) {
+        ColumnKind kind = columns->kinds[i];
+        int width = scope == COLUMN_SCOPE_USER && kind == COLUMN_NAME ? USER_NAME_WIDTH : columnSpecs[kind].width;
+        addColumn(layout, kind, width);
+    }
+    return 0;
+}
+
+/**
+ * Compiles a list of columns such as "login,tty,idle" for the list of the
+ * logged-in users.
+ *
+ * @param layout The ColumnLayout structure to populate.
+ * @param list The names of the columns, separated by commas.
+ * @return 0 on success, -1 if a name is unknown or there are too many columns.
+ */
+int parseColumns(ColumnLayout *layout, const char *list) {
+    memset(layout, 0, sizeof(*layout));
+    layout->markLocal = 1;
+
+    for (const char *p = list;; p++) {
+        size_t len = strcspn(p, ",");
+        int kind = 0;
+        while (kind < COLUMN_KIND_COUNT &&
+               (strlen(columnSpecs[kind].key) != len || strncmp(columnSpecs[kind].key, p, len) != 0)) {
+            kind++;
+        }
+        if (kind == COLUMN_KIND_COUNT || addColumn(layout, (ColumnKind)kind, columnSpecs[kind].width) != 0) return -1;
+        p += len;
+        if (*p == '\0') return 0;
+    }
+}
+
+/**
+ * Returns the value of a column for a session, formatting it only now.
+ *
+ * @param layout The columns.
+ * @param kind The column.
+ * @param table The session table.
+ * @param row The row of the session.
+ * @param buf Storage for the values that are formatted.
+ * @param size The size of the buffer.
+ * @return The value.
+ */
+static const char *columnValue(const ColumnLayout *layout, ColumnKind kind, const SessionTable *table, size_t row,
+                               char *buf, size_t size) {
+    const char *value = "";
+
+    switch (kind) {
+    case COLUMN_LOGIN:
+        return sessionString(table, table->login[row]);
+    case COLUMN_NAME:
+        return sessionString(table, table->name[row]);
+    case COLUMN_TTY:
+        value = sessionString(table, table->tty[row]);
+        //Nell'elenco i terminali locali sono marcati con "*"
+        if (layout->markLocal && (strcmp(value, "console") == 0 || strncmp(value, "pts", 3) == 0)) {
+            snprintf(buf, size, "*%s", value);
+            value = buf;
+        }
+        return value;
+    case COLUMN_IDLE:
+        buf[0] = '\0';
+        if (table->idleSeconds[row] >= 0) getIdleTimeFormatted_r(table->idleSeconds[row], false, buf, size);
+        return buf;
+    case COLUMN_DIRECTORY:
+        return sessionString(table, table->directory[row]);
+    case COLUMN_SHELL:
+        return sessionString(table, table->shell[row]);
+    case COLUMN_DATE:
+    case COLUMN_TIME:
+        STAT_BEGIN(STAT_PHASE_TIME);
+        if (kind == COLUMN_DATE) formatMonthDay(table->loginTime[row], buf, size);
+        else formatHoursMinutes(table->loginTime[row], buf, size);
+        STAT_END(STAT_PHASE_TIME);
+        return buf;
+    case COLUMN_OFFICE:
+        return sessionString(table, table->office[row]);
+    case COLUMN_PHONE:
+        return sessionString(table, table->phone[row]);
+    case COLUMN_WHAT:
+        return sessionString(table, table->what[row]);
+    case COLUMN_KIND_COUNT:
+        break;
+    }
+    return value;
+}
+
+/**
+ * Appends the header of a table.
+ *
+ * @param out The output buffer.
+ * @param layout The columns.
+ */
+void outColumnHeader(OutBuf *out, const ColumnLayout *layout) {
+    //Ogni campo allineato a sinistra nella sua colonna, l'ultimo senza spazio finale
+    for (int i = 0; i < layout->count; i++) {
+        const ColumnSpec *spec = &columnSpecs[layout->kinds[i]];
+        if (i < layout->count - 1) outColumn(out, spec->header, spec->headWidth);
+        else outPad(out, spec->header, spec->headWidth);
+    }
+    outPutc(out, '\n');
+}
+
+/**
+ * Appends a row of a table. Only the values of the columns of the layout
+ * are read or formatted.
+ *
+ * @param out The output buffer.
+ * @param layout The columns.
+ * @param table The session table.
+ * @param row The row of the session.
+ */
+void outColumnRow(OutBuf *out, const ColumnLayout *layout, const SessionTable *table, size_t row) {
+    char buf[64];
+
+    for (int i = 0; i < layout->count; i++) {
+        const char *value = columnValue(layout, layout->kinds[i], table, row, buf, sizeof(buf));
+        if (i < layout->count - 1) outColumn(out, value, layout->widths[i]);
+        else outPad(out, value, layout->widths[i]);
+    }
+    outPutc(out, '\n');
+}
@@ -0,0 +1,98 @@
+// columns.h
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include "outbuf.h"
+#include "sessiontable.h"
+
+/**
+ * Columns of the tables of sessions.
+ */
+typedef enum {
+    COLUMN_LOGIN,
+    COLUMN_NAME,
+    COLUMN_TTY,
+    COLUMN_IDLE,
+    COLUMN_DIRECTORY,
+    COLUMN_SHELL,
+    COLUMN_DATE,
+    COLUMN_TIME,
+    COLUMN_OFFICE,
+    COLUMN_PHONE,
+    COLUMN_WHAT,
+    COLUMN_KIND_COUNT
+} ColumnKind;
+
+/**
+ * Data a column needs besides utmpx, login, directory and shell: the rows
+ * are filled and probed only for the columns that are printed.
+ */
+#define COLUMN_NEEDS_GECOS 0x1    /**< Name, office and phone parsed from GECOS */
+#define COLUMN_NEEDS_TTY 0x2      /**< The terminal, read with stat() */
+#define COLUMN_NEEDS_PROCESS 0x4  /**< The foreground processes, read from /proc */
+
+/**
+ * Maximum number of columns of a table.
+ */
+#define COLUMN_MAX 16
+
+/**
+ * Where a table is printed.
+ */
+typedef enum {
+    COLUMN_SCOPE_LIST,  /**< List of the logged-in users, with a header and local terminals marked with "*" */
+    COLUMN_SCOPE_USER   /**< Rows of the users named on the command line, without a header */
+} ColumnScope;
+
+/**
+ * A compiled table: the columns in order, their widths and what they need.
+ */
+typedef struct {
+    ColumnKind kinds[COLUMN_MAX];  /**< The columns */
+    int widths[COLUMN_MAX];        /**< Width of each column in the rows */
+    int count;                     /**< Number of columns */
+    unsigned needs;                /**< COLUMN_NEEDS_* of all the columns */
+    int markLocal;                 /**< 1 to mark the local terminals with "*" */
+} ColumnLayout;
+
+/**
+ * Compiles the columns of a mode.
+ *
+ * @param layout The ColumnLayout structure to populate.
+ * @param mode The mode: 's', 'p', 'l', 'w' or any other for the default list.
+ * @param scope Where the table is printed.
+ * @return 0 on success, -1 if the mode has no table in the scope (long format).
+ */
+int modeColumns(ColumnLayout *layout, char mode, ColumnScope scope);
+
+/**
+ * Compiles a list of columns such as "login,tty,idle" for the list of the
+ * logged-in users. The names are the fields of --format=csv, except "date"
+ * and "time" for the login, plus "what" for the foreground command.
+ *
+ * @param layout The ColumnLayout structure to populate.
+ * @param list The names of the columns, separated by commas.
+ * @return 0 on success, -1 if a name is unknown or there are too many columns.
+ */
+int parseColumns(ColumnLayout *layout, const char *list);
+
+/**
+ * Appends the header of a table.
+ *
+ * @param out The output buffer.
+ * @param layout The columns.
+ */
+void outColumnHeader(OutBuf *out, const ColumnLayout *layout);
+
+/**
+ * Appends a row of a table. Only the values of the columns of the layout
+ * are read or formatted.
+ *
+ * @param out The output buffer.
+ * @param layout The columns.
+ * @param table The session table.
+ * @param row The row of the session.
+ */
+void outColumnRow(OutBuf *out, const ColumnLayout *layout, const SessionTable *table, size_t row);
+
+#endif
@@ -0,0 +1,315 @@
+#include <stdint.h> //Per i tipi a larghezza fissa
+#include <string.h> //Per operazioni sulle stringhe
+#include "export.h"
+
+/**
+ * Names of the text fields, in the order of SessionField: keys in JSON, columns in CSV.
+ */
+static const char *const fieldNames[SESSION_FIELD_COUNT] = {
+    "login", "name", "tty", "idle", "directory", "shell", "weekDay", "hoursMinutes", "office", "phone",
+};
+
+#define FIELD_COUNT SESSION_FIELD_COUNT
+
+/**
+ * Appends a signed integer in decimal.
+ *
+ * @param out The output buffer.
+ * @param value The value.
+ */
+static void outInteger(OutBuf *out, long long value) {
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    unsigned long long v = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+
+    //Cifre scritte da destra verso sinistra
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    if (value < 0) *--p = '-';
+    outWrite(out, p, buf + sizeof(buf) - p);
+}
+
+/**
+ * Returns the length of the UTF-8 sequence at the start of a string, rejecting
+ * overlong forms, surrogates and code points above U+10FFFF.
+ *
+ * @param s The string, starting with a byte of 0x80 or more.
+ * @param len The bytes available.
+ * @return The length of the sequence (2 to 4), or 0 if it is not valid UTF-8.
+ */
+static size_t utf8SequenceLength(const unsigned char *s, size_t len) {
+    size_t n;
+    unsigned char min = 0x80, max = 0xbf; //Intervallo ammesso per il secondo byte
+
+    if (s[0] >= 0xc2 && s[0] <= 0xdf) n = 2;
+    else if (s[0] >= 0xe0 && s[0] <= 0xef) n = 3;
+    else if (s[0] >= 0xf0 && s[0] <= 0xf4) n = 4;
+    else return 0; //Byte di continuazione isolato, forma troppo lunga o oltre U+10FFFF
+
+    if (s[0] == 0xe0) min = 0xa0;      //Forme troppo lunghe a tre byte
+    else if (s[0] == 0xed) max = 0x9f; //Surrogati U+D800-U+DFFF
+    else if (s[0] == 0xf0) min = 0x90; //Forme troppo lunghe a quattro byte
+    else if (s[0] == 0xf4) max = 0x8f; //Oltre U+10FFFF
+
+    if (len < n || s[1] < min || s[1] > max) return 0;
+    for (size_t i = 2; i < n; i++) {
+        if (s[i] < 0x80 || s[i] > 0xbf) return 0;
+    }
+    return n;
+}
+
+/**
+ * Appends a JSON string with its quotes, escaping quotes, backslashes and
+ * control characters. Bytes that are not valid UTF-8 (e.g. a GECOS field in
+ * Latin-1) become U+FFFD, so the document always parses.
+ *
+ * @param out The output buffer.
+ * @param s The string.
+ * @param len The length of the string.
+ */
+static void outJsonString(OutBuf *out, const char *s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    size_t start = 0;
+
+    outPutc(out, '"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') continue;
+        if (c >= 0x80) {
+            size_t n = utf8SequenceLength((const unsigned char *)s + i, len - i);
+            if (n > 0) {
+                i += n - 1;
+                continue;
+            }
+        }
+
+        //I tratti senza caratteri speciali sono copiati in un'unica scrittura
+        outWrite(out, s + start, i - start);
+        start = i + 1;
+        if (c >= 0x80) {
+            outWrite(out, "\\ufffd", 6);
+        } else if (c == '"' || c == '\\') {
+            char esc[2] = {'\\', c};
+            outWrite(out, esc, 2);
+        } else if (c == '\n') {
+            outWrite(out, "\\n", 2);
+        } else if (c == '\t') {
+            outWrite(out, "\\t", 2);
+        } else {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            outWrite(out, esc, 6);
+        }
+    }
+    outWrite(out, s + start, len - start);
+    outPutc(out, '"');
+}
+
+/**
+ * Appends a CSV field, quoted only if it contains a comma, a quote or a line break.
+ *
+ * @param out The output buffer.
+ * @param s The string.
+ * @param len The length of the string.
+ */
+static void outCsvField(OutBuf *out, const char *s, size_t len) {
+    size_t special = 0;
+    while (special < len && s[special] != ',' && s[special] != '"' && s[special] != '\r' && s[special] != '\n') {
+        special++;
+    }
+    if (special == len) {
+        outWrite(out, s, len);
+        return;
+    }
+
+    //Campo tra virgolette, con le virgolette interne raddoppiate
+    size_t start = 0;
+    outPutc(out, '"');
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] != '"') continue;
+        outWrite(out, s + start, i + 1 - start);
+        start = i;
+    }
+    outWrite(out, s + start, len - start);
+    outPutc(out, '"');
+}
+
+/**
+ * Appends an unsigned integer in little endian.
+ *
+ * @param out The output buffer.
+ * @param value The value.
+ * @param bytes The number of bytes to write (at most 8).
+ */
+static void outLittleEndian(OutBuf *out, uint64_t value, int bytes) {
+    char buf[8];
+    for (int i = 0; i < bytes; i++) buf[i] = (char)(value >> (8 * i));
+    outWrite(out, buf, bytes);
+}
+
+/**
+ * Parses the name of an output format.
+ *
+ * @param name The name given to --format ("text", "jsonl", "csv" or "bin").
+ * @param format Receives the format.
+ * @return 0 on success, -1 if the name is unknown.
+ */
+int parseExportFormat(const char *name, ExportFormat *format) {
+    static const char *const names[] = {"text", "jsonl", "csv", "bin"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *format = (ExportFormat)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Writes what precedes the records: the CSV header row or the binary stream header.
+ *
+ * @param out The buffer that receives the output.
+ * @param format The output format.
+ */
+void beginExport(OutBuf *out, ExportFormat format) {
+    if (format == EXPORT_CSV) {
+        for (size_t i = 0; i < FIELD_COUNT; i++) {
+            outPuts(out, fieldNames[i]);
+            outPutc(out, ',');
+        }
+        outPuts(out, "loginTime,idleSeconds,mail,mailAtime,mailMtime,plan,mailMessages\n");
+    } else if (format == EXPORT_BIN) {
+        outWrite(out, EXPORT_BIN_MAGIC, 4);
+        outLittleEndian(out, EXPORT_BIN_VERSION, 2);
+        outLittleEndian(out, 0, 2);
+    }
+}
+
+/**
+ * Serializes one session as a JSON object on a single line.
+ *
+ * @param out The output buffer.
+ * @param table The sessions of the query.
+ * @param row The row of the session.
+ * @param fields The text fields of the session.
+ */
+static void exportJson(OutBuf *out, const SessionTable *table, size_t row, const SessionRow *fields) {
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        outWrite(out, i == 0 ? "{\"" : ",\"", 2);
+        outPuts(out, fieldNames[i]);
+        outWrite(out, "\":", 2);
+        outJsonString(out, fields->text[i], fields->len[i]);
+    }
+    outPuts(out, ",\"loginTime\":");
+    outInteger(out, table->loginTime[row]);
+    outPuts(out, ",\"idleSeconds\":");
+    if (table->idleSeconds[row] < 0) outPuts(out, "null");
+    else outInteger(out, table->idleSeconds[row]);
+
+    //Posta e .plan solo se sono stati letti per questa modalità
+    if (table->withMailAndPlan) {
+        const FileProbe *mail = &table->mail[row];
+        if (mail->found) {
+            outPuts(out, ",\"mail\":{\"atime\":");
+            outInteger(out, mail->atime);
+            outPuts(out, ",\"mtime\":");
+            outInteger(out, mail->mtime);
+            outPuts(out, ",\"messages\":");
+            if (table->mailMessages[row] < 0) outPuts(out, "null");
+            else outInteger(out, table->mailMessages[row]);
+            outPutc(out, '}');
+        } else {
+            outPuts(out, ",\"mail\":null");
+        }
+        outPuts(out, table->plan[row].found ? ",\"plan\":true" : ",\"plan\":false");
+    }
+    outWrite(out, "}\n", 2);
+}
+
+/**
+ * Serializes one session as a CSV row.
+ *
+ * @param out The output buffer.
+ * @param table The sessions of the query.
+ * @param row The row of the session.
+ * @param fields The text fields of the session.
+ */
+static void exportCsv(OutBuf *out, const SessionTable *table, size_t row, const SessionRow *fields) {
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        outCsvField(out, fields->text[i], fields->len[i]);
+        outPutc(out, ',');
+    }
+    outInteger(out, table->loginTime[row]);
+    outPutc(out, ',');
+    if (table->idleSeconds[row] >= 0) outInteger(out, table->idleSeconds[row]);
+
+    //Colonne della posta e del .plan vuote se non sono stati letti
+    if (!table->withMailAndPlan) {
+        outPuts(out, ",,,,,\n");
+    } else if (table->mail[row].found) {
+        outPuts(out, ",1,");
+        outInteger(out, table->mail[row].atime);
+        outPutc(out, ',');
+        outInteger(out, table->mail[row].mtime);
+        outPuts(out, table->plan[row].found ? ",1," : ",0,");
+        if (table->mailMessages[row] >= 0) outInteger(out, table->mailMessages[row]);
+        outPutc(out, '\n');
+    } else {
+        outPuts(out, table->plan[row].found ? ",0,,,1,\n" : ",0,,,0,\n");
+    }
+}
+
+/**
+ * Serializes one session as a length-prefixed binary record.
+ *
+ * @param out The output buffer.
+ * @param table The sessions of the query.
+ * @param row The row of the session.
+ * @param fields The text fields of the session.
+ */
+static void exportBinary(OutBuf *out, const SessionTable *table, size_t row, const SessionRow *fields) {
+    size_t lengths[FIELD_COUNT];
+    uint32_t payload = 1 + 4 * 8 + 8;
+
+    //La lunghezza del record precede il contenuto: prima si misurano i campi
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        lengths[i] = fields->len[i] > UINT16_MAX ? UINT16_MAX : fields->len[i];
+        payload += 2 + lengths[i];
+    }
+
+    int flags = 0;
+    if (table->withMailAndPlan) {
+        flags |= 1;
+        if (table->mail[row].found) flags |= 2;
+        if (table->plan[row].found) flags |= 4;
+    }
+    outLittleEndian(out, payload, 4);
+    outLittleEndian(out, flags, 1);
+    outLittleEndian(out, (uint64_t)(int64_t)table->loginTime[row], 8);
+    outLittleEndian(out, (uint64_t)(int64_t)table->idleSeconds[row], 8);
+    outLittleEndian(out, (flags & 2) ? (uint64_t)(int64_t)table->mail[row].atime : 0, 8);
+    outLittleEndian(out, (flags & 2) ? (uint64_t)(int64_t)table->mail[row].mtime : 0, 8);
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        outLittleEndian(out, lengths[i], 2);
+        outWrite(out, fields->text[i], lengths[i]);
+    }
+    outLittleEndian(out, (flags & 2) ? (uint64_t)(int64_t)table->mailMessages[row] : (uint64_t)-1, 8);
+}
+
+/**
+ * Serializes one session directly into the output buffer, without allocations.
+ * Mail and `.plan` are included if the table keeps them.
+ *
+ * @param out The buffer that receives the output.
+ * @param format The output format (not EXPORT_TEXT).
+ * @param table The sessions of the query.
+ * @param row The row of the session to serialize.
+ */
+void exportUserInfo(OutBuf *out, ExportFormat format, const SessionTable *table, size_t row) {
+    SessionRow fields;
+    getSessionRow(table, row, &fields);
+    if (format == EXPORT_JSONL) exportJson(out, table, row, &fields);
+    else if (format == EXPORT_CSV) exportCsv(out, table, row, &fields);
+    else if (format == EXPORT_BIN) exportBinary(out, table, row, &fields);
+}
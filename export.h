@@ -0,0 +1,65 @@
+// export.h
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "lib.h"
+#include "outbuf.h"
+#include "sessiontable.h"
+
+/**
+ * Output formats selected with --format.
+ */
+typedef enum {
+    EXPORT_TEXT = 0, /**< Fixed-width tables of finger (default) */
+    EXPORT_JSONL,    /**< One JSON object per line */
+    EXPORT_CSV,      /**< RFC 4180 CSV with a header row */
+    EXPORT_BIN       /**< Length-prefixed binary records */
+} ExportFormat;
+
+/*
+ * Binary stream (all integers little endian):
+ *
+ *   header:  "MYFG" | u16 version | u16 reserved (0)
+ *   record:  u32 payload length | payload
+ *   payload: u8 flags | i64 loginTime | i64 idleSeconds | i64 mailAtime | i64 mailMtime |
+ *            10 strings, each u16 length + bytes (no terminator), in this order:
+ *            login, name, tty, idle, directory, shell, weekDay, hoursMinutes, office, phone |
+ *            i64 mailMessages (since version 2)
+ *
+ * flags: bit 0 mail and plan were probed, bit 1 mailbox found, bit 2 `.plan` found.
+ * idleSeconds is -1 when the terminal could not be probed, mailMessages when
+ * the messages could not be counted or there is no mailbox. Decoders must skip
+ * any payload bytes after the fields they know, so later versions can append fields.
+ */
+#define EXPORT_BIN_MAGIC "MYFG"
+#define EXPORT_BIN_VERSION 2
+
+/**
+ * Parses the name of an output format.
+ *
+ * @param name The name given to --format ("text", "jsonl", "csv" or "bin").
+ * @param format Receives the format.
+ * @return 0 on success, -1 if the name is unknown.
+ */
+int parseExportFormat(const char *name, ExportFormat *format);
+
+/**
+ * Writes what precedes the records: the CSV header row or the binary stream header.
+ *
+ * @param out The buffer that receives the output.
+ * @param format The output format.
+ */
+void beginExport(OutBuf *out, ExportFormat format);
+
+/**
+ * Serializes one session directly into the output buffer, without allocations.
+ * Mail and `.plan` are included if the table keeps them.
+ *
+ * @param out The buffer that receives the output.
+ * @param format The output format (not EXPORT_TEXT).
+ * @param table The sessions of the query.
+ * @param row The row of the session to serialize.
+ */
+void exportUserInfo(OutBuf *out, ExportFormat format, const SessionTable *table, size_t row);
+
+#endif
@@ -0,0 +1,761 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <time.h>
+#include <utmpx.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+
+#include "finger.h"
+#include "statbatch.h"
+#include "timefmt.h"
+#include "stats.h"
+
+/**
+ * Appends the lines of the long format that describe the user: login, name,
+ * directory, shell and office.
+ *
+ * @param out The output buffer.
+ * @param userInfo The fields of one of the user's sessions.
+ */
+static void outUserHeader(OutBuf *out, const SessionRow *userInfo) {
+    const char *const *text = userInfo->text;
+
+    //I campi non sono più troncati: uno spazio separa le etichette anche oltre la larghezza della colonna
+    outPuts(out, "Login: ");
+    outPad(out, text[SESSION_LOGIN], 33);
+    if (userInfo->len[SESSION_LOGIN] >= 33) outPutc(out, ' ');
+    outPuts(out, "Name: ");
+    outPuts(out, text[SESSION_NAME]);
+    outPuts(out, "\nDirectory: ");
+    outPad(out, text[SESSION_DIRECTORY], 29);
+    if (userInfo->len[SESSION_DIRECTORY] >= 29) outPutc(out, ' ');
+    outPuts(out, "Shell: ");
+    outPuts(out, text[SESSION_SHELL]);
+    outPuts(out, "\nOffice: ");
+    outPuts(out, text[SESSION_OFFICE]);
+    outPuts(out, ", ");
+    outPuts(out, text[SESSION_PHONE]);
+    outPutc(out, '\n');
+}
+
+/**
+ * Appends the "On since" line of a session.
+ *
+ * @param out The output buffer.
+ * @param userInfo The fields of the session.
+ * @param last_login The login time as a formatted string.
+ * @param messages 1 if the terminal accepts messages, 0 or -1 otherwise.
+ */
+static void outSessionLine(OutBuf *out, const SessionRow *userInfo, const char *last_login, int messages) {
+    outPuts(out, "On since ");
+    outPuts(out, last_login);
+    outPuts(out, " on ");
+    outPuts(out, userInfo->text[SESSION_TTY]);
+    outPuts(out, ",       ");
+    outPuts(out, userInfo->text[SESSION_IDLE]);
+    outPuts(out, messages == 1 ? "\n" : " (messages off)\n");
+}
+
+/**
+ * Prints user information based on the provided mode.
+ * @param out The buffer that receives the output.
+ * @param table The sessions of the query.
+ * @param row The row of the session to print.
+ * @param last_login The last login time as a formatted string.
+ * @param mode The mode to determine the level of detail to print.
+ * @param planLimits The limits on the `.plan` file, NULL for the defaults.
+ */
+void printUserInfo(OutBuf *out, const SessionTable *table, size_t row, const char *last_login, char mode,
+                   const PlanLimits *planLimits) {
+    ColumnLayout columns;
+    SessionRow userInfo;
+
+    // Modalità a tabella ('s', 'p', 'l'): una riga con le sole colonne della modalità
+    if (modeColumns(&columns, mode, COLUMN_SCOPE_USER) == 0) {
+        outColumnRow(out, &columns, table, row);
+        return;
+    }
+    // Stampa dettagliata se non è 'p', 's' o 'l'
+    getSessionRow(table, row, &userInfo);
+    const char *const *text = userInfo.text;
+    outUserHeader(out, &userInfo);
+    outSessionLine(out, &userInfo, last_login, table->messages[row]);
+
+    if (mode == 'm' || !table->withMailAndPlan) return;  // -m: no mail and plan
+    reportUserMail(out, &table->mail[row], table->mailMessages[row]);
+    reportUserPlan(out, text[SESSION_DIRECTORY], table->uid[row], &table->plan[row], planLimits);
+}
+
+/**
+ * Prints a user in the long format with all of its sessions: the user lines
+ * once, one "On since" line per session, then mail and `.plan` once.
+ *
+ * @param out The buffer that receives the output.
+ * @param table The sessions of the query (with mail and `.plan`).
+ * @param first The row of the first session of the user.
+ * @param count The number of consecutive rows of the user.
+ * @param planLimits The limits on the `.plan` file, NULL for the defaults.
+ */
+void printUserSessions(OutBuf *out, const SessionTable *table, size_t first, size_t count,
+                       const PlanLimits *planLimits) {
+    SessionRow userInfo;
+    char last_login[64];
+
+    getSessionRow(table, first, &userInfo);
+    outUserHeader(out, &userInfo);
+    for (size_t row = first; row < first + count; row++) {
+        if (row != first) getSessionRow(table, row, &userInfo);
+        STAT_BEGIN(STAT_PHASE_TIME);
+        formatLoginTime(table->loginTime[row], last_login, sizeof(last_login));
+        STAT_END(STAT_PHASE_TIME);
+        outSessionLine(out, &userInfo, last_login, table->messages[row]);
+    }
+    if (!table->withMailAndPlan) return;
+    reportUserMail(out, &table->mail[first], table->mailMessages[first]);
+    reportUserPlan(out, sessionString(table, table->directory[first]), table->uid[first], &table->plan[first],
+                   planLimits);
+}
+
+/**
+ * Prints the message for a user that does not exist.
+ *
+ * @param out The buffer that receives the output.
+ * @param username The username that was not found.
+ */
+void printUserNotFound(OutBuf *out, const char *username) {
+    outPuts(out, "\nUser ");
+    outPuts(out, username);
+    outPuts(out, " not found!\n\n");
+}
+
+/**
+ * Tells whether a mode prints the mail and `.plan` sections.
+ *
+ * @param mode The mode to determine the level of detail to print.
+ * @return 1 if mail and plan are printed, 0 otherwise.
+ */
+int modeShowsMailAndPlan(char mode) {
+    return mode != 'p' && mode != 's' && mode != 'l' && mode != 'm';
+}
+
+/**
+ * Probes in a single batch the files of the given sessions, the terminals
+ * only if asked to.
+ *
+ * @param ctx The data of the run.
+ * @param table The sessions filled with appendSession().
+ * @param withTtys 0 for sessions that are not live (their terminal says nothing).
+ */
+static void probeSessionFiles(const FingerContext *ctx, SessionTable *table, int withTtys) {
+    StatBatch batch;
+    size_t count = table->count;
+    int withMailAndPlan = table->withMailAndPlan;
+    FileProbe *ttys = calloc(count ? count : 1, sizeof(FileProbe));
+    const char *devDir = ctx->devDir ? ctx->devDir : "/dev";
+    const char *mailDir = ctx->mailDir ? ctx->mailDir : MAIL_SPOOL_DIR;
+    char path[512];
+    char planPath[PATH_MAX]; //Le home non hanno altro limite di lunghezza
+
+    if (ttys == NULL) return; //Memoria esaurita: idle, posta e plan restano vuoti
+
+    initStatBatch(&batch);
+    for (size_t i = 0; i < count; i++) {
+        //Percorso del terminale (es. `/dev/pts/1`); la console usa il tempo di login
+        const char *tty = sessionString(table, table->tty[i]);
+        if (withTtys && strcmp(tty, "console") != 0) {
+            snprintf(path, sizeof(path), "%s/%s", devDir, tty);
+            addStatRequest(&batch, path, &ttys[i]);
+            STAT_ADD(STAT_TTY_PROBES, 1);
+        }
+        //Posta e .plan una sola volta per utente quando le sessioni sono consecutive (login interni: basta l'offset)
+        if (withMailAndPlan && (i == 0 || table->login[i].offset != table->login[i - 1].offset)) {
+            const char *login = sessionString(table, table->login[i]);
+            if (ctx->mailboxes != NULL) {
+                //Stato della casella già noto: nessuna stat necessaria
+                const FileProbe *mail = findMailbox(ctx->mailboxes, login);
+                if (mail != NULL) table->mail[i] = *mail;
+            } else {
+                snprintf(path, sizeof(path), "%s/%s", mailDir, login);
+                addStatRequest(&batch, path, &table->mail[i]);
+                STAT_ADD(STAT_MAIL_PROBES, 1);
+            }
+            //Percorso troncato: il .plan resta non trovato e reportUserPlan() lo segnala
+            if (snprintf(planPath, sizeof(planPath), "%s/.plan", sessionString(table, table->directory[i])) <
+                (int)sizeof(planPath)) {
+                addStatRequest(&batch, planPath, &table->plan[i]);
+                STAT_ADD(STAT_PLAN_PROBES, 1);
+            }
+        }
+    }
+
+    STAT_BEGIN(STAT_PHASE_PROBE);
+    runStatBatch(&batch);
+    STAT_END(STAT_PHASE_PROBE);
+
+    //Riporta i risultati nella tabella prima della stampa
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; i++) {
+        if (withTtys && strcmp(sessionString(table, table->tty[i]), "console") == 0) {
+            table->idleSeconds[i] = (long)difftime(now, table->loginTime[i]);
+        } else if (ttys[i].found) {
+            table->idleSeconds[i] = (long)difftime(now, ttys[i].atime); //Ultimo accesso al terminale
+            //Come in mesg(1): il terminale accetta messaggi se il proprietario e il gruppo possono scriverci
+            table->messages[i] = (ttys[i].mode & (S_IWUSR | S_IWGRP)) == (S_IWUSR | S_IWGRP);
+            //Comando in primo piano: una ricerca nella tabella dei processi, poi solo la riga di comando del processo trovato
+            const ForegroundProcess *process =
+                ctx->processes != NULL && S_ISCHR(ttys[i].mode) ? findForeground(ctx->processes, ttys[i].rdev) : NULL;
+            if (process != NULL) {
+                char command[256];
+                processCommand(process, NULL, command, sizeof(command));
+                setSessionCommand(table, i, command);
+            }
+        }
+        if (withMailAndPlan && i > 0 && table->login[i].offset == table->login[i - 1].offset) {
+            table->mail[i] = table->mail[i - 1];
+            table->mailMessages[i] = table->mailMessages[i - 1];
+            table->plan[i] = table->plan[i - 1];
+        } else if (withMailAndPlan && table->mail[i].found) {
+            //Numero di messaggi: dalla cache se la casella non è cambiata, altrimenti letto
+            STAT_BEGIN(STAT_PHASE_MAIL);
+            snprintf(path, sizeof(path), "%s/%s", mailDir, sessionString(table, table->login[i]));
+            table->mailMessages[i] = countMailMessages(ctx->mailCounts, path, &table->mail[i]);
+            STAT_END(STAT_PHASE_MAIL);
+        }
+    }
+    freeStatBatch(&batch);
+    free(ttys);
+}
+
+/**
+ * Probes in a single batch every file needed to render the given sessions:
+ * the terminal of each session and, if the table keeps them, mailbox and
+ * `.plan` of each user. The results are stored in the table.
+ *
+ * @param ctx The data of the run.
+ * @param table The sessions filled with appendSession().
+ */
+void probeSessions(const FingerContext *ctx, SessionTable *table) {
+    probeSessionFiles(ctx, table, 1);
+}
+
+/**
+ * Tells whether a query prints the last login of a user who is not logged in.
+ *
+ * @param ctx The data of the run.
+ * @param mode The mode to determine the level of detail to print.
+ * @return 1 for the long format as text, 0 otherwise.
+ */
+static int showsLastLogin(const FingerContext *ctx, char mode) {
+    return ctx->format == EXPORT_TEXT && (mode == 0 || mode == 'm');
+}
+
+/**
+ * Finds last logins in the default wtmp, through the last-login index when
+ * the cache directory is known.
+ *
+ * @param set The LastLoginSet structure to populate.
+ * @param logins The login names.
+ * @param count The number of names.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int resolveDefaultLogins(LastLoginSet *set, const char *const *logins, size_t count) {
+    char indexPath[512];
+    int withIndex = lastLoginIndexPath(indexPath, sizeof(indexPath)) == 0;
+    return resolveLastLogins(set, logins, count, WTMP_FILE, withIndex ? indexPath : NULL);
+}
+
+/**
+ * Prints a user who is not logged in: the user lines, the last login from
+ * wtmp (or "Never logged in."), then mail and `.plan` as for a session.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param username The username to print.
+ * @param pwd The passwd entry of the user.
+ * @param mode The mode to determine the level of detail to print.
+ */
+static void printOfflineUser(OutBuf *out, const FingerContext *ctx, const char *username, struct passwd *pwd,
+                             char mode) {
+    LastLoginSet own = {NULL, 0};
+    const LastLoginSet *set = ctx->lastLogins;
+    SessionTable table;
+    SessionRow userInfo;
+    struct utmpx ut;
+    char when[64];
+
+    //Ultimi login non risolti per tutta la query: si cerca solo questo utente
+    if (set == NULL) {
+        if (resolveDefaultLogins(&own, &username, 1) != 0) return;
+        set = &own;
+    }
+    const LastLogin *last = findLastLogin(set, username);
+
+    //Una riga costruita dall'ultimo login dà intestazione, posta e .plan come per una sessione
+    memset(&ut, 0, sizeof(ut));
+    ut.ut_type = USER_PROCESS;
+    memcpy(ut.ut_user, username, strnlen(username, sizeof(ut.ut_user)));
+    if (last != NULL) {
+        memcpy(ut.ut_line, last->tty, strnlen(last->tty, sizeof(ut.ut_line)));
+        ut.ut_tv.tv_sec = last->time;
+    }
+    initSessionTable(&table, modeShowsMailAndPlan(mode));
+    if (appendSession(&table, &ut, pwd) >= 0) {
+        probeSessionFiles(ctx, &table, 0);
+        getSessionRow(&table, 0, &userInfo);
+        outUserHeader(out, &userInfo);
+        if (last == NULL) {
+            outPuts(out, "Never logged in.\n");
+        } else {
+            STAT_BEGIN(STAT_PHASE_TIME);
+            formatLoginTime(last->time, when, sizeof(when));
+            STAT_END(STAT_PHASE_TIME);
+            outPuts(out, "Last login ");
+            outPuts(out, when);
+            outPuts(out, " on ");
+            outPuts(out, last->tty);
+            if (last->host[0] != '\0') {
+                outPuts(out, " from ");
+                outPuts(out, last->host);
+            }
+            outPutc(out, '\n');
+        }
+        if (table.withMailAndPlan) {
+            reportUserMail(out, &table.mail[0], table.mailMessages[0]);
+            reportUserPlan(out, sessionString(&table, table.directory[0]), table.uid[0], &table.plan[0],
+                           ctx->planLimits);
+        }
+    }
+    freeSessionTable(&table);
+    freeLastLoginSet(&own);
+}
+
+/**
+ * Finds with a single pass over wtmp (or its index) the last login of the
+ * given users that exist, are not logged in and will be printed in the long format.
+ *
+ * @param ctx The data of the run.
+ * @param usernames The usernames of the query.
+ * @param count The number of usernames.
+ * @param mode The mode of the query.
+ * @param set Receives the last logins, to be set as ctx->lastLogins.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int findOfflineLogins(const FingerContext *ctx, char *const *usernames, size_t count, char mode, LastLoginSet *set) {
+    const char **offline = malloc((count ? count : 1) * sizeof(char *));
+    size_t n = 0;
+
+    if (offline == NULL) return -1;
+    for (size_t i = 0; showsLastLogin(ctx, mode) && i < count; i++) {
+        if (findSessionUser(ctx->index, usernames[i]) == NULL && lookupPasswd(ctx->cache, usernames[i]) != NULL) {
+            offline[n++] = usernames[i];
+        }
+    }
+    int result = resolveDefaultLogins(set, offline, n);
+    free(offline);
+    return result;
+}
+
+/**
+ * Handles the user information retrieval and printing based on the username and mode.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param username The username to handle.
+ * @param mode The mode to determine the level of detail to print.
+ * @return 0 on success, -1 if the user does not exist.
+ */
+int handleUser(OutBuf *out, const FingerContext *ctx, const char *username, char mode) {
+    struct passwd *pwd = lookupPasswd(ctx->cache, username); //Recupera informazioni sull'utente del file /etc/passwd
+    //Se l'utente non è trovato, il messaggio di errore è lasciato al chiamante
+    if (pwd == NULL) return -1;
+
+    printUserEntry(out, ctx, username, pwd, mode);
+    return 0;
+}
+
+/**
+ * Prints a user whose passwd entry is already known, with all of its sessions.
+ * Touches only data owned by the call and the thread-safe caches of the
+ * context, so it may run on several threads at once.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param username The username to print.
+ * @param pwd The passwd entry of the user.
+ * @param mode The mode to determine the level of detail to print.
+ */
+void printUserEntry(OutBuf *out, const FingerContext *ctx, const char *username, struct passwd *pwd, char mode) {
+    //L'ultimo login e le sessioni dell'utente sono già calcolati nell'indice
+    const SessionUser *user = findSessionUser(ctx->index, username);
+    time_t lastLoginTime = user ? user->latestLogin : 0; //Timestamp dell'ultimo login
+    char last_login[64] = ""; //Stringa per formattare l'orario dell'ultimo login
+    ColumnLayout columns;
+
+    //Converte il timestamp dell'ultimo login in una stringa leggibile, solo per il formato esteso
+    if (ctx->format == EXPORT_TEXT && modeColumns(&columns, mode, COLUMN_SCOPE_USER) != 0) {
+        STAT_BEGIN(STAT_PHASE_TIME);
+        formatLoginTime(lastLoginTime, last_login, sizeof(last_login));
+        STAT_END(STAT_PHASE_TIME);
+    }
+
+    if (user == NULL) {
+        if (showsLastLogin(ctx, mode)) printOfflineUser(out, ctx, username, pwd, mode);
+        return;
+    }
+
+    //Una riga della tabella per ogni sessione (terminale) dell'utente
+    SessionTable table;
+    initSessionTable(&table, modeShowsMailAndPlan(mode));
+    for (size_t i = 0; i < user->count; i++) {
+        if (appendSession(&table, user->sessions[i], pwd) < 0) break;
+    }
+    //Terminali, posta e .plan letti insieme prima della stampa
+    probeSessions(ctx, &table);
+
+    for (size_t i = 0; i < table.count; i++) {
+        if (ctx->format != EXPORT_TEXT) exportUserInfo(out, ctx->format, &table, i);
+        else printUserInfo(out, &table, i, last_login, mode, ctx->planLimits);
+    }
+    freeSessionTable(&table);
+}
+
+/**
+ * Prints the table of the logged-in users: the header of the columns and one row per session.
+ *
+ * @param out The buffer that receives the output.
+ * @param table The sessions to list, already probed for the needs of the columns.
+ * @param columns The columns, from modeColumns() or parseColumns().
+ */
+void printSessionList(OutBuf *out, const SessionTable *table, const ColumnLayout *columns) {
+    outColumnHeader(out, columns);
+    for (size_t i = 0; i < table->count; i++) outColumnRow(out, columns, table, i);
+}
+
+/**
+ * A utmpx session that passed the filters of a ListOptions.
+ */
+typedef struct {
+    const struct utmpx *ut;  /**< The session */
+    size_t order;            /**< Position in utmpx, breaks the ties */
+    long idle;               /**< Idle time in seconds, -1 if unknown or not probed */
+} ListCandidate;
+
+/**
+ * Computes the idle time of candidates from the access time of their
+ * terminals, read with one batch of stat calls like probeSessions().
+ *
+ * @param ctx The data of the run.
+ * @param candidates The candidates, idle is filled in.
+ * @param count The number of candidates.
+ */
+static void probeCandidates(const FingerContext *ctx, ListCandidate *candidates, size_t count) {
+    StatBatch batch;
+    FileProbe *ttys = calloc(count ? count : 1, sizeof(FileProbe));
+    const char *devDir = ctx->devDir ? ctx->devDir : "/dev";
+    char path[512];
+
+    if (ttys == NULL) return; //Memoria esaurita: idle resta sconosciuto
+
+    initStatBatch(&batch);
+    for (size_t i = 0; i < count; i++) {
+        const struct utmpx *ut = candidates[i].ut;
+        if (strncmp(ut->ut_line, "console", sizeof(ut->ut_line)) != 0) {
+            snprintf(path, sizeof(path), "%s/%.*s", devDir, (int)strnlen(ut->ut_line, sizeof(ut->ut_line)), ut->ut_line);
+            addStatRequest(&batch, path, &ttys[i]);
+            STAT_ADD(STAT_TTY_PROBES, 1);
+        }
+    }
+
+    STAT_BEGIN(STAT_PHASE_PROBE);
+    runStatBatch(&batch);
+    STAT_END(STAT_PHASE_PROBE);
+
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; i++) {
+        const struct utmpx *ut = candidates[i].ut;
+        if (strncmp(ut->ut_line, "console", sizeof(ut->ut_line)) == 0) {
+            candidates[i].idle = (long)difftime(now, ut->ut_tv.tv_sec);
+        } else if (ttys[i].found) {
+            candidates[i].idle = (long)difftime(now, ttys[i].atime);
+        }
+    }
+    freeStatBatch(&batch);
+    free(ttys);
+}
+
+/**
+ * Tells whether a candidate comes before another in the requested order.
+ *
+ * @param a The first candidate.
+ * @param b The second candidate.
+ * @param sort The order of the list.
+ * @return 1 if a comes first, 0 otherwise.
+ */
+static int candidateBefore(const ListCandidate *a, const ListCandidate *b, ListSort sort) {
+    int cmp = 0;
+    switch (sort) {
+    case LIST_SORT_IDLE:
+        cmp = a->idle > b->idle ? -1 : a->idle < b->idle;
+        break;
+    case LIST_SORT_LOGIN:
+        cmp = a->ut->ut_tv.tv_sec > b->ut->ut_tv.tv_sec ? -1 : a->ut->ut_tv.tv_sec < b->ut->ut_tv.tv_sec;
+        break;
+    case LIST_SORT_NAME:
+        cmp = strncmp(a->ut->ut_user, b->ut->ut_user, sizeof(a->ut->ut_user));
+        break;
+    case LIST_SORT_TTY:
+        cmp = strncmp(a->ut->ut_line, b->ut->ut_line, sizeof(a->ut->ut_line));
+        break;
+    case LIST_SORT_NONE:
+        break;
+    }
+    return cmp != 0 ? cmp < 0 : a->order < b->order;
+}
+
+/**
+ * Moves a candidate down the heap until both of its children come after it.
+ *
+ * @param heap The candidates, a heap with the first in order at the root.
+ * @param count The number of candidates in the heap.
+ * @param i The position of the candidate to move.
+ * @param sort The order of the list.
+ */
+static void siftDown(ListCandidate *heap, size_t count, size_t i, ListSort sort) {
+    for (;;) {
+        size_t first = i, left = 2 * i + 1, right = left + 1;
+        if (left < count && candidateBefore(&heap[left], &heap[first], sort)) first = left;
+        if (right < count && candidateBefore(&heap[right], &heap[first], sort)) first = right;
+        if (first == i) return;
+        ListCandidate tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+}
+
+/**
+ * Fills a table with the sessions selected by a ListOptions. The login glob
+ * rejects a session before its passwd lookup and its terminal; terminals are
+ * read first only when the idle time filters or orders the list. With a limit
+ * the candidates are arranged in a heap in linear time and only the first
+ * ones are extracted, so passwd is looked up just for the rows printed.
+ *
+ * @param ctx The data of the run.
+ * @param opt The selection.
+ * @param table The session table to populate.
+ * @return 1 if the idle times are already in the table, 0 if the table must be probed.
+ */
+static int selectSessions(const FingerContext *ctx, const ListOptions *opt, SessionTable *table) {
+    const SessionIndex *index = ctx->index;
+    ListCandidate *candidates = malloc((index->count ? index->count : 1) * sizeof(ListCandidate));
+    int withIdle = opt->idleOver >= 0 || opt->sort == LIST_SORT_IDLE;
+    size_t count = 0;
+    char login[sizeof(index->sessions[0].ut_user) + 1];
+
+    if (candidates == NULL) return 0;
+
+    for (size_t i = 0; i < index->count; i++) {
+        const struct utmpx *ut = &index->sessions[i];
+        if (opt->userGlob != NULL) {
+            size_t len = strnlen(ut->ut_user, sizeof(ut->ut_user));
+            memcpy(login, ut->ut_user, len);
+            login[len] = '\0';
+            if (fnmatch(opt->userGlob, login, 0) != 0) continue;
+        }
+        candidates[count].ut = ut;
+        candidates[count].order = i;
+        candidates[count].idle = -1;
+        count++;
+    }
+
+    if (withIdle) {
+        probeCandidates(ctx, candidates, count);
+        if (opt->idleOver >= 0) {
+            //Idle sconosciuto: la sessione non supera la soglia
+            size_t kept = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (candidates[i].idle >= opt->idleOver) candidates[kept++] = candidates[i];
+            }
+            count = kept;
+        }
+    }
+
+    //Heap costruito in tempo lineare: si estraggono solo le righe stampate
+    if (opt->sort != LIST_SORT_NONE) {
+        for (size_t i = count / 2; i-- > 0;) siftDown(candidates, count, i, opt->sort);
+    }
+    size_t next = 0;
+    while (count > 0 && (opt->limit == 0 || table->count < opt->limit)) {
+        ListCandidate c;
+        if (opt->sort != LIST_SORT_NONE) {
+            c = candidates[0];
+            candidates[0] = candidates[--count];
+            siftDown(candidates, count, 0, opt->sort);
+        } else if (next < count) {
+            c = candidates[next++];
+        } else {
+            break;
+        }
+
+        struct passwd *pwd = lookupPasswd(ctx->cache, c.ut->ut_user);
+        if (pwd == NULL) continue;
+        long row = appendSession(table, c.ut, pwd);
+        if (row < 0) break;
+        if (withIdle) table->idleSeconds[row] = c.idle;
+    }
+    free(candidates);
+    return withIdle;
+}
+
+/**
+ * Lists all logged-in users with the columns of ctx->columns or of the mode,
+ * filtered, ordered and limited by ctx->list when it is set. GECOS, the
+ * terminals and /proc are read only if a column needs them.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param mode The mode to determine the level of detail to print.
+ */
+void listLoggedUsers(OutBuf *out, const FingerContext *ctx, char mode) {
+    ColumnLayout modeLayout;
+    const ColumnLayout *columns = ctx->columns;
+    FingerContext run = *ctx;
+    ProcessTable processes;
+    SessionTable table;
+
+    if (columns == NULL) {
+        modeColumns(&modeLayout, mode, COLUMN_SCOPE_LIST);
+        columns = &modeLayout;
+    }
+    //I record di --format hanno sempre tutti i campi, il testo solo quelli delle colonne
+    unsigned needs = ctx->format == EXPORT_TEXT ? columns->needs : COLUMN_NEEDS_GECOS | COLUMN_NEEDS_TTY;
+    if ((needs & COLUMN_NEEDS_PROCESS) && ctx->processes == NULL) {
+        run.processes = loadProcessTable(&processes, NULL) == 0 ? &processes : NULL;
+    }
+
+    initSessionTable(&table, 0);
+    table.withGecos = (needs & COLUMN_NEEDS_GECOS) != 0;
+    if (ctx->list != NULL) {
+        //Filtri, ordinamento e limite applicati prima di passwd e dei terminali
+        //Con i comandi servono comunque i terminali delle righe scelte, non solo il loro idle
+        int probed = selectSessions(ctx, ctx->list, &table);
+        if (!probed || (needs & COLUMN_NEEDS_PROCESS)) {
+            probeSessionFiles(&run, &table, (needs & COLUMN_NEEDS_TTY) != 0);
+        }
+    } else {
+        //Una riga per ogni sessione USER_PROCESS dell'indice con un utente esistente
+        for (size_t i = 0; i < ctx->index->count; i++) {
+            struct utmpx *ut = &ctx->index->sessions[i];
+            struct passwd *pwd = lookupPasswd(ctx->cache, ut->ut_user); //Ottiene informazioni sull'utente (una sola volta per login)
+            if (pwd != NULL && appendSession(&table, ut, pwd) < 0) break;
+        }
+        //Tutti i terminali vengono letti insieme prima della stampa, se una colonna li usa
+        probeSessionFiles(&run, &table, (needs & COLUMN_NEEDS_TTY) != 0);
+    }
+
+    outputSessionList(out, ctx->format, &table, columns);
+    if (run.processes != ctx->processes) freeProcessTable(&processes);
+    freeSessionTable(&table);
+}
+
+/**
+ * Writes a table of logged-in users in the format of the run: the given
+ * columns for text, one record per session otherwise.
+ *
+ * @param out The buffer that receives the output.
+ * @param format The format of the output.
+ * @param table The sessions to list, already probed.
+ * @param columns The columns of the text list.
+ */
+void outputSessionList(OutBuf *out, ExportFormat format, const SessionTable *table, const ColumnLayout *columns) {
+    if (format == EXPORT_TEXT) {
+        printSessionList(out, table, columns);
+    } else {
+        //Formati per le macchine: nessuna intestazione per chiamata, vedi beginExport()
+        for (size_t i = 0; i < table->count; i++) exportUserInfo(out, format, table, i);
+    }
+}
+
+/**
+ * Orders users by most recent login, newest first; ties keep the order of utmpx.
+ */
+static int compareUsersByLogin(const void *a, const void *b) {
+    const SessionUser *ua = *(const SessionUser *const *)a, *ub = *(const SessionUser *const *)b;
+    if (ua->latestLogin != ub->latestLogin) return ua->latestLogin < ub->latestLogin ? 1 : -1;
+    return ua < ub ? -1 : ua > ub;
+}
+
+/**
+ * Orders sessions by login time, newest first; ties keep the order of utmpx.
+ */
+static int compareSessionsByLogin(const void *a, const void *b) {
+    const struct utmpx *sa = *(const struct utmpx *const *)a, *sb = *(const struct utmpx *const *)b;
+    if (sa->ut_tv.tv_sec != sb->ut_tv.tv_sec) return sa->ut_tv.tv_sec < sb->ut_tv.tv_sec ? 1 : -1;
+    return sa < sb ? -1 : sa > sb;
+}
+
+/**
+ * Prints the detailed information of every logged-in user, once per user with
+ * all of its sessions. Users and sessions are ordered by login, newest first.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ */
+void listUsersDetailed(OutBuf *out, const FingerContext *ctx) {
+    const SessionIndex *index = ctx->index;
+    const SessionUser **users = malloc((index->userCount ? index->userCount : 1) * sizeof(SessionUser *));
+    const struct utmpx **sessions = malloc((index->count ? index->count : 1) * sizeof(struct utmpx *));
+    size_t *firstRow = malloc((index->userCount + 1) * sizeof(size_t));
+    size_t userCount = 0;
+    SessionTable table;
+
+    initSessionTable(&table, 1);
+    if (users == NULL || sessions == NULL || firstRow == NULL) {
+        free(users);
+        free(sessions);
+        free(firstRow);
+        return;
+    }
+
+    //L'indice contiene già gli utenti distinti: basta ordinarli per ultimo login
+    for (size_t u = 0; u < index->userCount; u++) users[u] = &index->users[u];
+    qsort(users, index->userCount, sizeof(users[0]), compareUsersByLogin);
+
+    //Un solo passaggio: le sessioni di ogni utente sono consecutive nella tabella, dalla più recente
+    for (size_t u = 0; u < index->userCount; u++) {
+        const SessionUser *user = users[u];
+        struct passwd *pwd = lookupPasswd(ctx->cache, user->login); // Assicura che pwd sia aggiornato per ogni utente
+        if (pwd == NULL) continue;
+
+        memcpy(sessions, user->sessions, user->count * sizeof(sessions[0]));
+        qsort(sessions, user->count, sizeof(sessions[0]), compareSessionsByLogin);
+        firstRow[userCount] = table.count;
+        for (size_t i = 0; i < user->count; i++) {
+            if (appendSession(&table, sessions[i], pwd) < 0) break;
+        }
+        if (table.count > firstRow[userCount]) userCount++;
+    }
+    firstRow[userCount] = table.count;
+
+    //Terminali, posta e .plan di tutti gli utenti letti insieme
+    probeSessions(ctx, &table);
+
+    for (size_t u = 0; u < userCount; u++) {
+        if (ctx->format != EXPORT_TEXT) {
+            for (size_t row = firstRow[u]; row < firstRow[u + 1]; row++) exportUserInfo(out, ctx->format, &table, row);
+            continue;
+        }
+        printUserSessions(out, &table, firstRow[u], firstRow[u + 1] - firstRow[u], ctx->planLimits);
+        outPutc(out, '\n');  // Riga vuota per separare gli utenti
+    }
+    freeSessionTable(&table);
+    free(users);
+    free(sessions);
+    free(firstRow);
+}
@@ -0,0 +1,183 @@
+// finger.h
+#ifndef FINGER_H
+#define FINGER_H
+
+#include "lib.h"
+#include "session.h"
+#include "pwcache.h"
+#include "mail.h"
+#include "export.h"
+#include "sessiontable.h"
+#include "wtmp.h"
+#include "proctable.h"
+#include "columns.h"
+
+/**
+ * Order of the list of logged-in users.
+ */
+typedef enum {
+    LIST_SORT_NONE,   /**< Order of utmpx */
+    LIST_SORT_IDLE,   /**< Longest idle first */
+    LIST_SORT_LOGIN,  /**< Most recent login first */
+    LIST_SORT_NAME,   /**< Login name, alphabetical */
+    LIST_SORT_TTY     /**< Terminal, alphabetical */
+} ListSort;
+
+/**
+ * Selection applied to the list of logged-in users. Ties keep the order of utmpx.
+ */
+typedef struct {
+    ListSort sort;         /**< Order of the rows */
+    long idleOver;         /**< Only sessions idle at least this many seconds, -1 for all */
+    const char *userGlob;  /**< Only logins matching this fnmatch() pattern, NULL for all */
+    size_t limit;          /**< Maximum number of rows, 0 for no limit */
+} ListOptions;
+
+/**
+ * Data shared by the query paths of a run.
+ */
+typedef struct {
+    const SessionIndex *index;     /**< Sessions read from utmpx */
+    PasswdCache *cache;            /**< Cache used for every passwd lookup */
+    const MailboxTable *mailboxes; /**< Known state of the mailboxes, NULL to probe them */
+    ExportFormat format;           /**< Output format of the records */
+    const char *devDir;            /**< Directory of the terminals, NULL for "/dev" */
+    const char *mailDir;           /**< Mail spool directory, NULL for MAIL_SPOOL_DIR */
+    const PlanLimits *planLimits;  /**< Limits on the `.plan` files, NULL for the defaults */
+    MailCountCache *mailCounts;    /**< Message counts of the mailboxes, NULL to count them every time */
+    const ListOptions *list;       /**< Selection of the list of logged-in users, NULL for every session */
+    const LastLoginSet *lastLogins; /**< Last logins of the users of the query, NULL to read them per user */
+    const ProcessTable *processes; /**< Foreground processes of the terminals, NULL to leave the commands empty */
+    const ColumnLayout *columns;   /**< Columns of the list chosen with -o, NULL for those of the mode */
+} FingerContext;
+
+/**
+ * Prints user information based on the provided mode.
+ *
+ * @param out The buffer that receives the output.
+ * @param table The sessions of the query.
+ * @param row The row of the session to print.
+ * @param last_login The last login time as a formatted string.
+ * @param mode The mode to determine the level of detail to print.
+ * @param planLimits The limits on the `.plan` file, NULL for the defaults.
+ */
+void printUserInfo(OutBuf *out, const SessionTable *table, size_t row, const char *last_login, char mode,
+                   const PlanLimits *planLimits);
+
+/**
+ * Prints a user in the long format with all of its sessions: the user lines
+ * once, one "On since" line per session, then mail and `.plan` once.
+ *
+ * @param out The buffer that receives the output.
+ * @param table The sessions of the query (with mail and `.plan`).
+ * @param first The row of the first session of the user.
+ * @param count The number of consecutive rows of the user.
+ * @param planLimits The limits on the `.plan` file, NULL for the defaults.
+ */
+void printUserSessions(OutBuf *out, const SessionTable *table, size_t first, size_t count,
+                       const PlanLimits *planLimits);
+
+/**
+ * Prints the message for a user that does not exist.
+ *
+ * @param out The buffer that receives the output.
+ * @param username The username that was not found.
+ */
+void printUserNotFound(OutBuf *out, const char *username);
+
+/**
+ * Tells whether a mode prints the mail and `.plan` sections.
+ *
+ * @param mode The mode to determine the level of detail to print.
+ * @return 1 if mail and plan are printed, 0 otherwise.
+ */
+int modeShowsMailAndPlan(char mode);
+
+/**
+ * Probes in a single batch every file needed to render the given sessions:
+ * the terminal of each session and, if the table keeps them, mailbox and
+ * `.plan` of each user. The results are stored in the table.
+ *
+ * @param ctx The data of the run.
+ * @param table The sessions filled with appendSession().
+ */
+void probeSessions(const FingerContext *ctx, SessionTable *table);
+
+/**
+ * Finds with a single pass over wtmp (or its index) the last login of the
+ * given users that exist, are not logged in and will be printed in the long
+ * format, so that printUserEntry() does not read wtmp once per user.
+ *
+ * @param ctx The data of the run.
+ * @param usernames The usernames of the query.
+ * @param count The number of usernames.
+ * @param mode The mode of the query.
+ * @param set Receives the last logins, to be set as ctx->lastLogins.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int findOfflineLogins(const FingerContext *ctx, char *const *usernames, size_t count, char mode, LastLoginSet *set);
+
+/**
+ * Handles the user information retrieval and printing based on the username and mode.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param username The username to handle.
+ * @param mode The mode to determine the level of detail to print.
+ * @return 0 on success, -1 if the user does not exist.
+ */
+int handleUser(OutBuf *out, const FingerContext *ctx, const char *username, char mode);
+
+/**
+ * Prints a user whose passwd entry is already known, with all of its sessions.
+ * Touches only data owned by the call and the thread-safe caches of the
+ * context, so it may run on several threads at once.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param username The username to print.
+ * @param pwd The passwd entry of the user.
+ * @param mode The mode to determine the level of detail to print.
+ */
+void printUserEntry(OutBuf *out, const FingerContext *ctx, const char *username, struct passwd *pwd, char mode);
+
+/**
+ * Prints the table of the logged-in users: the header of the columns and one row per session.
+ *
+ * @param out The buffer that receives the output.
+ * @param table The sessions to list, already probed for the needs of the columns.
+ * @param columns The columns, from modeColumns() or parseColumns().
+ */
+void printSessionList(OutBuf *out, const SessionTable *table, const ColumnLayout *columns);
+
+/**
+ * Writes a table of logged-in users in the format of the run: the given
+ * columns for text, one record per session otherwise.
+ *
+ * @param out The buffer that receives the output.
+ * @param format The format of the output.
+ * @param table The sessions to list, already probed.
+ * @param columns The columns of the text list.
+ */
+void outputSessionList(OutBuf *out, ExportFormat format, const SessionTable *table, const ColumnLayout *columns);
+
+/**
+ * Lists all logged-in users with the columns of ctx->columns or of the mode,
+ * filtered, ordered and limited by ctx->list when it is set. GECOS, the
+ * terminals and /proc are read only if a column needs them.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ * @param mode The mode to determine the level of detail to print.
+ */
+void listLoggedUsers(OutBuf *out, const FingerContext *ctx, char mode);
+
+/**
+ * Prints the detailed information of every logged-in user, once per user.
+ *
+ * @param out The buffer that receives the output.
+ * @param ctx The data of the run.
+ */
+void listUsersDetailed(OutBuf *out, const FingerContext *ctx);
+
+#endif
@@ -8,34 +8,63 @@
 #include <utmpx.h> //Per accedere alla tabella degli utenti connessi
 #include <sys/stat.h> //Per ottenere informazioni sul file
 #include <string.h> //Per operazioni sulle stringhe
+#include <limits.h> //Per PATH_MAX
 #include <fcntl.h> //Per l'accesso a funzionalità sui file descriptor
+#include <errno.h> //Per i codici di errore
 #include "lib.h"
+#include "mail.h"
+#include "timefmt.h"
+#include "stats.h"
 
 /**
- * Generates a formatted string of idle time.
+ * Generates a formatted string of idle time into a caller buffer.
  *
  * @param seconds The number of seconds of idle time.
  * @param detailed If true, provides a detailed format.
- * @return A formatted string representing the idle time.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
  */
-char* getIdleTimeFormatted(double seconds, bool detailed) {
-    static char buff[50]; // Buffer statico per la stringa formattata
-
+char* getIdleTimeFormatted_r(double seconds, bool detailed, char *buff, size_t size) {
     if (seconds < 60) {
-        sprintf(buff, detailed ? "idle %ds" : "%ds", (int)seconds);
+        snprintf(buff, size, detailed ? "idle %ds" : "%ds", (int)seconds);
     } else if (seconds < 3600) {
-        sprintf(buff, detailed ? "idle 0:%02d" : "%d", (int)(seconds / 60));
+        snprintf(buff, size, detailed ? "idle 0:%02d" : "%d", (int)(seconds / 60));
     } else if (seconds < 86400) {
         int hours = seconds / 3600;
         int minutes = (seconds - (hours * 3600)) / 60;
-        sprintf(buff, detailed ? "idle %d:%02d" : "%d:%02d", hours, minutes);
+        snprintf(buff, size, detailed ? "idle %d:%02d" : "%d:%02d", hours, minutes);
     } else {
         int days = seconds / 86400;
-        sprintf(buff, detailed ? "idle %d days" : "%dd", days);
+        snprintf(buff, size, detailed ? "idle %d days" : "%dd", days);
     }
     return buff;
 }
 
+/**
+ * Generates a formatted string of idle time.
+ *
+ * @param seconds The number of seconds of idle time.
+ * @param detailed If true, provides a detailed format.
+ * @return A formatted string representing the idle time.
+ */
+char* getIdleTimeFormatted(double seconds, bool detailed) {
+    static char buff[50]; // Buffer statico per la stringa formattata
+    return getIdleTimeFormatted_r(seconds, detailed, buff, sizeof(buff));
+}
+
+/**
+ * Calculates the idle time from the given seconds into a caller buffer.
+ *
+ * @param seconds The number of seconds since the last activity.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* calculateIdleTime_r(double seconds, char *buff, size_t size) {
+    //Calcola la differenza attuale tra il tempo attuale e "seconds" e formatta il risultato
+    return getIdleTimeFormatted_r(difftime(time(NULL), seconds), false, buff, size);
+}
 
 /**
  * Calculates the idle time from the given seconds.
@@ -44,7 +73,44 @@ char* getIdleTimeFormatted(double seconds, bool detailed) {
  * @return A formatted string representing the idle time.
  */
 char* calculateIdleTime(double seconds) {
-    return getIdleTimeFormatted(difftime(time(NULL), seconds), false); //Calcola la differenza attuale tra il tempo attuale e "seconds" e formatta il risultato
+    static char buff[50];
+    return calculateIdleTime_r(seconds, buff, sizeof(buff));
+}
+
+/**
+ * Gets the complete idle time from the given seconds into a caller buffer.
+ *
+ * @param seconds The number of seconds since the last activity.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getCompleteIdle_r(double seconds, char *buff, size_t size) {
+    return getIdleTimeFormatted_r(difftime(time(NULL), seconds), true, buff, size);
+}
+
+/**
+ * Gets the complete idle time from the given seconds.
+ *
+ * @param seconds The number of seconds since the last activity.
+ * @return A formatted string representing the complete idle time.
+ */
+char* getCompleteIdle(double seconds) {
+    static char buff[50];
+    return getCompleteIdle_r(seconds, buff, sizeof(buff));
+}
+
+/**
+ * Returns the day of the week or the formatted date into a caller buffer.
+ *
+ * @param aTime The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getWeekDayString_r(time_t aTime, char *buff, size_t size) {
+    // Stesso risultato di strftime("%b %d"), dalla cache per minuto di timefmt
+    return formatMonthDay(aTime, buff, size);
 }
 
 /**
@@ -55,10 +121,19 @@ char* calculateIdleTime(double seconds) {
  */
 char* getWeekDayString(time_t aTime) {
     static char time_buf[32];
-    struct tm *tm_info = localtime(&aTime);
-    // Converte il timestamp in una struttura tm
-    strftime(time_buf, sizeof(time_buf), "%b %d", tm_info);
-    return time_buf;
+    return getWeekDayString_r(aTime, time_buf, sizeof(time_buf));
+}
+
+/**
+ * Returns the formatted hours and minutes into a caller buffer.
+ *
+ * @param aTime The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getTimeHoursMinutes_r(time_t aTime, char *buff, size_t size) {  //Numero di secondi dal 1^gen 1970
+    return formatHoursMinutes(aTime, buff, size); // Formatta il tempo nel formato "HH:MM" (es. "14:30")
 }
 
 /**
@@ -67,11 +142,9 @@ char* getWeekDayString(time_t aTime) {
  * @param aTime The time to format.
  * @return A formatted string representing the hours and minutes.
  */
-char* getTimeHoursMinutes(time_t aTime) {  //Numero di secondi dal 1^gen 1970
+char* getTimeHoursMinutes(time_t aTime) {
     static char time_buf[32]; //Buffer statico per il tempo
-    struct tm *tm_info = localtime(&aTime); //Converte il timestamp in una struttura tm
-    strftime(time_buf, sizeof(time_buf), "%H:%M", tm_info); // Formatta il tempo nel formato "HH:MM" (es. "14:30")
-    return time_buf; //Restituisce il puntatore della stringa formattata
+    return getTimeHoursMinutes_r(aTime, time_buf, sizeof(time_buf)); //Restituisce il puntatore della stringa formattata
 }
 
 /**
@@ -82,20 +155,21 @@ char* getTimeHoursMinutes(time_t aTime) {  //Numero di secondi dal 1^gen 1970
  */
 void parseUserGecos(const char *gecos, UserInfo *userInfo) {
     char buffer[256]; //Buffer per la stringa
+    char *saveptr; //Stato di strtok_r, per non condividere lo stato statico di strtok
 
     //Copia la stringa gecos nel buffer in modo sicuro evitando overflow
     strncpy(buffer, gecos, sizeof(buffer) - 1);
     buffer[sizeof(buffer) - 1] = '\0'; //assicura la stringa sia terminata con "\0"
 
     //Estrazione del primo termine (nome utente)
-    char *token = strtok(buffer, ","); //Divide la stringa in token separati da ",
+    char *token = strtok_r(buffer, ",", &saveptr); //Divide la stringa in token separati da ",
     strncpy(userInfo->name, token ? token : "", sizeof(userInfo->name));
 
     //Estrazione del secondo termine (Posizione ufficio)
-    token = strtok(NULL, ",");
+    token = strtok_r(NULL, ",", &saveptr);
     strncpy(userInfo->officeLocation, token ? token : "", sizeof(userInfo->officeLocation));
 
-    token = strtok(NULL, ",");
+    token = strtok_r(NULL, ",", &saveptr);
     // Se esiste il numero e ha almeno 10 cifre, lo formatta
     if (token && strlen(token) == 10) {
     snprintf(userInfo->officePhone, sizeof(userInfo->officePhone),
@@ -107,53 +181,102 @@ void parseUserGecos(const char *gecos, UserInfo *userInfo) {
 }
 
 /**
- * Populates the UserInfo structure with user information.
+ * Populates the UserInfo structure without touching the filesystem.
+ * The idle time is left empty until applyTtyProbe() is called.
  *
  * @param ut The utmpx structure containing user information.
  * @param pwd The passwd structure containing user information.
- * @return A populated UserInfo structure.
+ * @param userInfo The UserInfo structure to populate.
  */
-UserInfo getUserInfo(struct utmpx *ut, struct passwd *pwd) {
-    UserInfo userInfo;
+void fillUserInfo(struct utmpx *ut, struct passwd *pwd, UserInfo *userInfo) {
+    memset(userInfo, 0, sizeof(*userInfo));
 
     // Copia i valori nei campi della struttura UserInfo
-    strncpy(userInfo.login, ut->ut_user, sizeof(userInfo.login));
-    strncpy(userInfo.directory, pwd->pw_dir, sizeof(userInfo.directory));
-    strncpy(userInfo.shell, pwd->pw_shell, sizeof(userInfo.shell));
-    strncpy(userInfo.tty, ut->ut_line, sizeof(userInfo.tty));
+    strncpy(userInfo->login, ut->ut_user, sizeof(userInfo->login));
+    strncpy(userInfo->directory, pwd->pw_dir, sizeof(userInfo->directory));
+    strncpy(userInfo->shell, pwd->pw_shell, sizeof(userInfo->shell));
+    strncpy(userInfo->tty, ut->ut_line, sizeof(userInfo->tty));
+    userInfo->loginTime = ut->ut_tv.tv_sec;
+    userInfo->idleSeconds = -1;
+    userInfo->mailMessages = -1;
 
     // Estrae le informazioni dal campo GECOS (Nome, Ufficio, Telefono)
-    parseUserGecos(pwd->pw_gecos, &userInfo);
+    parseUserGecos(pwd->pw_gecos, userInfo);
 
     // Formatta e memorizza il giorno della settimana del login
-    strncpy(userInfo.weekDay, getWeekDayString(ut->ut_tv.tv_sec), sizeof(userInfo.weekDay));
+    STAT_BEGIN(STAT_PHASE_TIME);
+    getWeekDayString_r(ut->ut_tv.tv_sec, userInfo->weekDay, sizeof(userInfo->weekDay));
 
     // Formatta e memorizza l'orario esatto del login in formato "HH:MM"
-    strncpy(userInfo.hoursMinutes, getTimeHoursMinutes(ut->ut_tv.tv_sec), sizeof(userInfo.hoursMinutes));
-
-    // Variabile per contenere il tempo di inattività
-    char *idleTime;
-    struct stat f_info;
-    char path[50];
+    getTimeHoursMinutes_r(ut->ut_tv.tv_sec, userInfo->hoursMinutes, sizeof(userInfo->hoursMinutes));
+    STAT_END(STAT_PHASE_TIME);
+}
 
+/**
+ * Computes the idle time of a session from the probe of its terminal.
+ *
+ * @param userInfo The UserInfo structure to update.
+ * @param tty The probe of `/dev/<tty>`, ignored for the console.
+ */
+void applyTtyProbe(UserInfo *userInfo, const FileProbe *tty) {
+    // Il tempo di inattività viene scritto direttamente nella struttura UserInfo
     // Controllo se l'utente è connesso alla console principale
-    if (strcmp(userInfo.tty, "console") == 0) {
+    if (strcmp(userInfo->tty, "console") == 0) {
         // Calcola il tempo di inattività basato sul timestamp di login
-        idleTime = calculateIdleTime(ut->ut_tv.tv_sec);
-    } else {
-        // Costruisce il percorso del terminale virtuale (es. `/dev/pts/1`)
-        snprintf(path, sizeof(path), "/dev/%s", userInfo.tty);
-
+        calculateIdleTime_r(userInfo->loginTime, userInfo->idle, sizeof(userInfo->idle));
+        userInfo->idleSeconds = (long)difftime(time(NULL), userInfo->loginTime);
+    } else if (tty->found) {
         // Se il terminale esiste, calcola il tempo di inattività basato su `st_atime`
-        if (stat(path, &f_info) == 0) {
-            idleTime = calculateIdleTime(f_info.st_atime);  // Usa `st_atime` invece di `st_mtime`
-        } else {
-            idleTime = "";
-        }
+        calculateIdleTime_r(tty->atime, userInfo->idle, sizeof(userInfo->idle));  // Usa `st_atime` invece di `st_mtime`
+        userInfo->idleSeconds = (long)difftime(time(NULL), tty->atime);
+    } else {
+        userInfo->idle[0] = '\0';
+        userInfo->idleSeconds = -1;
     }
+}
+
+/**
+ * Probes a file with a blocking stat() call.
+ *
+ * @param path The path to the file.
+ * @param probe The FileProbe structure to populate.
+ */
+void probeFile(const char *path, FileProbe *probe) {
+    struct stat f_info;
+
+    memset(probe, 0, sizeof(*probe));
+    STAT_ADD(STAT_SYS_STAT, 1);
+    if (stat(path, &f_info) != 0) return; //File assente: found resta a 0
+
+    probe->found = 1;
+    probe->atime = f_info.st_atime;
+    probe->mtime = f_info.st_mtime;
+    probe->mode = f_info.st_mode;
+    probe->size = f_info.st_size;
+    probe->inode = f_info.st_ino;
+    probe->rdev = f_info.st_rdev;
+}
+
+/**
+ * Populates the UserInfo structure with user information.
+ *
+ * @param ut The utmpx structure containing user information.
+ * @param pwd The passwd structure containing user information.
+ * @return A populated UserInfo structure.
+ */
+UserInfo getUserInfo(struct utmpx *ut, struct passwd *pwd) {
+    UserInfo userInfo;
+    FileProbe tty = {0};
+    char path[50];
 
-    // Copia il tempo di inattività calcolato nella struttura UserInfo
-    strncpy(userInfo.idle, idleTime, sizeof(userInfo.idle));
+    fillUserInfo(ut, pwd, &userInfo);
+
+    // Costruisce il percorso del terminale virtuale (es. `/dev/pts/1`) e ne legge `st_atime`
+    if (strcmp(userInfo.tty, "console") != 0) {
+        snprintf(path, sizeof(path), "/dev/%s", userInfo.tty);
+        probeFile(path, &tty);
+    }
+    applyTtyProbe(&userInfo, &tty);
 
     return userInfo; // Restituisce la struttura popolata con i dati dell'utente
 }
@@ -201,76 +324,280 @@ void verifyUserMail(const char *username) {
     // Il percorso del file di posta si trova in "/var/mail/<username>"
     snprintf(mail_path, sizeof(mail_path), "/var/mail/%s", username);
 
-    // Struttura per contenere le informazioni sul file
-    struct stat mail_stat;
-
-    // Controlla se il file di posta esiste
-    // Se il file di posta non esiste, stampiamo un messaggio "No Mail." e usciamo dalla funzione
-    if (stat(mail_path, &mail_stat) != 0) {
-        printf("No Mail.\n");
-        return; // Termina la funzione se non ci sono e-mail
-    }
-
-    // Otteniamo l'ora dell'ultimo accesso al file di posta (quando è stato letto o modificato)
-    time_t mail_mod_time = mail_stat.st_atime;
-
-    // Otteniamo l'orario corrente
-    time_t now = time(NULL);
-
-    // Converte il tempo dell'ultimo accesso in una struttura tm per poterlo formattare
-    struct tm *tm_info = localtime(&mail_mod_time);
+    FileProbe mail;
+    OutBuf out;
+    probeFile(mail_path, &mail);
+    long messages = mail.found ? countMailMessages(NULL, mail_path, &mail) : -1;
+    fflush(stdout); //Mantiene l'ordine con l'output già scritto con printf
+    initOutBuf(&out, STDOUT_FILENO);
+    reportUserMail(&out, &mail, messages);
+    outFlush(&out);
+    freeOutBuf(&out);
+}
 
-    // Stringa per memorizzare l'ora in cui l'email è stata letta
-    char last_read_time[64];
+/**
+ * Appends a time of the mailbox in the format "Mon Apr 05 15:30 2025 (CET)".
+ *
+ * @param out The output buffer.
+ * @param when The time to print.
+ */
+static void outMailTime(OutBuf *out, time_t when) {
+    char text[64];
+    outPuts(out, formatMailTime(when, text, sizeof(text)));
+}
 
-    // Formattta la data dell'ultimo accesso (modifica del file) in un formato leggibile
-    // "%a %b %d %H:%M %Y (%Z)" sarà il formato tipo "Mon Apr 05 15:30 2025 (CET)"
-    strftime(last_read_time, sizeof(last_read_time), "%a %b %d %H:%M %Y (%Z)", tm_info);
+/**
+ * Ends the first line of the mail status with the number of messages, if known.
+ *
+ * @param out The output buffer.
+ * @param messages The number of messages, -1 if unknown.
+ * @param what "message" or "new message".
+ */
+static void outMailCount(OutBuf *out, long messages, const char *what) {
+    char count[24];
+    if (messages >= 0) {
+        snprintf(count, sizeof(count), " (%ld ", messages);
+        outPuts(out, count);
+        outPuts(out, what);
+        outPuts(out, messages == 1 ? ")" : "s)");
+    }
+    outPutc(out, '\n');
+}
 
-    // Variabile per memorizzare il tempo dell'ultimo accesso al file di posta
-    time_t last_access_time = mail_stat.st_atime;
+/**
+ * Prints the mail status from an already probed mailbox: new mail when the
+ * mbox was modified after it was last read, or when the new/ directory of a
+ * Maildir is not empty.
+ *
+ * @param out The buffer that receives the output.
+ * @param mail The probe of the user's mailbox (of new/ for a Maildir).
+ * @param messages The number of messages (in new/ for a Maildir), -1 if unknown.
+ */
+void reportUserMail(OutBuf *out, const FileProbe *mail, long messages) {
+    STAT_BEGIN(STAT_PHASE_MAIL);
+    // Casella assente o mbox vuota: nessuna posta
+    if (!mail->found || (S_ISREG(mail->mode) && mail->size == 0) || (S_ISDIR(mail->mode) && messages < 0)) {
+        outPuts(out, "No Mail.\n");
+        STAT_END(STAT_PHASE_MAIL);
+        return;
+    }
 
-    // Confrontiamo il tempo di ultimo accesso con quello di modifica
-    // Se il tempo di accesso è maggiore o uguale al tempo di modifica, significa che la posta è stata letta
-    if (last_access_time >= mail_mod_time) {
-        printf("Mail last read %s\n", last_read_time); // Stampa l'ora dell'ultimo accesso
+    if (S_ISDIR(mail->mode)) {
+        // Maildir: i messaggi non ancora visti da un client sono in new/
+        if (messages == 0) {
+            outPuts(out, "No unread mail.\n");
+        } else {
+            outPuts(out, "New mail received ");
+            outMailTime(out, mail->mtime);
+            outMailCount(out, messages, "new message");
+        }
+    } else if (mail->mtime > mail->atime) {
+        // La casella è stata modificata (posta consegnata) dopo l'ultima lettura
+        outPuts(out, "New mail received ");
+        outMailTime(out, mail->mtime);
+        outMailCount(out, messages, "message");
+        outPuts(out, "     Unread since ");
+        outMailTime(out, mail->atime);
+        outPutc(out, '\n');
     } else {
-        // Altrimenti, se il tempo di modifica (nuove e-mail ricevute) è maggiore, significa che ci sono nuove e-mail
-        printf("New mail received %s\n", last_read_time); // Stampa che ci sono nuove e-mail
+        // Accesso successivo all'ultima modifica: la posta è stata letta
+        outPuts(out, "Mail last read ");
+        outMailTime(out, mail->atime);
+        outMailCount(out, messages, "message");
     }
+    STAT_END(STAT_PHASE_MAIL);
 }
 
+/**
+ * Checks if a `.plan` file exists in the user's home directory.
+ *
+ * @param home_directory The home directory of the user.
+ * @param owner The uid of the user.
+ */
+void verifyUserPlan(const char *home_directory, uid_t owner)
+{
+    char plan_path[PATH_MAX]; //Buffer per costruire il percorso del file .plan
+    FileProbe plan = {0};
+    OutBuf out;
+    //Un percorso troncato indicherebbe un altro file: reportUserPlan() lo segnala
+    if (snprintf(plan_path, sizeof(plan_path), "%s/.plan", home_directory) < (int)sizeof(plan_path)) {
+        probeFile(plan_path, &plan);
+    }
+    fflush(stdout); //Mantiene l'ordine con l'output già scritto con printf
+    initOutBuf(&out, STDOUT_FILENO);
+    reportUserPlan(&out, home_directory, owner, &plan, NULL);
+    outFlush(&out);
+    freeOutBuf(&out);
+}
 
+/**
+ * Returns the milliseconds of the monotonic clock.
+ *
+ * @return The time in milliseconds.
+ */
+static long long monotonicMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
 
 /**
- * Checks if a `.plan` file exists in the user's home directory.
+ * Returns how much of a block of a `.plan` fits in the line limit.
  *
+ * @param data The block.
+ * @param len The length of the block.
+ * @param lines The lines seen so far, updated.
+ * @param maxLines The line limit, 0 for none.
+ * @return The number of bytes of the block to show.
+ */
+static size_t planLinePrefix(const char *data, size_t len, size_t *lines, size_t maxLines) {
+    if (maxLines == 0) return len;
+    if (*lines >= maxLines) return 0; //Limite raggiunto alla fine del blocco precedente
+
+    const char *p = data, *end = data + len;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        p++;
+        if (++*lines == maxLines) return p - data; //Ultima riga ammessa, newline compreso
+    }
+    return len;
+}
+
+/**
+ * Prints the `.plan` file from an already probed path. Only regular files
+ * owned by the user are shown, never through a symbolic link. The text is read
+ * in chunks and cut at the byte, line and time limits; a file that shrinks
+ * while it is read simply ends earlier. The time limit is checked between
+ * reads: a single open() or read() that hangs is not interrupted.
+ *
+ * @param out The buffer that receives the output.
  * @param home_directory The home directory of the user.
+ * @param owner The uid of the user.
+ * @param plan The probe of the `.plan` file.
+ * @param limits The limits to apply, NULL for the defaults.
  */
-void verifyUserPlan(const char *home_directory)
+void reportUserPlan(OutBuf *out, const char *home_directory, uid_t owner, const FileProbe *plan,
+                    const PlanLimits *limits)
 {
-    char plan_path[256]; //Buffer per costruire il percorso del file .plan
-    snprintf(plan_path, sizeof(plan_path), "%s/.plan", home_directory);
+    static const PlanLimits defaults = {PLAN_MAX_BYTES, PLAN_MAX_LINES, PLAN_TIMEOUT_MS};
+    char plan_path[PATH_MAX]; //Buffer per costruire il percorso del file .plan
+    if (limits == NULL) limits = &defaults;
 
-    //Costruisce il percorso del file .plan nella home dell'utente
-    if (!verifyIfFileExists(plan_path)) {
-        printf("No Plan.\n");
+    //Una home più lunga di PATH_MAX non si può aprire: il percorso troncato sarebbe un altro file
+    if (snprintf(plan_path, sizeof(plan_path), "%s/.plan", home_directory) >= (int)sizeof(plan_path)) {
+        outPuts(out, "Plan not shown: path too long.\n");
         return;
     }
-
     //Controlla se il file .plan esiste
-    FILE *file = fopen(plan_path, "r");
-    if (!file) {
-        perror("Errore apertura file .plan");
+    if (!plan->found) {
+        outPuts(out, "No Plan.\n");
+        return;
+    }
+    //FIFO, dispositivi e directory non vengono aperti: una FIFO bloccherebbe l'intero elenco
+    if (!S_ISREG(plan->mode)) {
+        outPuts(out, "Plan not shown: not a regular file.\n");
         return;
     }
 
+    STAT_BEGIN(STAT_PHASE_PLAN);
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    //Nessun collegamento simbolico: chi esegue myFinger (anche root con --serve) non legge file altrui.
+    //O_NONBLOCK non rende interrompibili le letture di un file regolare: evita solo che una FIFO
+    //sostituita al file dopo la stat blocchi l'apertura
+    int fd = open(plan_path, O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY | O_NOFOLLOW);
+    struct stat st;
+    if (fd < 0 && errno == ELOOP) {
+        outPuts(out, "Plan not shown: not a regular file.\n");
+        STAT_END(STAT_PHASE_PLAN);
+        return;
+    }
+    if (fd < 0) {
+        perror("Errore apertura file .plan");
+        STAT_END(STAT_PHASE_PLAN);
+        return;
+    }
+    //Il file potrebbe essere stato sostituito dopo la stat iniziale
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        outPuts(out, "Plan not shown: not a regular file.\n");
+        close(fd);
+        STAT_END(STAT_PHASE_PLAN);
+        return;
+    }
+    //Solo il file dell'utente: un collegamento fisico a un file altrui ha un altro proprietario
+    if (st.st_uid != owner) {
+        outPuts(out, "Plan not shown: not owned by the user.\n");
+        close(fd);
+        STAT_END(STAT_PHASE_PLAN);
+        return;
+    }
 
-    printf("Plan:\n");
-    char line[256]; //Buffer per memorizzare ogni riga del file
-    while (fgets(line, sizeof(line), file)) {
-        printf("%s", line);
+    outPuts(out, "Plan:\n");
+    long long deadline = limits->timeoutMs > 0 ? monotonicMs() + limits->timeoutMs : 0;
+    size_t size = st.st_size;
+    size_t limit = limits->maxBytes && size > limits->maxBytes ? limits->maxBytes : size;
+    size_t shown = 0, lines = 0;
+    int truncated = 0;
+    char last = '\n';
+
+    //Lettura a blocchi: un file accorciato nel frattempo finisce prima, senza SIGBUS. Il tempo
+    //massimo si controlla tra una read() e l'altra: una read() bloccata (es. NFS non raggiungibile)
+    //non viene interrotta
+    char buf[PLAN_READ_CHUNK];
+    while (shown < limit) {
+        if (deadline && monotonicMs() > deadline) {
+            truncated = 1;
+            break;
+        }
+        ssize_t n = read(fd, buf, limit - shown < sizeof(buf) ? limit - shown : sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break; //Fine del file (anche se più corto della stat) o errore
+        STAT_ADD(STAT_SYS_READ, 1);
+        size_t take = planLinePrefix(buf, n, &lines, limits->maxLines);
+        outWrite(out, buf, take);
+        shown += take;
+        if (take > 0) last = buf[take - 1];
+        if (take < (size_t)n) {
+            truncated = 1;
+            break;
+        }
     }
+    //Limite di byte raggiunto su un file più lungo
+    if (shown == limit && limit < size) truncated = 1;
 
-    fclose(file); //Chiude il file per liberare le risorse
-}
\ No newline at end of file
+    if (truncated) outPuts(out, last == '\n' ? "[.plan truncated]\n" : "\n[.plan truncated]\n");
+    close(fd); //Chiude il file per liberare le risorse
+    STAT_END(STAT_PHASE_PLAN);
+}
+
+/**
+ * Writes the path of a file kept between runs.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @param name The name of the file.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int cacheFilePath(char *buf, size_t size, const char *name) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int len;
+
+    if (xdg != NULL && xdg[0] == '/') len = snprintf(buf, size, "%s/myFinger/%s", xdg, name);
+    else if (home != NULL && home[0] == '/') len = snprintf(buf, size, "%s/.cache/myFinger/%s", home, name);
+    else return -1;
+    return len > 0 && (size_t)len < size ? 0 : -1;
+}
+
+/**
+ * Creates the missing directories of a path.
+ *
+ * @param path The path of a file.
+ */
+void makeParentDirectories(const char *path) {
+    char dir[512];
+    if (snprintf(dir, sizeof(dir), "%s", path) >= (int)sizeof(dir)) return;
+    for (char *slash = strchr(dir + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(dir, 0700);
+        *slash = '/';
+    }
+}
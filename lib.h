@@ -2,7 +2,47 @@
 #ifndef LIB_H
 #define LIB_H
 
+#include <stdbool.h> //Per il tipo bool
+#include <stddef.h> //Per size_t
 #include <time.h> //Per la gestione del tempo
+#include <sys/types.h> //Per i tipi mode_t, off_t, ino_t, dev_t e uid_t
+#include <pwd.h> //Per la struttura passwd
+#include <utmpx.h> //Per la struttura utmpx
+#include "outbuf.h"
+
+/**
+ * Result of a stat probe on a file needed for rendering (tty, mailbox, .plan).
+ */
+typedef struct {
+    int found;      /**< 1 if the file exists, 0 otherwise */
+    time_t atime;   /**< Last access time */
+    time_t mtime;   /**< Last modification time */
+    mode_t mode;    /**< File type and permission bits */
+    off_t size;     /**< File size in bytes */
+    ino_t inode;    /**< Inode number */
+    dev_t rdev;     /**< Device number, for a device file */
+} FileProbe;
+
+/**
+ * Default limits applied to `.plan` files: bytes, lines and milliseconds.
+ */
+#define PLAN_MAX_BYTES 65536
+#define PLAN_MAX_LINES 1000
+#define PLAN_TIMEOUT_MS 2000
+
+/**
+ * Bytes of a `.plan` read per call, the granularity of the time limit.
+ */
+#define PLAN_READ_CHUNK 16384
+
+/**
+ * Limits on the `.plan` shown for each user. A limit of 0 means no limit.
+ */
+typedef struct {
+    size_t maxBytes;  /**< Maximum number of bytes shown */
+    size_t maxLines;  /**< Maximum number of lines shown */
+    int timeoutMs;    /**< Time after which no further chunk is read (a blocked read is not interrupted) */
+} PlanLimits;
 
 /**
  * Structure to hold user information.
@@ -18,8 +58,39 @@ typedef struct {
     char hoursMinutes[32];   /**< Hours and minutes */
     char officePhone[32];    /**< Office phone number */
     char officeLocation[32]; /**< Office location */
+    time_t loginTime;        /**< Login time of the session */
+    long idleSeconds;        /**< Idle time in seconds, -1 if unknown */
+    FileProbe mail;          /**< Probe of the user's mailbox */
+    long mailMessages;       /**< Messages in the mailbox (in new/ for a Maildir), -1 if unknown */
+    FileProbe plan;          /**< Probe of the user's `.plan` file */
 } UserInfo;
 
+/*
+ * Every function returning a string has a reentrant `_r` variant that writes
+ * into a caller buffer; the variants without suffix return a static buffer
+ * and must not be used from more than one thread.
+ */
+
+/**
+ * Generates a formatted string of idle time into a caller buffer.
+ *
+ * @param seconds The number of seconds of idle time.
+ * @param detailed If true, provides a detailed format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getIdleTimeFormatted_r(double seconds, bool detailed, char *buff, size_t size);
+
+/**
+ * Generates a formatted string of idle time.
+ *
+ * @param seconds The number of seconds of idle time.
+ * @param detailed If true, provides a detailed format.
+ * @return A formatted string representing the idle time.
+ */
+char* getIdleTimeFormatted(double seconds, bool detailed);
+
 /**
  * Calculates the idle time from the given seconds.
  *
@@ -28,6 +99,16 @@ typedef struct {
  */
 char* calculateIdleTime(double seconds);
 
+/**
+ * Calculates the idle time from the given seconds into a caller buffer.
+ *
+ * @param seconds The number of seconds since the last activity.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* calculateIdleTime_r(double seconds, char *buff, size_t size);
+
 /**
  * Gets the complete idle time from the given seconds.
  *
@@ -36,6 +117,16 @@ char* calculateIdleTime(double seconds);
  */
 char* getCompleteIdle(double seconds);
 
+/**
+ * Gets the complete idle time from the given seconds into a caller buffer.
+ *
+ * @param seconds The number of seconds since the last activity.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getCompleteIdle_r(double seconds, char *buff, size_t size);
+
 /**
  * Returns the day of the week or the formatted date.
  *
@@ -44,6 +135,16 @@ char* getCompleteIdle(double seconds);
  */
 char* getWeekDayString(time_t aTime);
 
+/**
+ * Returns the day of the week or the formatted date into a caller buffer.
+ *
+ * @param aTime The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getWeekDayString_r(time_t aTime, char *buff, size_t size);
+
 /**
  * Returns the formatted hours and minutes.
  *
@@ -52,6 +153,16 @@ char* getWeekDayString(time_t aTime);
  */
 char* getTimeHoursMinutes(time_t aTime);
 
+/**
+ * Returns the formatted hours and minutes into a caller buffer.
+ *
+ * @param aTime The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char* getTimeHoursMinutes_r(time_t aTime, char *buff, size_t size);
+
 /**
  * Extracts user information from the GECOS field.
  *
@@ -69,6 +180,32 @@ void parseUserGecos(const char *gecos, UserInfo *userInfo);
  */
 UserInfo getUserInfo(struct utmpx *ut, struct passwd *pwd);
 
+/**
+ * Populates the UserInfo structure without touching the filesystem.
+ * The idle time is left empty until applyTtyProbe() is called.
+ *
+ * @param ut The utmpx structure containing user information.
+ * @param pwd The passwd structure containing user information.
+ * @param userInfo The UserInfo structure to populate.
+ */
+void fillUserInfo(struct utmpx *ut, struct passwd *pwd, UserInfo *userInfo);
+
+/**
+ * Computes the idle time of a session from the probe of its terminal.
+ *
+ * @param userInfo The UserInfo structure to update.
+ * @param tty The probe of `/dev/<tty>`, ignored for the console.
+ */
+void applyTtyProbe(UserInfo *userInfo, const FileProbe *tty);
+
+/**
+ * Probes a file with a blocking stat() call.
+ *
+ * @param path The path to the file.
+ * @param probe The FileProbe structure to populate.
+ */
+void probeFile(const char *path, FileProbe *probe);
+
 /**
  * Checks if a user is already present in the array.
  *
@@ -94,11 +231,58 @@ int verifyIfFileExists(const char *path);
  */
 void verifyUserMail(const char *username);
 
+/**
+ * Prints the mail status from an already probed mailbox: new mail when the
+ * mbox was modified after it was last read, or when the new/ directory of a
+ * Maildir is not empty.
+ *
+ * @param out The buffer that receives the output.
+ * @param mail The probe of the user's mailbox (of new/ for a Maildir).
+ * @param messages The number of messages (in new/ for a Maildir), -1 if unknown.
+ */
+void reportUserMail(OutBuf *out, const FileProbe *mail, long messages);
+
 /**
  * Checks if a `.plan` file exists in the user's home directory.
  *
  * @param home_directory The home directory of the user.
+ * @param owner The uid of the user.
+ */
+void verifyUserPlan(const char *home_directory, uid_t owner);
+
+/**
+ * Prints the `.plan` file from an already probed path. Only regular files
+ * owned by the user are shown, never through a symbolic link, so a server
+ * running as root cannot be made to print someone else's file. The text is
+ * read in chunks and cut at the byte, line and time limits; a file that
+ * shrinks while it is read simply ends earlier. The time limit is checked
+ * between reads: a single open() or read() that hangs is not interrupted.
+ *
+ * @param out The buffer that receives the output.
+ * @param home_directory The home directory of the user.
+ * @param owner The uid of the user.
+ * @param plan The probe of the `.plan` file.
+ * @param limits The limits to apply, NULL for the defaults.
+ */
+void reportUserPlan(OutBuf *out, const char *home_directory, uid_t owner, const FileProbe *plan,
+                    const PlanLimits *limits);
+
+/**
+ * Writes the path of a file kept between runs:
+ * $XDG_CACHE_HOME/myFinger/NAME, or ~/.cache/myFinger/NAME.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @param name The name of the file.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int cacheFilePath(char *buf, size_t size, const char *name);
+
+/**
+ * Creates the missing directories of a path, e.g. ~/.cache/myFinger, readable only by the user.
+ *
+ * @param path The path of a file.
  */
-void verifyUserPlan(const char *home_directory);
+void makeParentDirectories(const char *path);
 
 #endif
\ No newline at end of file
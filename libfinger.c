@@ -0,0 +1,303 @@
+#include <stdio.h> //Per snprintf()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per ENOMEM
+#include <sys/stat.h> //Per i tipi di casella di posta
+#include "libfinger.h"
+#include "snapshot.h"
+#include "finger.h"
+#include "mail.h"
+
+/**
+ * A snapshot of the API: the live state and the context that renders from it.
+ */
+struct finger_snapshot {
+    LiveSnapshot live;  /**< utmpx, passwd and mail spool kept current */
+    FingerContext ctx;  /**< Context over live */
+};
+
+/**
+ * An iteration over the sessions of a snapshot.
+ */
+struct finger_session_iter {
+    SessionTable table;  /**< Every session, probed if idle times were requested */
+    size_t next;         /**< Row returned by the next call */
+    unsigned fields;     /**< Fields requested */
+};
+
+/**
+ * Storage of one answer of finger_query_batch(): the strings live in the
+ * arena of the table, the sessions point into it.
+ */
+typedef struct {
+    SessionTable table;          /**< Strings of the user and its sessions */
+    finger_session sessions[];   /**< One per row of table */
+} UserStorage;
+
+/**
+ * Fills a session of the API from a row of a table.
+ *
+ * @param table The session table.
+ * @param row The row.
+ * @param fields The fields requested.
+ * @param session The session to fill.
+ */
+static void fillSession(const SessionTable *table, size_t row, unsigned fields, finger_session *session) {
+    memset(session, 0, sizeof(*session));
+    session->login = sessionString(table, table->login[row]);
+    session->tty = sessionString(table, table->tty[row]);
+    session->login_time = table->loginTime[row];
+    session->idle_seconds = table->idleSeconds[row];
+    if (fields & FINGER_FIELD_NAME) {
+        session->name = sessionString(table, table->name[row]);
+        session->office = sessionString(table, table->office[row]);
+        session->phone = sessionString(table, table->phone[row]);
+    }
+    if (fields & FINGER_FIELD_HOME) {
+        session->directory = sessionString(table, table->directory[row]);
+        session->shell = sessionString(table, table->shell[row]);
+    }
+}
+
+/**
+ * Reads the mailbox of a user like the "Mail" line of myFinger.
+ *
+ * @param ctx The context of the snapshot.
+ * @param login The login name.
+ * @param user The answer to complete.
+ */
+static void probeUserMail(const FingerContext *ctx, const char *login, finger_user *user) {
+    const char *mailDir = ctx->mailDir ? ctx->mailDir : MAIL_SPOOL_DIR;
+    FileProbe mail;
+    char path[512];
+    long messages = -1;
+
+    snprintf(path, sizeof(path), "%s/%s", mailDir, login);
+    const FileProbe *known = ctx->mailboxes ? findMailbox(ctx->mailboxes, login) : NULL;
+    if (known != NULL) mail = *known;
+    else if (ctx->mailboxes != NULL) memset(&mail, 0, sizeof(mail)); //Casella non presente nello spool osservato
+    else probeFile(path, &mail);
+    if (mail.found) messages = countMailMessages(ctx->mailCounts, path, &mail);
+
+    //Stesse regole di reportUserMail()
+    user->mail_messages = messages;
+    if (!mail.found || (S_ISREG(mail.mode) && mail.size == 0) || (S_ISDIR(mail.mode) && messages < 0)) {
+        user->mail_state = FINGER_MAIL_NONE;
+    } else if (S_ISDIR(mail.mode)) {
+        user->mail_state = messages == 0 ? FINGER_MAIL_READ : FINGER_MAIL_NEW;
+        user->mail_time = mail.mtime;
+    } else if (mail.mtime > mail.atime) {
+        user->mail_state = FINGER_MAIL_NEW;
+        user->mail_time = mail.mtime;
+    } else {
+        user->mail_state = FINGER_MAIL_READ;
+        user->mail_time = mail.atime;
+    }
+}
+
+/**
+ * Answers one name.
+ *
+ * @param snapshot The snapshot.
+ * @param name The login name.
+ * @param fields The fields requested.
+ * @param user The answer, already initialized.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int queryUser(finger_snapshot *snapshot, const char *name, unsigned fields, finger_user *user) {
+    const FingerContext *ctx = &snapshot->ctx;
+    struct passwd *pwd = lookupPasswd(ctx->cache, name);
+    if (pwd == NULL) return 0;
+
+    const SessionUser *sessions = findSessionUser(ctx->index, name);
+    size_t count = sessions != NULL && (fields & (FINGER_FIELD_SESSIONS | FINGER_FIELD_IDLE)) ? sessions->count : 0;
+    UserStorage *storage = malloc(sizeof(UserStorage) + count * sizeof(finger_session));
+    PasswdRefs refs;
+
+    if (storage == NULL) return -1;
+    initSessionTable(&storage->table, 0);
+    int failed = internPasswd(&storage->table, pwd, &refs) != 0;
+    for (size_t i = 0; !failed && i < count; i++) failed = appendSession(&storage->table, sessions->sessions[i], pwd) < 0;
+    if (failed) {
+        freeSessionTable(&storage->table);
+        free(storage);
+        return -1;
+    }
+    if (fields & FINGER_FIELD_IDLE) probeSessions(ctx, &storage->table);
+
+    //I puntatori si leggono solo ora: l'arena non cresce più
+    const SessionTable *table = &storage->table;
+    user->found = 1;
+    user->internal = storage;
+    user->last_login = sessions ? sessions->latestLogin : 0;
+    if (fields & FINGER_FIELD_NAME) {
+        user->name = sessionString(table, refs.name);
+        user->office = sessionString(table, refs.office);
+        user->phone = sessionString(table, refs.phone);
+    }
+    if (fields & FINGER_FIELD_HOME) {
+        user->directory = sessionString(table, refs.directory);
+        user->shell = sessionString(table, refs.shell);
+    }
+    for (size_t i = 0; i < table->count; i++) fillSession(table, i, fields, &storage->sessions[i]);
+    user->session_count = table->count;
+    user->sessions = table->count ? storage->sessions : NULL;
+    if (fields & FINGER_FIELD_MAIL) probeUserMail(ctx, pwd->pw_name, user);
+    return 0;
+}
+
+/**
+ * Loads utmpx, passwd and the mail spool once and starts watching them.
+ *
+ * @param snapshot Receives the snapshot.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int finger_snapshot_open(finger_snapshot **snapshot) {
+    finger_snapshot *s = malloc(sizeof(finger_snapshot));
+    if (s == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (openLiveSnapshot(&s->live) != 0) {
+        int saved = errno;
+        free(s);
+        errno = saved;
+        return -1;
+    }
+    snapshotContext(&s->live, &s->ctx);
+    *snapshot = s;
+    return 0;
+}
+
+/**
+ * Applies the changes reported since the last call.
+ *
+ * @param snapshot The snapshot.
+ * @return The number of changes applied.
+ */
+unsigned long finger_snapshot_refresh(finger_snapshot *snapshot) {
+    return updateLiveSnapshot(&snapshot->live);
+}
+
+/**
+ * Returns a descriptor that becomes readable when the snapshot needs a refresh.
+ *
+ * @param snapshot The snapshot.
+ * @return The descriptor, to be polled for POLLIN.
+ */
+int finger_snapshot_fd(const finger_snapshot *snapshot) {
+    return snapshot->live.fd;
+}
+
+/**
+ * Releases a snapshot.
+ *
+ * @param snapshot The snapshot, may be NULL.
+ */
+void finger_snapshot_close(finger_snapshot *snapshot) {
+    if (snapshot == NULL) return;
+    closeLiveSnapshot(&snapshot->live);
+    free(snapshot);
+}
+
+/**
+ * Answers a batch of names from the snapshot.
+ *
+ * @param snapshot The snapshot.
+ * @param names The login names.
+ * @param n The number of names.
+ * @param fields_mask The FINGER_FIELD_* values to compute.
+ * @param out Receives one answer per name.
+ * @return The number of users found, or -1 if memory could not be allocated.
+ */
+int finger_query_batch(finger_snapshot *snapshot, const char *const names[], size_t n, unsigned fields_mask,
+                       finger_user out[]) {
+    int found = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        memset(&out[i], 0, sizeof(finger_user));
+        out[i].login = names[i];
+        out[i].mail_state = FINGER_MAIL_UNKNOWN;
+        out[i].mail_messages = -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (queryUser(snapshot, names[i], fields_mask, &out[i]) != 0) {
+            finger_query_free(out, n);
+            errno = ENOMEM;
+            return -1;
+        }
+        found += out[i].found;
+    }
+    return found;
+}
+
+/**
+ * Releases the answers of finger_query_batch().
+ *
+ * @param out The answers.
+ * @param n The number of answers.
+ */
+void finger_query_free(finger_user out[], size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        UserStorage *storage = out[i].internal;
+        if (storage != NULL) {
+            freeSessionTable(&storage->table);
+            free(storage);
+        }
+        out[i].internal = NULL;
+        out[i].sessions = NULL;
+        out[i].session_count = 0;
+    }
+}
+
+/**
+ * Starts an iteration over every session of the snapshot, in utmpx order.
+ *
+ * @param snapshot The snapshot.
+ * @param fields_mask The FINGER_FIELD_* values to compute.
+ * @return The iterator, or NULL if memory could not be allocated.
+ */
+finger_session_iter *finger_sessions_begin(finger_snapshot *snapshot, unsigned fields_mask) {
+    const FingerContext *ctx = &snapshot->ctx;
+    finger_session_iter *iter = malloc(sizeof(finger_session_iter));
+    if (iter == NULL) return NULL;
+
+    //Stesse sessioni di listLoggedUsers(): quelle con un utente esistente
+    initSessionTable(&iter->table, 0);
+    iter->next = 0;
+    iter->fields = fields_mask;
+    for (size_t i = 0; i < ctx->index->count; i++) {
+        struct utmpx *ut = &ctx->index->sessions[i];
+        struct passwd *pwd = lookupPasswd(ctx->cache, ut->ut_user);
+        if (pwd != NULL && appendSession(&iter->table, ut, pwd) < 0) {
+            finger_sessions_end(iter);
+            return NULL;
+        }
+    }
+    if (fields_mask & FINGER_FIELD_IDLE) probeSessions(ctx, &iter->table);
+    return iter;
+}
+
+/**
+ * Returns the next session.
+ *
+ * @param iter The iterator.
+ * @param session Receives the session.
+ * @return 1 if a session was returned, 0 at the end.
+ */
+int finger_sessions_next(finger_session_iter *iter, finger_session *session) {
+    if (iter->next >= iter->table.count) return 0;
+    fillSession(&iter->table, iter->next++, iter->fields, session);
+    return 1;
+}
+
+/**
+ * Ends an iteration and releases its sessions.
+ *
+ * @param iter The iterator, may be NULL.
+ */
+void finger_sessions_end(finger_session_iter *iter) {
+    if (iter == NULL) return;
+    freeSessionTable(&iter->table);
+    free(iter);
+}
@@ -0,0 +1,176 @@
+// libfinger.h
+#ifndef LIBFINGER_H
+#define LIBFINGER_H
+
+#include <stddef.h> //Per size_t
+#include <time.h> //Per time_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Version of the API below. It changes only when a structure or a function
+ * changes in a way that is not backwards compatible.
+ */
+#define FINGER_API_VERSION 1
+
+/**
+ * Marks the functions exported by libfinger.so; everything else is hidden.
+ */
+#if defined(__GNUC__)
+#define FINGER_API __attribute__((visibility("default")))
+#else
+#define FINGER_API
+#endif
+
+/**
+ * Fields computed by finger_query_batch() and finger_sessions_begin().
+ * Fields not requested are left NULL, 0 or -1, and their cost is not paid.
+ */
+#define FINGER_FIELD_NAME     (1u << 0)  /**< Full name, office and phone from GECOS */
+#define FINGER_FIELD_HOME     (1u << 1)  /**< Home directory and shell */
+#define FINGER_FIELD_SESSIONS (1u << 2)  /**< Terminals and login times of the user */
+#define FINGER_FIELD_IDLE     (1u << 3)  /**< Idle time of every session (one stat per terminal) */
+#define FINGER_FIELD_MAIL     (1u << 4)  /**< State of the mailbox and number of messages */
+#define FINGER_FIELD_ALL      0x1fu
+
+/**
+ * State of a mailbox, as in the "Mail" line of myFinger.
+ */
+#define FINGER_MAIL_UNKNOWN -1  /**< FINGER_FIELD_MAIL was not requested */
+#define FINGER_MAIL_NONE     0  /**< No mailbox, or an empty one */
+#define FINGER_MAIL_NEW      1  /**< Mail delivered after the last read */
+#define FINGER_MAIL_READ     2  /**< Mailbox read after the last delivery */
+
+/**
+ * Users, sessions and mailboxes of the host, kept current with inotify.
+ * A snapshot may be used by one thread at a time.
+ */
+typedef struct finger_snapshot finger_snapshot;
+
+/**
+ * Iterator over the sessions of a snapshot.
+ */
+typedef struct finger_session_iter finger_session_iter;
+
+/**
+ * A login session. The strings stay valid until the result or the iterator
+ * that returned the session is released.
+ */
+typedef struct {
+    const char *login;      /**< Login name */
+    const char *tty;        /**< Terminal */
+    time_t login_time;      /**< Login time */
+    long idle_seconds;      /**< Idle time, -1 if unknown or not requested */
+    const char *name;       /**< Full name (FINGER_FIELD_NAME) */
+    const char *office;     /**< Office location (FINGER_FIELD_NAME) */
+    const char *phone;      /**< Office phone (FINGER_FIELD_NAME) */
+    const char *directory;  /**< Home directory (FINGER_FIELD_HOME) */
+    const char *shell;      /**< Shell (FINGER_FIELD_HOME) */
+} finger_session;
+
+/**
+ * The answer for one name of finger_query_batch().
+ */
+typedef struct {
+    const char *login;                /**< The name that was asked for */
+    int found;                        /**< 1 if the user exists, 0 otherwise */
+    const char *name;                 /**< Full name (FINGER_FIELD_NAME) */
+    const char *office;               /**< Office location (FINGER_FIELD_NAME) */
+    const char *phone;                /**< Office phone (FINGER_FIELD_NAME) */
+    const char *directory;            /**< Home directory (FINGER_FIELD_HOME) */
+    const char *shell;                /**< Shell (FINGER_FIELD_HOME) */
+    size_t session_count;             /**< Number of sessions (FINGER_FIELD_SESSIONS) */
+    const finger_session *sessions;   /**< Sessions in utmpx order (FINGER_FIELD_SESSIONS) */
+    time_t last_login;                /**< Most recent login, 0 if the user is not logged in */
+    int mail_state;                   /**< One of FINGER_MAIL_* */
+    long mail_messages;               /**< Messages (new ones for a Maildir), -1 if unknown */
+    time_t mail_time;                 /**< Time of the last delivery (NEW) or read (READ) */
+    void *internal;                   /**< Owned by the library, see finger_query_free() */
+} finger_user;
+
+/**
+ * Loads utmpx, passwd and the mail spool once and starts watching them.
+ *
+ * @param snapshot Receives the snapshot.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+FINGER_API int finger_snapshot_open(finger_snapshot **snapshot);
+
+/**
+ * Applies the changes reported since the last call, rereading only the
+ * sessions, passwd lines and mailboxes that changed. Cheap when nothing did.
+ *
+ * @param snapshot The snapshot.
+ * @return The number of changes applied.
+ */
+FINGER_API unsigned long finger_snapshot_refresh(finger_snapshot *snapshot);
+
+/**
+ * Returns a descriptor that becomes readable when the snapshot needs a refresh.
+ *
+ * @param snapshot The snapshot.
+ * @return The descriptor, to be polled for POLLIN.
+ */
+FINGER_API int finger_snapshot_fd(const finger_snapshot *snapshot);
+
+/**
+ * Releases a snapshot.
+ *
+ * @param snapshot The snapshot, may be NULL.
+ */
+FINGER_API void finger_snapshot_close(finger_snapshot *snapshot);
+
+/**
+ * Answers a batch of names from the snapshot, like "myFinger name...".
+ *
+ * @param snapshot The snapshot.
+ * @param names The login names.
+ * @param n The number of names.
+ * @param fields_mask The FINGER_FIELD_* values to compute.
+ * @param out Receives one answer per name; release them with finger_query_free().
+ * @return The number of users found, or -1 if memory could not be allocated
+ *         (out is then released already).
+ */
+FINGER_API int finger_query_batch(finger_snapshot *snapshot, const char *const names[], size_t n,
+                                  unsigned fields_mask, finger_user out[]);
+
+/**
+ * Releases the answers of finger_query_batch().
+ *
+ * @param out The answers.
+ * @param n The number of answers.
+ */
+FINGER_API void finger_query_free(finger_user out[], size_t n);
+
+/**
+ * Starts an iteration over every session of the snapshot, in utmpx order.
+ *
+ * @param snapshot The snapshot.
+ * @param fields_mask The FINGER_FIELD_* values to compute (SESSIONS is implied).
+ * @return The iterator, or NULL if memory could not be allocated.
+ */
+FINGER_API finger_session_iter *finger_sessions_begin(finger_snapshot *snapshot, unsigned fields_mask);
+
+/**
+ * Returns the next session.
+ *
+ * @param iter The iterator.
+ * @param session Receives the session, valid until finger_sessions_end().
+ * @return 1 if a session was returned, 0 at the end.
+ */
+FINGER_API int finger_sessions_next(finger_session_iter *iter, finger_session *session);
+
+/**
+ * Ends an iteration and releases its sessions.
+ *
+ * @param iter The iterator, may be NULL.
+ */
+FINGER_API void finger_sessions_end(finger_session_iter *iter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,478 @@
+#define _GNU_SOURCE //Per O_NOATIME
+#include <stdio.h> //Per snprintf()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <dirent.h> //Per leggere la directory della posta
+#include <fcntl.h> //Per open()
+#include <errno.h> //Per EINTR
+#include <unistd.h> //Per read(), write() e close()
+#include <sys/stat.h> //Per fstat() e mkdir()
+#include "mail.h"
+#include "stats.h"
+
+/**
+ * Identifies the count cache file and its layout.
+ */
+#define MAIL_COUNT_MAGIC "MYMC"
+#define MAIL_COUNT_VERSION 1
+
+/**
+ * Bytes of an mbox read per call while counting its messages.
+ */
+#define MAIL_READ_CHUNK 65536
+
+/**
+ * Header of the count cache file, followed by `count` MailCount records.
+ */
+typedef struct {
+    char magic[4];     /**< MAIL_COUNT_MAGIC */
+    uint32_t version;  /**< MAIL_COUNT_VERSION */
+    uint64_t count;    /**< Number of records */
+} MailCountHeader;
+
+/**
+ * Computes the hash of a login name (FNV-1a).
+ *
+ * @param login The login name.
+ * @return The hash value.
+ */
+static size_t hashMailbox(const char *login) {
+    size_t hash = 2166136261u;
+    while (*login) {
+        hash ^= (unsigned char)*login++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Finds the slot of a mailbox in the open addressing table.
+ *
+ * @param table The mailbox table.
+ * @param login The login name to look up.
+ * @return The slot holding the mailbox, or the empty slot where it would go.
+ */
+static size_t findMailboxSlot(const MailboxTable *table, const char *login) {
+    size_t mask = table->slotCount - 1;
+    size_t slot = hashMailbox(login) & mask;
+
+    while (table->entries[slot].login != NULL && strcmp(table->entries[slot].login, login) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Initializes an empty mailbox table.
+ *
+ * @param table The MailboxTable structure to initialize.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int initMailboxTable(MailboxTable *table) {
+    memset(table, 0, sizeof(*table));
+    table->slotCount = 64;
+    table->entries = calloc(table->slotCount, sizeof(MailboxEntry));
+    return table->entries ? 0 : -1;
+}
+
+/**
+ * Probes every mailbox in a spool directory and stores it in the table.
+ *
+ * @param table The mailbox table.
+ * @param spoolDir The spool directory (usually MAIL_SPOOL_DIR).
+ * @return The number of mailboxes found, or -1 if the directory cannot be read.
+ */
+long scanMailSpool(MailboxTable *table, const char *spoolDir) {
+    DIR *dir = opendir(spoolDir);
+    struct dirent *entry;
+    char path[512];
+    long found = 0;
+
+    if (dir == NULL) return -1;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue; //Salta ".", ".." e i file nascosti (lock)
+        FileProbe probe;
+        snprintf(path, sizeof(path), "%s/%s", spoolDir, entry->d_name);
+        probeFile(path, &probe);
+        if (probe.found && setMailbox(table, entry->d_name, &probe) == 0) found++;
+    }
+    closedir(dir);
+    return found;
+}
+
+/**
+ * Stores the state of a mailbox, replacing the previous one.
+ * A probe with found == 0 records a mailbox that no longer exists.
+ *
+ * @param table The mailbox table.
+ * @param login The login (name of the mailbox).
+ * @param probe The new state of the mailbox.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int setMailbox(MailboxTable *table, const char *login, const FileProbe *probe) {
+    size_t slot = findMailboxSlot(table, login);
+    if (table->entries[slot].login != NULL) {
+        table->entries[slot].probe = *probe;
+        return 0;
+    }
+
+    //Raddoppia la tabella quando è piena per metà
+    if ((table->count + 1) * 2 > table->slotCount) {
+        MailboxEntry *old = table->entries;
+        size_t oldCount = table->slotCount;
+        MailboxEntry *grown = calloc(oldCount * 2, sizeof(MailboxEntry));
+        if (grown == NULL) return -1;
+        table->entries = grown;
+        table->slotCount = oldCount * 2;
+        for (size_t i = 0; i < oldCount; i++) {
+            if (old[i].login != NULL) table->entries[findMailboxSlot(table, old[i].login)] = old[i];
+        }
+        free(old);
+        slot = findMailboxSlot(table, login);
+    }
+
+    table->entries[slot].login = strdup(login);
+    if (table->entries[slot].login == NULL) return -1;
+    table->entries[slot].probe = *probe;
+    table->count++;
+    return 0;
+}
+
+/**
+ * Returns the last known state of a mailbox.
+ *
+ * @param table The mailbox table.
+ * @param login The login (name of the mailbox).
+ * @return The probe of the mailbox, or NULL if it is not in the table.
+ */
+const FileProbe *findMailbox(const MailboxTable *table, const char *login) {
+    size_t slot = findMailboxSlot(table, login);
+    return table->entries[slot].login ? &table->entries[slot].probe : NULL;
+}
+
+/**
+ * Releases the memory held by the mailbox table.
+ *
+ * @param table The mailbox table to free.
+ */
+void freeMailboxTable(MailboxTable *table) {
+    for (size_t i = 0; i < table->slotCount; i++) free(table->entries[i].login);
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+/**
+ * Computes the 64-bit hash of a mailbox path (FNV-1a), never 0.
+ *
+ * @param path The path.
+ * @return The hash value.
+ */
+static uint64_t hashMailPath(const char *path) {
+    uint64_t hash = 14695981039346656037ull;
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 1099511628211ull;
+    }
+    return hash ? hash : 1; //0 indica uno slot vuoto
+}
+
+/**
+ * Finds the slot of a mailbox in the count cache.
+ *
+ * @param cache The count cache.
+ * @param pathHash The hash of the mailbox path.
+ * @return The slot holding the count, or the empty slot where it would go.
+ */
+static size_t findMailCountSlot(const MailCountCache *cache, uint64_t pathHash) {
+    size_t mask = cache->slotCount - 1;
+    size_t slot = pathHash & mask;
+
+    while (cache->entries[slot].pathHash != 0 && cache->entries[slot].pathHash != pathHash) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Stores a count in the cache, replacing the previous one of the same path.
+ *
+ * @param cache The count cache.
+ * @param count The count to store.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int storeMailCount(MailCountCache *cache, const MailCount *count) {
+    size_t slot = findMailCountSlot(cache, count->pathHash);
+    if (cache->entries[slot].pathHash == 0) {
+        //Raddoppia la tabella quando è piena per metà
+        if ((cache->count + 1) * 2 > cache->slotCount) {
+            MailCount *old = cache->entries;
+            size_t oldCount = cache->slotCount;
+            MailCount *grown = calloc(oldCount * 2, sizeof(MailCount));
+            if (grown == NULL) return -1;
+            cache->entries = grown;
+            cache->slotCount = oldCount * 2;
+            for (size_t i = 0; i < oldCount; i++) {
+                if (old[i].pathHash != 0) cache->entries[findMailCountSlot(cache, old[i].pathHash)] = old[i];
+            }
+            free(old);
+            slot = findMailCountSlot(cache, count->pathHash);
+        }
+        cache->count++;
+    }
+    cache->entries[slot] = *count;
+    return 0;
+}
+
+/**
+ * Counts the messages in a block of an mbox: the first line and every line
+ * starting with "From ". A separator may span two blocks.
+ *
+ * @param data The block.
+ * @param len The length of the block.
+ * @param matched Bytes of "From " matched at the start of the current line,
+ *                -1 in the middle of a line; 0 before the first block, updated.
+ * @return The number of messages that start in the block.
+ */
+static long countMboxSeparators(const char *data, size_t len, int *matched) {
+    static const char separator[] = "From ";
+    const char *p = data, *end = data + len;
+    long messages = 0;
+
+    while (p < end) {
+        if (*matched >= 0) {
+            //Confronto con "From " all'inizio della riga, ripreso dal blocco precedente
+            while (p < end && *matched < 5 && *p == separator[*matched]) {
+                p++;
+                (*matched)++;
+            }
+            if (*matched == 5) messages++;
+            else if (p == end) break;
+            *matched = -1;
+        }
+        //memchr() della glibc confronta 16-32 byte per istruzione: il costo è quasi solo la lettura
+        p = memchr(p, '\n', end - p);
+        if (p == NULL) break;
+        p++;
+        *matched = 0;
+    }
+    return messages;
+}
+
+/**
+ * Counts the messages of an mbox file, updating the probe with the state
+ * of the file that was actually read. The file is read in chunks up to the
+ * size seen by fstat(): a mailbox truncated meanwhile just ends earlier.
+ *
+ * @param path The path of the mbox.
+ * @param probe The probe of the mbox.
+ * @return The number of messages, or -1 if the file cannot be read.
+ */
+static long countMboxFile(const char *path, FileProbe *probe) {
+    struct stat st;
+    long messages = 0;
+    char buf[MAIL_READ_CHUNK];
+    int matched = 0;
+
+    //Senza O_NOATIME la lettura segnerebbe come letta la posta nuova: in quel caso niente conteggio
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK | O_NOATIME);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    probe->atime = st.st_atime;
+    probe->mtime = st.st_mtime;
+    probe->size = st.st_size;
+    probe->inode = st.st_ino;
+
+    for (off_t left = st.st_size; left > 0;) {
+        ssize_t n = read(fd, buf, left < (off_t)sizeof(buf) ? (size_t)left : sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            close(fd);
+            return -1;
+        }
+        if (n == 0) break; //Fine del file prima della dimensione vista da fstat()
+        STAT_ADD(STAT_SYS_READ, 1);
+        messages += countMboxSeparators(buf, n, &matched);
+        left -= n;
+    }
+    close(fd);
+    STAT_ADD(STAT_MAIL_SCANS, 1);
+    return messages;
+}
+
+/**
+ * Counts the messages waiting in the new/ directory of a Maildir.
+ *
+ * @param newDir The path of new/.
+ * @return The number of messages, or -1 if the directory cannot be read.
+ */
+static long countMaildirNew(const char *newDir) {
+    DIR *dir = opendir(newDir);
+    struct dirent *entry;
+    long messages = 0;
+
+    if (dir == NULL) return -1;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') messages++; //Salta ".", ".." e i file temporanei
+    }
+    closedir(dir);
+    STAT_ADD(STAT_MAIL_SCANS, 1);
+    return messages;
+}
+
+/**
+ * Counts the messages of a mailbox: the "From " separators of an mbox, or the
+ * files in new/ for a Maildir. For a Maildir the probe is replaced with the
+ * state of new/. The count is taken from the cache while inode, size and
+ * mtime are unchanged, so a known mailbox costs only the stat of the probe.
+ * May be called from several threads; the mailbox is read outside the lock.
+ *
+ * @param cache The count cache, NULL to always scan.
+ * @param path The path of the mailbox.
+ * @param probe The probe of the mailbox (found must be 1).
+ * @return The number of messages, or -1 if the mailbox cannot be read.
+ */
+long countMailMessages(MailCountCache *cache, const char *path, FileProbe *probe) {
+    char newDir[512];
+    int maildir = S_ISDIR(probe->mode);
+
+    //Maildir: i messaggi non letti sono i file in new/
+    if (maildir) {
+        snprintf(newDir, sizeof(newDir), "%s/new", path);
+        probeFile(newDir, probe);
+        if (!probe->found) return -1;
+    }
+
+    uint64_t pathHash = hashMailPath(path);
+    if (cache != NULL) {
+        pthread_mutex_lock(&cache->lock);
+        const MailCount *known = &cache->entries[findMailCountSlot(cache, pathHash)];
+        if (known->pathHash == pathHash && known->inode == (uint64_t)probe->inode &&
+            known->size == (int64_t)probe->size && known->mtime == (int64_t)probe->mtime) {
+            long messages = known->messages;
+            pthread_mutex_unlock(&cache->lock);
+            return messages;
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    long messages = maildir ? countMaildirNew(newDir) : countMboxFile(path, probe);
+    //Una casella modificata in questo secondo può cambiare ancora senza che cambi mtime
+    if (messages >= 0 && cache != NULL && probe->mtime < time(NULL)) {
+        MailCount count = {pathHash, probe->inode, probe->size, probe->mtime, messages};
+        pthread_mutex_lock(&cache->lock);
+        if (storeMailCount(cache, &count) == 0) cache->dirty = 1;
+        pthread_mutex_unlock(&cache->lock);
+    }
+    return messages;
+}
+
+/**
+ * Initializes an empty count cache.
+ *
+ * @param cache The MailCountCache structure to initialize.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int initMailCountCache(MailCountCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->slotCount = 64;
+    cache->entries = calloc(cache->slotCount, sizeof(MailCount));
+    return cache->entries ? 0 : -1;
+}
+
+/**
+ * Writes the default path of the count cache file:
+ * $XDG_CACHE_HOME/myFinger/mail-counts, or ~/.cache/myFinger/mail-counts.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int mailCountCachePath(char *buf, size_t size) {
+    return cacheFilePath(buf, size, "mail-counts");
+}
+
+/**
+ * Loads the counts saved by saveMailCountCache().
+ *
+ * @param cache The count cache.
+ * @param path The cache file.
+ * @return The number of counts loaded, or -1 if the file is missing or invalid.
+ */
+long loadMailCountCache(MailCountCache *cache, const char *path) {
+    MailCountHeader header;
+    struct stat st;
+    long loaded = 0;
+
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    //Il file deve contenere esattamente l'intestazione e i record annunciati
+    if (fstat(fd, &st) != 0 || read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, MAIL_COUNT_MAGIC, 4) != 0 || header.version != MAIL_COUNT_VERSION ||
+        (uint64_t)st.st_size != sizeof(header) + header.count * sizeof(MailCount)) {
+        close(fd);
+        return -1;
+    }
+
+    MailCount *counts = malloc(header.count ? header.count * sizeof(MailCount) : 1);
+    size_t bytes = header.count * sizeof(MailCount);
+    if (counts == NULL || read(fd, counts, bytes) != (ssize_t)bytes) {
+        free(counts);
+        close(fd);
+        return -1;
+    }
+    STAT_ADD(STAT_SYS_READ, 2);
+    for (uint64_t i = 0; i < header.count; i++) {
+        if (counts[i].pathHash != 0 && storeMailCount(cache, &counts[i]) == 0) loaded++;
+    }
+    free(counts);
+    close(fd);
+    return loaded;
+}
+
+/**
+ * Saves the counts if they changed, replacing the file atomically and
+ * creating its directory if needed.
+ *
+ * @param cache The count cache.
+ * @param path The cache file.
+ * @return 0 on success or if nothing changed, -1 on error.
+ */
+int saveMailCountCache(MailCountCache *cache, const char *path) {
+    char tmp[512];
+    if (!cache->dirty) return 0;
+    if (snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmp)) return -1;
+
+    //Crea le directory mancanti del percorso (es. ~/.cache/myFinger)
+    makeParentDirectories(path);
+
+    FILE *out = fopen(tmp, "wb");
+    if (out == NULL) return -1;
+    MailCountHeader header = {MAIL_COUNT_MAGIC, MAIL_COUNT_VERSION, cache->count};
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (size_t i = 0; ok && i < cache->slotCount; i++) {
+        if (cache->entries[i].pathHash != 0) ok = fwrite(&cache->entries[i], sizeof(MailCount), 1, out) == 1;
+    }
+    if (fclose(out) != 0 || !ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    cache->dirty = 0;
+    return 0;
+}
+
+/**
+ * Releases the memory held by the count cache.
+ *
+ * @param cache The count cache to free.
+ */
+void freeMailCountCache(MailCountCache *cache) {
+    free(cache->entries);
+    pthread_mutex_destroy(&cache->lock);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,156 @@
+// mail.h
+#ifndef MAIL_H
+#define MAIL_H
+
+#include <stddef.h> //Per size_t
+#include <stdint.h> //Per i tipi a larghezza fissa
+#include <pthread.h> //Per il mutex della cache
+#include "lib.h"
+
+/**
+ * Directory holding the users' mailboxes.
+ */
+#define MAIL_SPOOL_DIR "/var/mail"
+
+/**
+ * A mailbox known to the table.
+ */
+typedef struct {
+    char *login;      /**< Name of the mailbox, i.e. the login (NULL for an empty slot) */
+    FileProbe probe;  /**< Last known state of the mailbox */
+} MailboxEntry;
+
+/**
+ * Table of the mailboxes in the spool directory, keyed by login.
+ */
+typedef struct {
+    MailboxEntry *entries; /**< Open addressing table */
+    size_t slotCount;      /**< Size of the table (power of two) */
+    size_t count;          /**< Number of mailboxes in the table */
+} MailboxTable;
+
+/**
+ * Message count of a mailbox, valid while inode, size and mtime are unchanged.
+ */
+typedef struct {
+    uint64_t pathHash; /**< Hash of the mailbox path (0 for an empty slot) */
+    uint64_t inode;    /**< Inode of the mbox, or of new/ for a Maildir */
+    int64_t size;      /**< Size when the messages were counted */
+    int64_t mtime;     /**< Modification time when the messages were counted */
+    int64_t messages;  /**< Messages in the mbox, or files in new/ for a Maildir */
+} MailCount;
+
+/**
+ * Message counts keyed by mailbox path, saved between runs.
+ */
+typedef struct {
+    MailCount *entries; /**< Open addressing table */
+    size_t slotCount;   /**< Size of the table (power of two) */
+    size_t count;       /**< Number of mailboxes in the table */
+    int dirty;          /**< 1 if the table changed since it was loaded */
+    pthread_mutex_t lock; /**< Held while countMailMessages() reads or updates the table */
+} MailCountCache;
+
+/**
+ * Initializes an empty mailbox table.
+ *
+ * @param table The MailboxTable structure to initialize.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int initMailboxTable(MailboxTable *table);
+
+/**
+ * Probes every mailbox in a spool directory and stores it in the table.
+ *
+ * @param table The mailbox table.
+ * @param spoolDir The spool directory (usually MAIL_SPOOL_DIR).
+ * @return The number of mailboxes found, or -1 if the directory cannot be read.
+ */
+long scanMailSpool(MailboxTable *table, const char *spoolDir);
+
+/**
+ * Stores the state of a mailbox, replacing the previous one.
+ * A probe with found == 0 records a mailbox that no longer exists.
+ *
+ * @param table The mailbox table.
+ * @param login The login (name of the mailbox).
+ * @param probe The new state of the mailbox.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int setMailbox(MailboxTable *table, const char *login, const FileProbe *probe);
+
+/**
+ * Returns the last known state of a mailbox.
+ *
+ * @param table The mailbox table.
+ * @param login The login (name of the mailbox).
+ * @return The probe of the mailbox, or NULL if it is not in the table.
+ */
+const FileProbe *findMailbox(const MailboxTable *table, const char *login);
+
+/**
+ * Releases the memory held by the mailbox table.
+ *
+ * @param table The mailbox table to free.
+ */
+void freeMailboxTable(MailboxTable *table);
+
+/**
+ * Counts the messages of a mailbox: the "From " separators of an mbox, or the
+ * files in new/ for a Maildir. For a Maildir the probe is replaced with the
+ * state of new/. The count is taken from the cache while inode, size and
+ * mtime are unchanged, so a known mailbox costs only the stat of the probe.
+ * May be called from several threads; the mailbox is read outside the lock.
+ *
+ * @param cache The count cache, NULL to always scan.
+ * @param path The path of the mailbox.
+ * @param probe The probe of the mailbox (found must be 1).
+ * @return The number of messages, or -1 if the mailbox cannot be read.
+ */
+long countMailMessages(MailCountCache *cache, const char *path, FileProbe *probe);
+
+/**
+ * Initializes an empty count cache.
+ *
+ * @param cache The MailCountCache structure to initialize.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int initMailCountCache(MailCountCache *cache);
+
+/**
+ * Writes the default path of the count cache file:
+ * $XDG_CACHE_HOME/myFinger/mail-counts, or ~/.cache/myFinger/mail-counts.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int mailCountCachePath(char *buf, size_t size);
+
+/**
+ * Loads the counts saved by saveMailCountCache().
+ *
+ * @param cache The count cache.
+ * @param path The cache file.
+ * @return The number of counts loaded, or -1 if the file is missing or invalid.
+ */
+long loadMailCountCache(MailCountCache *cache, const char *path);
+
+/**
+ * Saves the counts if they changed, replacing the file atomically and
+ * creating its directory if needed.
+ *
+ * @param cache The count cache.
+ * @param path The cache file.
+ * @return 0 on success or if nothing changed, -1 on error.
+ */
+int saveMailCountCache(MailCountCache *cache, const char *path);
+
+/**
+ * Releases the memory held by the count cache.
+ *
+ * @param cache The count cache to free.
+ */
+void freeMailCountCache(MailCountCache *cache);
+
+#endif
@@ -8,162 +8,119 @@
 #include <sys/stat.h>
 #include <string.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "lib.h"
+#include "session.h"
+#include "pwcache.h"
+#include "pwindex.h"
+#include "wtmp.h"
+#include "finger.h"
+#include "export.h"
+#include "server.h"
+#include "watch.h"
+#include "userpool.h"
+#include "remote.h"
+#include "publish.h"
+#include "stats.h"
 
 /**
- * Prints user information based on the provided mode.
- * @param userInfo The UserInfo structure containing user information.
- * @param last_login The last login time as a formatted string.
- * @param mode The mode to determine the level of detail to print.
+ * Parses the value of a numeric option such as --plan-max-bytes=N.
+ *
+ * @param text The text after the '='.
+ * @param value Receives the value.
+ * @return 0 on success, -1 if the text is not a number.
  */
-void printUserInfo(UserInfo userInfo, char *last_login, char mode) {
-    // Modalità compatta ('p'): stampa nome, login, terminale, idle time e orario di login
-    if (mode == 'p') {
-        printf("%-15s %-15s %-5s %-8s %-10s %-10s\n",
-               userInfo.login, userInfo.name, userInfo.tty, userInfo.idle,
-               userInfo.weekDay, userInfo.hoursMinutes);
-        return;
-    }
-    // Modalità semplificata ('s'): stampa nome, login, terminale e idle time
-    if (mode == 's') {
-        printf("%-15s %-15s %-5s %-8s\n",
-               userInfo.login, userInfo.name, userInfo.tty, userInfo.idle);
-        return;
-    }
-    // Modalità estesa ('l')
-    if (mode == 'l') {
-        printf("%-15s %-15s %-5s %-8s %-20s %-20s %-10s %-10s %-10s %-12s\n",
-               userInfo.login, userInfo.name, userInfo.tty, userInfo.idle,
-               userInfo.directory, userInfo.shell,
-               userInfo.weekDay, userInfo.hoursMinutes,
-               userInfo.officeLocation, userInfo.officePhone);
-        return;
-    }
-    // Stampa dettagliata se non è 'p' o 's'
-    printf("Login: %-33sName: %s\n", userInfo.login, userInfo.name);
-    printf("Directory: %-29sShell: %s\n", userInfo.directory, userInfo.shell);
-    printf("Office: %s, %s\n", userInfo.officeLocation, userInfo.officePhone);
-    printf("On since %s on %s,       %s (messages off)\n",
-           last_login, userInfo.tty, userInfo.idle);
-
-    if (mode == 'm') return;  // -m: no mail and plan
-    verifyUserMail(userInfo.login);
-    verifyUserPlan(userInfo.directory);
+static int parseLimit(const char *text, size_t *value) {
+    char *end;
+    if (*text < '0' || *text > '9') return -1;
+    unsigned long long n = strtoull(text, &end, 10);
+    if (*end != '\0' || n > SIZE_MAX) return -1;
+    *value = (size_t)n;
+    return 0;
 }
 
 /**
- * Handles the user information retrieval and printing based on the username and mode.
+ * Parses a duration such as --idle-over=90, 90s, 15m, 2h or 1d.
  *
- * @param username The username to handle.
- * @param mode The mode to determine the level of detail to print.
+ * @param text The text after the '='.
+ * @param seconds Receives the duration in seconds.
+ * @return 0 on success, -1 if the text is not a duration.
  */
-void handleUser(char *username, char mode) {
-    struct utmpx *ut; //puntatore per leggere la tabella degli utenti connessi
-    struct passwd *pwd = getpwnam(username); //Recupera informazioni sull'utente del file /etc/passwd
-    //Se l'utente non è trovato, stampa un errore e termina
-    if (pwd == NULL) {
-        fprintf(stderr, "\nUser %s not found!\n\n", username);
-        return;
-    }
-
-    time_t lastLoginTime = 0; //Variabile per memorizzare il timestamp dell'ultimo login
-    char last_login[64]; //Stringa per formattare l'orario dell'ultimo login
-    int user_info_printed = 0; //Flag per evitare di stampare più volte le informazioni dell'utente
-
-    // Resetta la posizione del file utmpx per scorrere gli utenti attivi
-    setutxent();
-    //Scansiona gli utenti attualemente connessi per trovare l'ultimo login dell'utente
-    while ((ut = getutxent()) != NULL) {
-        if (ut->ut_type == USER_PROCESS && strncmp(ut->ut_user, username, __UT_NAMESIZE) == 0) {
-            //Se l'utente ha un timestamp di login più recente, aggiorniamo lastLoginTime
-            if (ut->ut_tv.tv_sec > lastLoginTime) {
-                lastLoginTime = ut->ut_tv.tv_sec;
-            }
-        }
-    }
+static int parseDuration(const char *text, long *seconds) {
+    char *end;
+    if (*text < '0' || *text > '9') return -1;
+    unsigned long n = strtoul(text, &end, 10);
+    long unit = 1;
+    if (*end == 'm') unit = 60;
+    else if (*end == 'h') unit = 3600;
+    else if (*end == 'd') unit = 86400;
+    else if (*end != 's' && *end != '\0') return -1;
+    if (*end != '\0' && end[1] != '\0') return -1;
+    if (n > (unsigned long)LONG_MAX / unit) return -1;
+    *seconds = (long)n * unit;
+    return 0;
+}
 
-    //Converte il timestamp dell'ultimo login in una stringa leggibile
-    struct tm *tm_info = localtime(&lastLoginTime);
-    strftime(last_login, sizeof(last_login), "%a %b %d %H:%M (%Z)", tm_info);
-
-    //Scansiona nuovamente la tabella degli utenti connessi
-    setutxent();
-    while ((ut = getutxent()) != NULL) {
-        if (ut->ut_type == USER_PROCESS && strncmp(ut->ut_user, username, __UT_NAMESIZE) == 0) {
-            //Crea e popola la struttura UserInfo con le informazioni dell'utente
-            UserInfo userInfo = getUserInfo(ut, pwd);
-            //Stampa le informazioni dell'utente se non sono state già stampate
-            if (!user_info_printed) {
-                printUserInfo(userInfo, last_login, mode);
-            }
+/**
+ * Parses the order of --sort.
+ *
+ * @param text The text after the '='.
+ * @param sort Receives the order.
+ * @return 0 on success, -1 if the order is unknown.
+ */
+static int parseSort(const char *text, ListSort *sort) {
+    static const char *const names[] = {"idle", "login", "name", "tty"};
+    static const ListSort sorts[] = {LIST_SORT_IDLE, LIST_SORT_LOGIN, LIST_SORT_NAME, LIST_SORT_TTY};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(text, names[i]) == 0) {
+            *sort = sorts[i];
+            return 0;
         }
     }
+    return -1;
 }
 
 /**
- * Lists all logged-in users with varying levels of detail based on the mode.
+ * Handles the names given on the command line: local usernames first, in
+ * argument order, then the remote queries ("user@host") as one table.
  *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param ctx The data of the run.
+ * @param names The names given on the command line.
+ * @param count The number of names.
  * @param mode The mode to determine the level of detail to print.
+ * @param timeoutMs The time each remote host has to answer, in milliseconds.
  */
-void listLoggedUsers(char mode) {
-    struct utmpx *ut; //puntatore per leggere la tabella degli utenti connessi
-    setutxent(); //Resetta la posizione del file utmpx per scorrere gli utenti attivi
-
-    //Stampa l'intestazione della tabella a seconda della modalità
-    if (mode == 's') {
-        printf("%-15s %-10s %-6s %-8s\n", "Login", "Name", "TTY", "Idle");
-    } else if (mode == 'p') {
-        printf("%-15s %-10s %-6s %-8s %-10s %-10s\n",
-               "Login", "Name", "TTY", "Idle", "Login", "Time");
-    } else if (mode == 'l') {
-        printf("%-15s %-10s %-6s %-8s %-20s %-20s %-10s %-10s %-10s %-12s\n",
-               "Login", "Name", "TTY", "Idle", "Directory", "Shell", "Login", "Time", "Office", "Phone");
-    }else {
-        printf("%-15s %-10s %-6s %-8s %-10s %-10s %-10s %-12s\n",
-               "Login", "Name", "TTY", "Idle", "Login", "Time", "Office", "Phone");
+static void handleNames(OutBuf *out, OutBuf *err, const FingerContext *ctx, char **names, size_t count, char mode,
+                        long timeoutMs) {
+    char **remote = malloc((count ? count : 1) * sizeof(char *));
+    size_t local = 0, remoteCount = 0;
+    FingerContext withLogins = *ctx;
+    LastLoginSet lastLogins;
+
+    if (remote == NULL) return;
+    //Separazione stabile: i nomi locali restano in names, nello stesso ordine
+    for (size_t i = 0; i < count; i++) {
+        if (isRemoteQuery(names[i])) remote[remoteCount++] = names[i];
+        else names[local++] = names[i];
     }
+    //Ultimi login degli utenti non connessi: un'unica lettura di wtmp (all'indietro) o del suo indice per tutti
+    if (findOfflineLogins(ctx, names, local, mode, &lastLogins) == 0) withLogins.lastLogins = &lastLogins;
+    handleUsers(out, err, &withLogins, names, local, mode);
+    if (withLogins.lastLogins != NULL) freeLastLoginSet(&lastLogins);
 
-    //Scansiona tutti gli utenti connessi al sistema
-    while ((ut = getutxent()) != NULL) {
-        if (ut->ut_type == USER_PROCESS) { //Considera solo gli utenti loggati
-            struct passwd *pwd = getpwnam(ut->ut_user); //Ottiene informazioni sull'utente dal file /etc/passwd
-            if (pwd != NULL) { //Se l'utente esiste nel sistema
-                UserInfo userInfo = getUserInfo(ut,
-                                                pwd); //Crea e popola la struttura UserInfo con le informazioni dell'utente
-                if (strcmp(ut->ut_line, "console") == 0) {
-                    strncpy(userInfo.tty, "*console", sizeof(userInfo.tty));
-                } else if (strncmp(ut->ut_line, "pts", 3) == 0) {
-                    snprintf(userInfo.tty, sizeof(userInfo.tty), "*%.30s", ut->ut_line);
-                } else {
-                    strncpy(userInfo.tty, ut->ut_line, sizeof(userInfo.tty));
-                }
-
-
-                //Stampa le informazioni dell'utente in basse alla modalità
-                if (mode == 's') {
-                    printf("%-15s %-10s %-5s %-8s\n",
-                           userInfo.login, userInfo.name, userInfo.tty, userInfo.idle);
-                } else if (mode == 'p') {
-                    printf("%-15s %-10s %-5s %-8s %-10s %-10s\n",
-                           userInfo.login, userInfo.name, userInfo.tty, userInfo.idle,
-                           userInfo.weekDay, userInfo.hoursMinutes);
-                } else if (mode == 'l') {
-                    printf("%-15s %-10s %-5s %-8s %-20s %-20s %-10s %-10s %-10s %-12s\n",
-                           userInfo.login, userInfo.name, userInfo.tty, userInfo.idle,
-                           userInfo.directory, userInfo.shell,
-                           userInfo.weekDay, userInfo.hoursMinutes,
-                           userInfo.officeLocation, userInfo.officePhone);
-                }else {
-                    printf("%-15s %-10s %-5s %-8s %-10s %-10s %-10s %-12s\n",
-                           userInfo.login, userInfo.name, userInfo.tty, userInfo.idle,
-                           userInfo.weekDay, userInfo.hoursMinutes,
-                           userInfo.officeLocation, userInfo.officePhone);
-                }
-            }
-        }
+    if (remoteCount > 0 && ctx->format != EXPORT_TEXT) {
+        //Le risposte remote sono testo libero: non possono diventare record jsonl, csv o bin
+        outFlush(out);
+        outPuts(err, "myFinger: remote queries are only printed as text\n");
+        outFlush(err);
+    } else if (remoteCount > 0) {
+        fingerRemote(out, err, remote, remoteCount, mode, timeoutMs);
     }
-    endutxent(); //Chiude il file utmpx
+    free(remote);
 }
 
 /**
@@ -175,81 +132,200 @@ void listLoggedUsers(char mode) {
  */
 
 int main(int argc, char *argv[]) {
+    SessionIndex index; //Tabella utmpx letta una sola volta per tutta l'esecuzione
+    PasswdCache cache; //Voci di /etc/passwd già risolte in questa esecuzione
+    MailCountCache mailCounts; //Numero di messaggi delle caselle, salvato tra un'esecuzione e l'altra
+    char mailCountsPath[512];
+    PasswdIndex passwdIndex; //Indice di passwd su disco, mappato in memoria
+    char passwdIndexFile[512];
+    ExportFormat format = EXPORT_TEXT; //Formato dei record scelto con --format
+    int stats = 0; //1 con --stats, 2 con --stats=json
+    PlanLimits planLimits = {PLAN_MAX_BYTES, PLAN_MAX_LINES, PLAN_TIMEOUT_MS}; //Limiti sui file .plan
+    size_t remoteTimeout = REMOTE_TIMEOUT_MS; //Tempo concesso a ogni host remoto, in millisecondi
+    ListOptions list = {LIST_SORT_NONE, -1, NULL, 0}; //Ordinamento e filtri dell'elenco degli utenti connessi
+    int listed = 0; //1 se almeno un'opzione di list è stata data
+    ColumnLayout columns; //Colonne dell'elenco scelte con -o
+    int columned = 0; //1 se -o è stata data
+    int status = 0;
 
-    if (argc == 1) { //Caso base
-        listLoggedUsers(0);
+    //Modalità server: risponde alle interrogazioni RFC 1288 fino a SIGINT/SIGTERM
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        char *end;
+        long port = argc == 3 ? strtol(argv[2], &end, 10) : 0;
+        if (argc != 3 || *end != '\0' || port <= 0 || port > 65535) {
+            printf("Usage: myFinger --serve PORT\n");
+            return 1;
+        }
+        return runFingerServer((int)port);
+    }
+
+    //Modalità publisher: mantiene l'elenco delle sessioni in memoria condivisa fino a SIGINT/SIGTERM
+    if (argc >= 2 && strcmp(argv[1], "--publish") == 0) {
+        if (argc != 2) {
+            printf("Usage: myFinger --publish\n");
+            return 1;
+        }
+        return runPublisher();
+    }
+
+    //Indice degli ultimi login: wtmp letto per intero una volta, poi solo i record aggiunti
+    if (argc >= 2 && strcmp(argv[1], "--index-wtmp") == 0) {
+        LastLoginIndex lastLogins;
+        char indexPath[512];
+        if (argc != 2) {
+            printf("Usage: myFinger --index-wtmp\n");
+            return 1;
+        }
+        if (lastLoginIndexPath(indexPath, sizeof(indexPath)) != 0 ||
+            openLastLoginIndex(&lastLogins, indexPath, WTMP_FILE, 1) != 0) {
+            fprintf(stderr, "Unable to index %s\n", WTMP_FILE);
+            return 1;
+        }
+        closeLastLoginIndex(&lastLogins);
         return 0;
     }
-    //Se il primo argomento inizia con "-", significa che è stata passata un'opzione
-    if (argv[1][0] == '-') {
-        char mode = argv[1][1]; // Estrae la modalità dell'argomento passato
 
-        if (strcmp(argv[1], "-ls") == 0) {
-            struct utmpx *ut;
-            setutxent();
-
-            char printedUsers[100][__UT_NAMESIZE]; // Array per tenere traccia degli utenti già stampati
-            int printedCount = 0; // Contatore degli utenti stampati
-
-            while ((ut = getutxent()) != NULL) {
-                if (ut->ut_type == USER_PROCESS) {
-                    int alreadyPrinted = 0;
-
-                    // Controlla se l'utente è già stato stampato
-                    for (int i = 0; i < printedCount; i++) {
-                        if (strncmp(printedUsers[i], ut->ut_user, __UT_NAMESIZE) == 0) {
-                            alreadyPrinted = 1;
-                            break;
-                        }
-                    }
-
-                    // Se l'utente non è stato stampato, lo stampa e lo aggiunge alla lista
-                    if (!alreadyPrinted) {
-                        struct passwd *pwd = getpwnam(ut->ut_user); // Assicura che pwd sia aggiornato per ogni utente
-                        if (pwd != NULL) {
-                            UserInfo userInfo = getUserInfo(ut, pwd);  // Ottieni info dell'utente corretto
-                            time_t login_time = ut->ut_tv.tv_sec;
-                            struct tm *tm_info = localtime(&login_time);
-                            char last_login[64];
-                            strftime(last_login, sizeof(last_login), "%a %b %d %H:%M (%Z)", tm_info);
-
-                            printUserInfo(userInfo, last_login, 0);  // Stampa info dettagliate per ogni utente
-
-                            strncpy(printedUsers[printedCount], ut->ut_user, __UT_NAMESIZE);
-                            printedCount++;
-                            printf("\n");  // Riga vuota per separare gli utenti
-                        }
-                    }
-                }
-            }
-
-            endutxent();
-            return 0;
+    //Modalità watch: elenco aggiornato ogni intervallo (in secondi, anche frazionari) fino a SIGINT/SIGTERM
+    if (argc >= 2 && strcmp(argv[1], "-w") == 0) {
+        char *end = NULL;
+        double seconds = argc == 3 ? strtod(argv[2], &end) : WATCH_INTERVAL_MS / 1000.0;
+        if (argc > 3 || (end != NULL && (end == argv[2] || *end != '\0')) ||
+            !(seconds * 1000 >= WATCH_MIN_INTERVAL_MS) || seconds > 86400) {
+            printf("Usage: myFinger -w [seconds]\n");
+            return 1;
+        }
+        return runWatch((long)(seconds * 1000));
+    }
+
+    //Opzioni lunghe (e -o) prima di quelle di finger: gli argomenti seguenti sono gli stessi di finger
+    while (argc >= 2 && (strncmp(argv[1], "--", 2) == 0 || strcmp(argv[1], "-o") == 0)) {
+        if (strncmp(argv[1], "--format=", 9) == 0 && parseExportFormat(argv[1] + 9, &format) == 0) {
+            //Formato dei record: jsonl, csv o bin
+        } else if (strcmp(argv[1], "--stats") == 0 || strcmp(argv[1], "--stats=json") == 0) {
+            stats = argv[1][7] == '=' ? 2 : 1;
+        } else if (strncmp(argv[1], "--plan-max-bytes=", 17) == 0 && parseLimit(argv[1] + 17, &planLimits.maxBytes) == 0) {
+            //Byte massimi di ogni .plan, 0 per nessun limite
+        } else if (strncmp(argv[1], "--plan-max-lines=", 17) == 0 && parseLimit(argv[1] + 17, &planLimits.maxLines) == 0) {
+            //Righe massime di ogni .plan, 0 per nessun limite
+        } else if (strncmp(argv[1], "--remote-timeout=", 17) == 0 && parseLimit(argv[1] + 17, &remoteTimeout) == 0 &&
+                   remoteTimeout > 0 && remoteTimeout <= 3600000) {
+            //Millisecondi concessi a ogni host di "user@host" per rispondere
+        } else if (strncmp(argv[1], "--sort=", 7) == 0 && parseSort(argv[1] + 7, &list.sort) == 0) {
+            listed = 1; //Ordine dell'elenco: idle, login, name o tty
+        } else if (strncmp(argv[1], "--idle-over=", 12) == 0 && parseDuration(argv[1] + 12, &list.idleOver) == 0) {
+            listed = 1; //Solo le sessioni inattive da almeno la durata indicata
+        } else if (strncmp(argv[1], "--user-glob=", 12) == 0) {
+            list.userGlob = argv[1] + 12; //Solo i login che corrispondono al pattern
+            listed = 1;
+        } else if (strncmp(argv[1], "--limit=", 8) == 0 && parseLimit(argv[1] + 8, &list.limit) == 0 && list.limit > 0) {
+            listed = 1; //Al massimo N righe
+        } else if (strcmp(argv[1], "-o") == 0 && argc >= 3 && parseColumns(&columns, argv[2]) == 0) {
+            //Colonne dell'elenco, es. -o login,tty,idle: l'elenco è l'argomento seguente
+            columned = 1;
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+        } else {
+            printf("Usage: myFinger [--format=text|jsonl|csv|bin] [--stats[=json]] [--plan-max-bytes=N] [--plan-max-lines=N]"
+                   " [--remote-timeout=MS] [--sort=idle|login|name|tty] [--idle-over=DURATION] [--user-glob=PATTERN]"
+                   " [--limit=N] [-o COLUMN,...] [-lmps] [user[@host,...] ...]\n");
+            return 1;
         }
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    //Tempi delle fasi e contatori su stderr alla fine dell'esecuzione
+    if (stats && enableStats() != 0) {
+        fprintf(stderr, "myFinger: --stats is not available in release builds\n");
+        stats = 0;
+    }
 
+    int listing = argc == 1 || (argc == 2 && strlen(argv[1]) == 2 && argv[1][0] == '-' && strchr("lsmp", argv[1][1]) != NULL);
+    if ((listed || columned) && !listing) {
+        fprintf(stderr, "myFinger: --sort, --idle-over, --user-glob, --limit and -o apply only to the list of logged-in users\n");
+        return 1;
+    }
+    //Senza -o valgono le colonne della modalità
+    if (!columned) modeColumns(&columns, argc == 2 ? argv[1][1] : 0, COLUMN_SCOPE_LIST);
 
+    //Elenco delle sessioni già pubblicato da "myFinger --publish": nessuna lettura di utmpx, passwd o terminali
+    //(i comandi in primo piano non sono pubblicati)
+    SessionTable published;
+    if (listing && !listed && !(columns.needs & COLUMN_NEEDS_PROCESS) && loadPublishedSessions(&published) == 0) {
+        OutBuf out;
+        initOutBuf(&out, STDOUT_FILENO);
+        beginExport(&out, format);
+        outputSessionList(&out, format, &published, &columns);
+        outFlush(&out);
+        freeOutBuf(&out);
+        freeSessionTable(&published);
+        if (stats) reportStats(stderr, stats == 2);
+        return 0;
+    }
 
-        //Verifica se l'opzione è valida (controlla che non ci siano caratteri e che sia una modalità accettata
-        if (argv[1][2] != '\0' || (mode != 'l' && mode != 's' && mode != 'm' && mode != 'p')) {
+    if (loadSessionIndex(&index) != 0) {
+        fprintf(stderr, "Unable to read the utmpx table\n");
+        return 1;
+    }
+    if (initPasswdCache(&cache) != 0) {
+        fprintf(stderr, "Unable to allocate the passwd cache\n");
+        freeSessionIndex(&index);
+        return 1;
+    }
+    //Voci di passwd dall'indice mappato (ricostruito se passwd è cambiato o è scaduto): nessuna interrogazione NSS all'avvio
+    if (passwdIndexPath(passwdIndexFile, sizeof(passwdIndexFile)) == 0 &&
+        loadPasswdIndex(&passwdIndex, passwdIndexFile, PASSWD_INDEX_SOURCE) == 0) {
+        cache.index = &passwdIndex;
+    }
+    //Con molte sessioni conviene un'unica enumerazione di getpwent(); con --limit se ne risolvono al più N
+    preloadPasswdCacheFor(&cache, listed && list.limit > 0 && list.limit < index.count ? list.limit : index.count);
+    //Senza cache su disco (es. HOME non impostata) i messaggi sono contati a ogni esecuzione
+    int persistCounts = initMailCountCache(&mailCounts) == 0 && mailCountCachePath(mailCountsPath, sizeof(mailCountsPath)) == 0;
+    if (persistCounts) loadMailCountCache(&mailCounts, mailCountsPath);
+    FingerContext ctx = {&index, &cache, NULL, format, NULL, NULL, &planLimits,
+                         mailCounts.entries ? &mailCounts : NULL, listed ? &list : NULL, NULL, NULL,
+                         columned ? &columns : NULL};
+    OutBuf out, err; //Tutto l'output è composto in memoria e scritto a blocchi con writev()
+    initOutBuf(&out, STDOUT_FILENO);
+    initOutBuf(&err, STDERR_FILENO);
+    beginExport(&out, format);
+
+    if (argc == 1) { //Caso base
+        listLoggedUsers(&out, &ctx, 0);
+    } else if (argv[1][0] == '-') {
+        //Se il primo argomento inizia con "-", significa che è stata passata un'opzione
+        char mode = argv[1][1]; // Estrae la modalità dell'argomento passato
+
+        if (strcmp(argv[1], "-ls") == 0) {
+            listUsersDetailed(&out, &ctx);
+        } else if (argv[1][2] != '\0' || (mode != 'l' && mode != 's' && mode != 'm' && mode != 'p')) {
+            //Verifica se l'opzione è valida (controlla che non ci siano caratteri e che sia una modalità accettata
             printf("Usage: finger [-lmps] [user ...]\n"); //Messaggio di errore in caso di argomento non valido
-            return 1; //Esce coon codice di errore
-        }
-        // Se c'è solo l'opzione (es. ./myFinger -l), elenca gli utenti connessi nel formato richiesto
-        if (argc == 2) {
-            listLoggedUsers(mode);
+            status = 1; //Esce coon codice di errore
+        } else if (argc == 2) {
+            // Se c'è solo l'opzione (es. ./myFinger -l), elenca gli utenti connessi nel formato richiesto
+            listLoggedUsers(&out, &ctx, mode);
         } else {
-            // Se ci sono anche nomi utenti (es. ./myFinger -l user1 user2), li gestisce singolarmente
-            for (int i = 2; i < argc; i++) {
-                handleUser(argv[i], mode);
-            }
+            // Se ci sono anche nomi utenti (es. ./myFinger -l user1 user@host), li gestisce in parallelo
+            handleNames(&out, &err, &ctx, argv + 2, argc - 2, mode, (long)remoteTimeout);
         }
     } else {
         //Se non è stata specificata un'opzione, considera gli argomenti con nomi utenti
-        for (int i = 1; i < argc; i++) {
-            handleUser(argv[i], 0); //Chiamata a handleUser() per ogni utente passato
-        }
+        //handleUser() per ogni utente passato, con l'output nell'ordine degli argomenti
+        handleNames(&out, &err, &ctx, argv + 1, argc - 1, 0, (long)remoteTimeout);
     }
 
-    return 0;
-}
+    outFlush(&out);
+    freeOutBuf(&out);
+    freeOutBuf(&err);
+
+    if (stats) reportStats(stderr, stats == 2);
 
+    if (persistCounts) saveMailCountCache(&mailCounts, mailCountsPath);
+    if (mailCounts.entries != NULL) freeMailCountCache(&mailCounts);
+    if (cache.index != NULL) closePasswdIndex(&passwdIndex);
+    freePasswdCache(&cache);
+    freeSessionIndex(&index);
+    return status;
+}
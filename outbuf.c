@@ -0,0 +1,188 @@
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per EINTR
+#include <sys/uio.h> //Per writev()
+#include "outbuf.h"
+#include "stats.h"
+
+/**
+ * Returns a chunk with free space, adding one when the last is full.
+ * With a descriptor, OUT_FLUSH_CHUNKS full chunks are written first.
+ *
+ * @param out The output buffer.
+ * @return The chunk, or NULL if memory could not be allocated.
+ */
+static OutChunk *currentChunk(OutBuf *out) {
+    if (out->chunkCount > 0 && out->chunks[out->chunkCount - 1].len < OUT_CHUNK_SIZE) {
+        return &out->chunks[out->chunkCount - 1];
+    }
+    if (out->fd >= 0 && out->chunkCount >= OUT_FLUSH_CHUNKS) outFlush(out);
+
+    if (out->chunkCount == out->chunkCapacity) {
+        size_t capacity = out->chunkCapacity ? out->chunkCapacity * 2 : 4;
+        OutChunk *grown = realloc(out->chunks, capacity * sizeof(OutChunk));
+        if (grown == NULL) return NULL;
+        memset(grown + out->chunkCapacity, 0, (capacity - out->chunkCapacity) * sizeof(OutChunk));
+        out->chunks = grown;
+        out->chunkCapacity = capacity;
+    }
+
+    //I blocchi già scritti restano allocati e vengono riutilizzati
+    OutChunk *chunk = &out->chunks[out->chunkCount];
+    if (chunk->data == NULL) chunk->data = malloc(OUT_CHUNK_SIZE);
+    if (chunk->data == NULL) return NULL;
+    chunk->len = 0;
+    out->chunkCount++;
+    return chunk;
+}
+
+/**
+ * Initializes an empty output buffer.
+ *
+ * @param out The OutBuf structure to initialize.
+ * @param fd The destination descriptor, or -1 to keep the output in memory.
+ */
+void initOutBuf(OutBuf *out, int fd) {
+    memset(out, 0, sizeof(*out));
+    out->fd = fd;
+}
+
+/**
+ * Appends bytes to the buffer.
+ *
+ * @param out The output buffer.
+ * @param data The bytes to append.
+ * @param len The number of bytes.
+ */
+void outWrite(OutBuf *out, const char *data, size_t len) {
+    while (len > 0) {
+        OutChunk *chunk = currentChunk(out);
+        if (chunk == NULL) {
+            out->error = 1;
+            return;
+        }
+        size_t n = OUT_CHUNK_SIZE - chunk->len;
+        if (n > len) n = len;
+        memcpy(chunk->data + chunk->len, data, n);
+        chunk->len += n;
+        out->total += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * Appends a NUL-terminated string.
+ *
+ * @param out The output buffer.
+ * @param s The string to append.
+ */
+void outPuts(OutBuf *out, const char *s) {
+    outWrite(out, s, strlen(s));
+}
+
+/**
+ * Appends a single character.
+ *
+ * @param out The output buffer.
+ * @param c The character to append.
+ */
+void outPutc(OutBuf *out, char c) {
+    outWrite(out, &c, 1);
+}
+
+/**
+ * Appends a string left-justified in a column, like printf("%-*s").
+ * Strings longer than the column are not truncated.
+ *
+ * @param out The output buffer.
+ * @param s The string to append.
+ * @param width The width of the column.
+ */
+void outPad(OutBuf *out, const char *s, size_t width) {
+    static const char spaces[] = "                                        ";
+    size_t len = strlen(s);
+
+    outWrite(out, s, len);
+    //Riempimento a blocchi di spazi invece di un carattere alla volta
+    while (len < width) {
+        size_t n = width - len;
+        if (n > sizeof(spaces) - 1) n = sizeof(spaces) - 1;
+        outWrite(out, spaces, n);
+        len += n;
+    }
+}
+
+/**
+ * Appends a string left-justified in a column followed by a space, like printf("%-*s ").
+ *
+ * @param out The output buffer.
+ * @param s The string to append.
+ * @param width The width of the column.
+ */
+void outColumn(OutBuf *out, const char *s, size_t width) {
+    outPad(out, s, width);
+    outPutc(out, ' ');
+}
+
+/**
+ * Writes everything rendered so far to the descriptor. Does nothing if fd is -1.
+ *
+ * @param out The output buffer.
+ * @return 0 on success, -1 if a write failed.
+ */
+int outFlush(OutBuf *out) {
+    struct iovec iov[OUT_FLUSH_CHUNKS + 1];
+    size_t first = 0;
+
+    if (out->fd < 0) return 0;
+    STAT_BEGIN(STAT_PHASE_OUTPUT);
+    while (first < out->chunkCount) {
+        //Al massimo OUT_FLUSH_CHUNKS + 1 blocchi per chiamata
+        int n = 0;
+        for (size_t i = first; i < out->chunkCount && n < OUT_FLUSH_CHUNKS + 1; i++) {
+            iov[n].iov_base = out->chunks[i].data;
+            iov[n++].iov_len = out->chunks[i].len;
+        }
+
+        ssize_t written = writev(out->fd, iov, n);
+        out->writes++;
+        STAT_ADD(STAT_SYS_WRITE, 1);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            out->error = 1;
+            break;
+        }
+
+        //Scrittura parziale (es. pipe piena): si riparte dal primo byte non scritto
+        out->total -= written;
+        while (first < out->chunkCount && (size_t)written >= out->chunks[first].len) {
+            written -= out->chunks[first].len;
+            out->chunks[first++].len = 0;
+        }
+        if (written > 0) {
+            OutChunk *chunk = &out->chunks[first];
+            memmove(chunk->data, chunk->data + written, chunk->len - written);
+            chunk->len -= written;
+        }
+    }
+
+    //In caso di errore l'output rimasto viene scartato
+    for (size_t i = 0; i < out->chunkCount; i++) out->chunks[i].len = 0;
+    out->chunkCount = 0;
+    out->total = 0;
+    STAT_END(STAT_PHASE_OUTPUT);
+    return out->error ? -1 : 0;
+}
+
+/**
+ * Releases the memory held by the buffer without writing it.
+ *
+ * @param out The output buffer to free.
+ */
+void freeOutBuf(OutBuf *out) {
+    for (size_t i = 0; i < out->chunkCapacity; i++) free(out->chunks[i].data);
+    free(out->chunks);
+    memset(out, 0, sizeof(*out));
+    out->fd = -1;
+}
@@ -0,0 +1,106 @@
+// outbuf.h
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h> //Per size_t
+
+/**
+ * Size of each chunk of the output buffer.
+ */
+#define OUT_CHUNK_SIZE 65536
+
+/**
+ * Number of full chunks collected before they are written with one writev().
+ */
+#define OUT_FLUSH_CHUNKS 16
+
+/**
+ * A block of rendered output.
+ */
+typedef struct {
+    char *data;   /**< OUT_CHUNK_SIZE bytes */
+    size_t len;   /**< Bytes used */
+} OutChunk;
+
+/**
+ * Growable output buffer. Text is rendered into fixed-size chunks and written
+ * to the descriptor in large writev() calls, or kept in memory if fd is -1.
+ */
+typedef struct {
+    int fd;               /**< Destination descriptor, -1 to keep the output in memory */
+    OutChunk *chunks;     /**< Chunks rendered and not yet written */
+    size_t chunkCount;    /**< Number of chunks in use */
+    size_t chunkCapacity; /**< Size of chunks */
+    size_t total;         /**< Bytes rendered and not yet written */
+    unsigned long writes; /**< Number of writev() calls made */
+    int error;            /**< 1 if a write or an allocation failed */
+} OutBuf;
+
+/**
+ * Initializes an empty output buffer.
+ *
+ * @param out The OutBuf structure to initialize.
+ * @param fd The destination descriptor, or -1 to keep the output in memory.
+ */
+void initOutBuf(OutBuf *out, int fd);
+
+/**
+ * Appends bytes to the buffer.
+ *
+ * @param out The output buffer.
+ * @param data The bytes to append.
+ * @param len The number of bytes.
+ */
+void outWrite(OutBuf *out, const char *data, size_t len);
+
+/**
+ * Appends a NUL-terminated string.
+ *
+ * @param out The output buffer.
+ * @param s The string to append.
+ */
+void outPuts(OutBuf *out, const char *s);
+
+/**
+ * Appends a single character.
+ *
+ * @param out The output buffer.
+ * @param c The character to append.
+ */
+void outPutc(OutBuf *out, char c);
+
+/**
+ * Appends a string left-justified in a column, like printf("%-*s").
+ * Strings longer than the column are not truncated.
+ *
+ * @param out The output buffer.
+ * @param s The string to append.
+ * @param width The width of the column.
+ */
+void outPad(OutBuf *out, const char *s, size_t width);
+
+/**
+ * Appends a string left-justified in a column followed by a space, like printf("%-*s ").
+ *
+ * @param out The output buffer.
+ * @param s The string to append.
+ * @param width The width of the column.
+ */
+void outColumn(OutBuf *out, const char *s, size_t width);
+
+/**
+ * Writes everything rendered so far to the descriptor. Does nothing if fd is -1.
+ *
+ * @param out The output buffer.
+ * @return 0 on success, -1 if a write failed.
+ */
+int outFlush(OutBuf *out);
+
+/**
+ * Releases the memory held by the buffer without writing it.
+ *
+ * @param out The output buffer to free.
+ */
+void freeOutBuf(OutBuf *out);
+
+#endif
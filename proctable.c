@@ -0,0 +1,231 @@
+#include <stdio.h> //Per snprintf() e sscanf()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <dirent.h> //Per leggere la directory dei processi
+#include <fcntl.h> //Per openat()
+#include <unistd.h> //Per read() e close()
+#include <sys/sysmacros.h> //Per makedev()
+#include "proctable.h"
+#include "stats.h"
+
+/**
+ * Slots of a new table (power of two).
+ */
+#define PROC_MIN_SLOTS 64
+
+/**
+ * Computes the hash of a device number (Fibonacci hashing).
+ *
+ * @param tty The device number.
+ * @return The hash value.
+ */
+static size_t hashDevice(uint64_t tty) {
+    return (size_t)((tty * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+/**
+ * Finds the slot of a terminal in the open addressing table.
+ *
+ * @param table The process table, with at least one slot.
+ * @param tty The device number of the terminal.
+ * @return The slot holding the terminal, or the empty slot where it would go.
+ */
+static size_t findSlot(const ProcessTable *table, uint64_t tty) {
+    size_t mask = table->slotCount - 1;
+    size_t slot = hashDevice(tty) & mask;
+
+    //Scansione lineare fino al terminale o al primo slot vuoto
+    while (table->slots[slot].tty != 0 && table->slots[slot].tty != tty) slot = (slot + 1) & mask;
+    return slot;
+}
+
+/**
+ * Doubles the table (or allocates the first one).
+ *
+ * @param table The process table.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int growTable(ProcessTable *table) {
+    ProcessTable grown = *table;
+    grown.slotCount = table->slotCount ? table->slotCount * 2 : PROC_MIN_SLOTS;
+    grown.slots = calloc(grown.slotCount, sizeof(ForegroundProcess));
+    if (grown.slots == NULL) return -1;
+    for (size_t i = 0; i < table->slotCount; i++) {
+        if (table->slots[i].tty != 0) grown.slots[findSlot(&grown, table->slots[i].tty)] = table->slots[i];
+    }
+    free(table->slots);
+    *table = grown;
+    return 0;
+}
+
+/**
+ * Converts the tty_nr field of /proc/<pid>/stat, in the encoding of the
+ * kernel (minor split around the major), into a dev_t.
+ *
+ * @param ttyNr The field.
+ * @return The device number.
+ */
+static dev_t decodeTty(unsigned int ttyNr) {
+    unsigned int major = (ttyNr >> 8) & 0xfff;
+    unsigned int minor = (ttyNr & 0xff) | ((ttyNr >> 12) & 0xfff00);
+    return makedev(major, minor);
+}
+
+/**
+ * Reads a file of a process with a single read(): the files of /proc are
+ * generated whole on the first read.
+ *
+ * @param dirFd The directory of the processes, or AT_FDCWD.
+ * @param name The path of the file, relative to dirFd.
+ * @param buf The buffer, NUL-terminated on success.
+ * @param size The size of the buffer.
+ * @return The number of bytes read, or -1 if the process is gone.
+ */
+static ssize_t readProcFile(int dirFd, const char *name, char *buf, size_t size) {
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    STAT_ADD(STAT_SYS_READ, 1);
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+/**
+ * Replaces the control characters of a name or command line with '?', so
+ * that text chosen by any user cannot send escape sequences to the terminal.
+ *
+ * @param text The text, changed in place.
+ * @param len The length of the text.
+ */
+static void maskControls(char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char)text[i] < 0x20 || text[i] == 0x7f) text[i] = '?';
+    }
+}
+
+/**
+ * Parses /proc/<pid>/stat and tells whether the process is in the
+ * foreground of its terminal.
+ *
+ * @param text The content of the file.
+ * @param process Receives terminal, pid, start time and name.
+ * @return 1 for a foreground process, 0 otherwise.
+ */
+static int parseForeground(const char *text, ForegroundProcess *process) {
+    //Il nome può contenere spazi e parentesi: i campi numerici seguono l'ultima ')'
+    const char *open = strchr(text, '(');
+    const char *close = strrchr(text, ')');
+    int pgrp, ttyNr, tpgid;
+    char state;
+
+    if (open == NULL || close == NULL || close < open) return 0;
+    if (sscanf(close + 1, " %c %*d %d %*d %d %d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu", &state, &pgrp,
+               &ttyNr, &tpgid, &process->started) != 5) {
+        return 0;
+    }
+    if (ttyNr == 0 || tpgid <= 0 || pgrp != tpgid) return 0;
+
+    size_t len = (size_t)(close - open - 1);
+    if (len >= sizeof(process->comm)) len = sizeof(process->comm) - 1;
+    memcpy(process->comm, open + 1, len);
+    process->comm[len] = '\0';
+    maskControls(process->comm, len); //Il kernel non filtra il nome impostato con prctl(PR_SET_NAME)
+    process->pid = (pid_t)atoi(text);
+    process->tty = decodeTty((unsigned int)ttyNr);
+    return process->tty != 0;
+}
+
+/**
+ * Reads every process and keeps the foreground process of each terminal.
+ *
+ * @param table The ProcessTable structure to populate.
+ * @param procDir The directory of the processes, NULL for PROC_DIR.
+ * @return 0 on success, -1 if the directory cannot be read or memory allocated.
+ */
+int loadProcessTable(ProcessTable *table, const char *procDir) {
+    struct dirent *entry;
+    char name[300], text[1024];
+    int result = 0;
+
+    memset(table, 0, sizeof(*table));
+    DIR *dir = opendir(procDir ? procDir : PROC_DIR);
+    if (dir == NULL) return -1;
+
+    //Un solo passaggio su /proc; i file sono aperti relativi alla directory, senza risolvere il percorso
+    STAT_BEGIN(STAT_PHASE_PROC);
+    while ((entry = readdir(dir)) != NULL) {
+        ForegroundProcess process;
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9') continue; //Solo le directory dei processi
+        snprintf(name, sizeof(name), "%s/stat", entry->d_name);
+        if (readProcFile(dirfd(dir), name, text, sizeof(text)) <= 0) continue; //Processo già terminato
+        table->processes++;
+        if (!parseForeground(text, &process)) continue;
+
+        //Per ogni terminale resta il processo avviato per ultimo, come in w
+        if ((table->count + 1) * 2 > table->slotCount && growTable(table) != 0) {
+            result = -1;
+            break;
+        }
+        ForegroundProcess *slot = &table->slots[findSlot(table, process.tty)];
+        if (slot->tty == 0) {
+            *slot = process;
+            table->count++;
+        } else if (process.started > slot->started || (process.started == slot->started && process.pid > slot->pid)) {
+            *slot = process;
+        }
+    }
+    STAT_END(STAT_PHASE_PROC);
+    STAT_ADD(STAT_PROC_READS, table->processes);
+    closedir(dir);
+    if (result != 0) freeProcessTable(table);
+    return result;
+}
+
+/**
+ * Returns the foreground process of a terminal.
+ *
+ * @param table The process table.
+ * @param tty The device number of the terminal.
+ * @return The process, or NULL if the terminal has none.
+ */
+const ForegroundProcess *findForeground(const ProcessTable *table, dev_t tty) {
+    if (table->slotCount == 0 || tty == 0) return NULL;
+    const ForegroundProcess *process = &table->slots[findSlot(table, tty)];
+    return process->tty != 0 ? process : NULL;
+}
+
+/**
+ * Writes the command line of a process, or its name if the command line is empty.
+ *
+ * @param process The process.
+ * @param procDir The directory of the processes, NULL for PROC_DIR.
+ * @param buf The buffer that receives the command.
+ * @param size The size of the buffer.
+ */
+void processCommand(const ForegroundProcess *process, const char *procDir, char *buf, size_t size) {
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/%d/cmdline", procDir ? procDir : PROC_DIR, (int)process->pid);
+    ssize_t n = readProcFile(AT_FDCWD, path, buf, size);
+
+    //Argomenti separati da NUL: diventano spazi, e i caratteri di controllo non arrivano al terminale
+    for (ssize_t i = 0; i < n; i++) {
+        if (buf[i] == '\0') buf[i] = ' ';
+    }
+    if (n > 0) maskControls(buf, n);
+    while (n > 0 && buf[n - 1] == ' ') buf[--n] = '\0';
+    if (n <= 0) snprintf(buf, size, "%s", process->comm);
+}
+
+/**
+ * Releases the memory held by the process table.
+ *
+ * @param table The process table to free.
+ */
+void freeProcessTable(ProcessTable *table) {
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
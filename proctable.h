@@ -0,0 +1,74 @@
+// proctable.h
+#ifndef PROCTABLE_H
+#define PROCTABLE_H
+
+#include <stddef.h> //Per size_t
+#include <stdint.h> //Per i tipi a larghezza fissa
+#include <sys/types.h> //Per dev_t e pid_t
+
+/**
+ * Directory of the processes.
+ */
+#define PROC_DIR "/proc"
+
+/**
+ * The process in the foreground of a terminal.
+ */
+typedef struct {
+    uint64_t tty;                /**< Device number of the terminal, 0 for a free slot */
+    pid_t pid;                   /**< The process */
+    unsigned long long started;  /**< Start time in clock ticks after boot */
+    char comm[16];               /**< Name of the executable, for processes without a command line */
+} ForegroundProcess;
+
+/**
+ * Foreground process of every terminal, built with one walk of /proc: an
+ * open addressing table keyed by terminal, so a session costs one lookup
+ * however many processes are running.
+ */
+typedef struct {
+    ForegroundProcess *slots;  /**< The table, empty slots have tty 0 */
+    size_t slotCount;          /**< Size of the table (power of two) */
+    size_t count;              /**< Number of terminals */
+    unsigned long processes;   /**< Processes read */
+} ProcessTable;
+
+/**
+ * Reads /proc/<pid>/stat of every process and keeps, for each terminal, the
+ * most recent process of its foreground process group (tty_nr and tpgid),
+ * the one that `w` shows.
+ *
+ * @param table The ProcessTable structure to populate.
+ * @param procDir The directory of the processes, NULL for PROC_DIR.
+ * @return 0 on success, -1 if the directory cannot be read or memory allocated.
+ */
+int loadProcessTable(ProcessTable *table, const char *procDir);
+
+/**
+ * Returns the foreground process of a terminal.
+ *
+ * @param table The process table.
+ * @param tty The device number of the terminal.
+ * @return The process, or NULL if the terminal has none.
+ */
+const ForegroundProcess *findForeground(const ProcessTable *table, dev_t tty);
+
+/**
+ * Writes the command line of a process, arguments separated by spaces, or
+ * its name if the command line is empty (kernel threads, zombies).
+ *
+ * @param process The process.
+ * @param procDir The directory of the processes, NULL for PROC_DIR.
+ * @param buf The buffer that receives the command.
+ * @param size The size of the buffer.
+ */
+void processCommand(const ForegroundProcess *process, const char *procDir, char *buf, size_t size);
+
+/**
+ * Releases the memory held by the process table.
+ *
+ * @param table The process table to free.
+ */
+void freeProcessTable(ProcessTable *table);
+
+#endif
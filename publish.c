@@ -0,0 +1,253 @@
+#include <stdio.h> //Operazioni di input/output
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per i codici di errore
+#include <signal.h> //Per la gestione dei segnali
+#include <time.h> //Per la gestione del tempo
+#include <unistd.h> //Per ftruncate() e close()
+#include <fcntl.h> //Per le opzioni di shm_open()
+#include <poll.h> //Per attendere gli eventi di inotify
+#include <sched.h> //Per sched_yield()
+#include <sys/file.h> //Per flock()
+#include <sys/mman.h> //Per la memoria condivisa
+#include <sys/stat.h> //Per fstat()
+#include "publish.h"
+#include "finger.h"
+#include "snapshot.h"
+
+/**
+ * The segment as mapped by the publisher.
+ */
+typedef struct {
+    int fd;               /**< Descriptor of the segment */
+    PublishHeader *header; /**< Mapping of the segment */
+    size_t size;          /**< Bytes mapped */
+} Segment;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * Signal handler for SIGINT and SIGTERM.
+ *
+ * @param sig The signal number.
+ */
+static void requestStop(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+/**
+ * Opens the segment, creating it if needed. A segment left by another user
+ * could be changed or resized under the readers by its owner, so it is
+ * removed and created again as a new object of the effective user.
+ *
+ * @return The descriptor of the segment, or -1 on error.
+ */
+static int openSegment(void) {
+    struct stat st;
+    int fd = shm_open(PUBLISH_SHM_NAME, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_uid == geteuid()) return fd;
+    if (fd >= 0) close(fd);
+
+    //Nella directory con sticky bit solo il proprietario (o root) può rimuoverlo
+    if (shm_unlink(PUBLISH_SHM_NAME) != 0 && errno != ENOENT) return -1;
+    return shm_open(PUBLISH_SHM_NAME, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+}
+
+/**
+ * Makes the segment large enough for an image. It only grows: readers that
+ * mapped it earlier never touch pages that no longer exist.
+ *
+ * @param segment The segment.
+ * @param imageSize The size of the image.
+ * @return 0 on success, -1 on error.
+ */
+static int reserveSegment(Segment *segment, size_t imageSize) {
+    size_t need = sizeof(PublishHeader) + imageSize;
+    if (segment->header != NULL && need <= segment->size) return 0;
+
+    size_t size = segment->size ? segment->size : 65536;
+    while (size < need) size *= 2;
+    if (ftruncate(segment->fd, size) != 0) return -1;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    if (segment->header != NULL) munmap(segment->header, segment->size);
+    segment->header = map;
+    segment->size = size;
+    return 0;
+}
+
+/**
+ * Writes the image of a table into the segment under the seqlock.
+ *
+ * @param segment The segment, large enough for the image.
+ * @param table The sessions to publish.
+ */
+static void publishTable(Segment *segment, const SessionTable *table) {
+    PublishHeader *header = segment->header;
+    uint64_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_RELAXED);
+
+    //Dispari durante la scrittura: i lettori che la incrociano riprovano
+    __atomic_store_n(&header->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&header->publishedAt, (int64_t)time(NULL), __ATOMIC_RELAXED);
+    __atomic_store_n(&header->imageSize, (uint64_t)sessionTableImageSize(table), __ATOMIC_RELAXED);
+    writeSessionTableImage(table, header + 1);
+    __atomic_store_n(&header->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Fills the table with every session of the snapshot, in utmpx order like listLoggedUsers().
+ *
+ * @param ctx The data of the run.
+ * @param table The session table, emptied first.
+ */
+static void loadSessions(const FingerContext *ctx, SessionTable *table) {
+    freeSessionTable(table);
+    initSessionTable(table, 0);
+    for (size_t i = 0; i < ctx->index->count; i++) {
+        struct utmpx *ut = &ctx->index->sessions[i];
+        struct passwd *pwd = lookupPasswd(ctx->cache, ut->ut_user);
+        if (pwd != NULL && appendSession(table, ut, pwd) < 0) break;
+    }
+}
+
+/**
+ * Publishes the sessions in the shared-memory segment until SIGINT or SIGTERM.
+ *
+ * @return 0 on a clean shutdown, 1 on error.
+ */
+int runPublisher(void) {
+    LiveSnapshot live; //utmpx e passwd osservati con inotify: si rileggono solo quando cambiano
+    FingerContext ctx;
+    SessionTable table;
+    Segment segment = {-1, NULL, 0};
+    int status = 0;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = requestStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    segment.fd = openSegment();
+    if (segment.fd < 0) {
+        perror("myFinger: unable to create the shared memory segment");
+        return 1;
+    }
+    //Un solo publisher alla volta; il segmento leggibile da tutti ma scrivibile solo dal proprietario
+    if (flock(segment.fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "myFinger: another publisher is running\n");
+        close(segment.fd);
+        return 1;
+    }
+    fchmod(segment.fd, 0644);
+    if (openLiveSnapshot(&live) != 0) {
+        perror("myFinger: unable to watch the sessions");
+        close(segment.fd);
+        return 1;
+    }
+    snapshotContext(&live, &ctx);
+    initSessionTable(&table, 0);
+    loadSessions(&ctx, &table);
+
+    //Un segmento lasciato da un publisher precedente mantiene la sua dimensione e il contatore
+    struct stat st;
+    if (fstat(segment.fd, &st) == 0 && (size_t)st.st_size >= sizeof(PublishHeader)) segment.size = st.st_size;
+    if (reserveSegment(&segment, 0) != 0) {
+        perror("myFinger: unable to map the shared memory segment");
+        status = 1;
+    } else if (memcmp(segment.header->magic, PUBLISH_MAGIC, sizeof(PUBLISH_MAGIC)) != 0 ||
+               segment.header->version != PUBLISH_VERSION) {
+        memset(segment.header, 0, sizeof(PublishHeader));
+        memcpy(segment.header->magic, PUBLISH_MAGIC, sizeof(PUBLISH_MAGIC));
+        segment.header->version = PUBLISH_VERSION;
+    } else if (segment.header->sequence & 1) {
+        segment.header->sequence++; //Publisher precedente interrotto durante una scrittura
+    }
+
+    while (status == 0 && !stopRequested) {
+        //Tutti i terminali in un unico batch: il costo resta al publisher, non ai client
+        for (size_t i = 0; i < table.count; i++) table.idleSeconds[i] = -1;
+        probeSessions(&ctx, &table);
+        if (reserveSegment(&segment, sessionTableImageSize(&table)) != 0) {
+            perror("myFinger: unable to grow the shared memory segment");
+            status = 1;
+            break;
+        }
+        publishTable(&segment, &table);
+
+        //Pubblica subito quando utmpx o passwd cambiano, altrimenti ogni intervallo
+        struct pollfd pfd = {live.fd, POLLIN, 0};
+        if (poll(&pfd, 1, PUBLISH_INTERVAL_MS) > 0 && updateLiveSnapshot(&live) > 0) loadSessions(&ctx, &table);
+    }
+
+    shm_unlink(PUBLISH_SHM_NAME);
+    if (segment.header != NULL) munmap(segment.header, segment.size);
+    close(segment.fd);
+    freeSessionTable(&table);
+    closeLiveSnapshot(&live);
+    return status;
+}
+
+/**
+ * Copies the published sessions without locking.
+ *
+ * @param table The SessionTable structure to populate.
+ * @return 0 on success, -1 if no usable segment exists (build the table instead).
+ */
+int loadPublishedSessions(SessionTable *table) {
+    int fd = shm_open(PUBLISH_SHM_NAME, O_RDONLY | O_CLOEXEC, 0);
+    void *map = MAP_FAILED;
+    size_t mapSize = 0;
+    int result = -1;
+    struct stat st;
+
+    if (fd < 0) return -1;
+    for (int attempt = 0; attempt < PUBLISH_READ_RETRIES; attempt++) {
+        if (map == MAP_FAILED) {
+            //Un segmento di altri utenti potrebbe mostrare sessioni inventate
+            if (fstat(fd, &st) != 0 || (st.st_uid != 0 && st.st_uid != geteuid()) ||
+                (st.st_mode & (S_IWGRP | S_IWOTH)) || (size_t)st.st_size < sizeof(PublishHeader)) {
+                break;
+            }
+            mapSize = st.st_size;
+            map = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) break;
+        }
+
+        const PublishHeader *header = map;
+        uint64_t before = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            sched_yield(); //Scrittura in corso
+            continue;
+        }
+        if (memcmp(header->magic, PUBLISH_MAGIC, sizeof(PUBLISH_MAGIC)) != 0 || header->version != PUBLISH_VERSION) break;
+        int64_t publishedAt = __atomic_load_n(&header->publishedAt, __ATOMIC_RELAXED);
+        uint64_t imageSize = __atomic_load_n(&header->imageSize, __ATOMIC_RELAXED);
+        if (imageSize > mapSize - sizeof(PublishHeader)) {
+            //Segmento ingrandito dal publisher dopo la mappatura: si mappa di nuovo
+            munmap(map, mapSize);
+            map = MAP_FAILED;
+            continue;
+        }
+
+        int valid = readSessionTableImage(table, header + 1, imageSize) == 0;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->sequence, __ATOMIC_RELAXED) != before) {
+            if (valid) freeSessionTable(table); //Copia incrociata con una scrittura
+            continue;
+        }
+        if (!valid) break;
+
+        time_t now = time(NULL);
+        if (publishedAt > now + PUBLISH_MAX_AGE || now - publishedAt > PUBLISH_MAX_AGE) {
+            freeSessionTable(table); //Publisher fermo: i tempi di inattività non sono più attendibili
+            break;
+        }
+        result = 0;
+        break;
+    }
+    if (map != MAP_FAILED) munmap(map, mapSize);
+    close(fd);
+    return result;
+}
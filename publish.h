@@ -0,0 +1,71 @@
+// publish.h
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stdint.h> //Per i tipi a larghezza fissa
+#include "sessiontable.h"
+
+/**
+ * Name of the POSIX shared-memory segment with the published sessions.
+ */
+#define PUBLISH_SHM_NAME "/myFinger-sessions"
+
+/**
+ * Identifies the segment and its layout.
+ */
+#define PUBLISH_MAGIC "MYFSESS"
+#define PUBLISH_VERSION 1
+
+/**
+ * Interval between two publications, in milliseconds (idle times change
+ * even when no file does).
+ */
+#define PUBLISH_INTERVAL_MS 1000
+
+/**
+ * Age in seconds after which a segment is ignored, e.g. because its
+ * publisher was killed.
+ */
+#define PUBLISH_MAX_AGE 5
+
+/**
+ * Attempts of a reader to get a consistent copy before building the table itself.
+ */
+#define PUBLISH_READ_RETRIES 64
+
+/**
+ * Header of the segment, followed by the image of the session table
+ * (see writeSessionTableImage()). The publisher makes sequence odd while it
+ * rewrites the segment and even again when it is done; a reader copies the
+ * table and keeps it only if sequence was even and did not change (seqlock).
+ */
+typedef struct {
+    char magic[8];        /**< PUBLISH_MAGIC */
+    uint32_t version;     /**< PUBLISH_VERSION */
+    uint32_t reserved;    /**< Always 0 */
+    uint64_t sequence;    /**< Seqlock counter, odd during a write */
+    int64_t publishedAt;  /**< Time of the last publication */
+    uint64_t imageSize;   /**< Bytes of the image after the header */
+} PublishHeader;
+
+/**
+ * Publishes the sessions in the shared-memory segment until SIGINT or
+ * SIGTERM: at start, whenever utmpx or passwd change (watched with inotify)
+ * and every PUBLISH_INTERVAL_MS milliseconds with the new idle times.
+ * The segment is removed on exit.
+ *
+ * @return 0 on a clean shutdown, 1 on error.
+ */
+int runPublisher(void);
+
+/**
+ * Copies the published sessions without locking. The segment is used only
+ * if it belongs to root or to the caller, is not writable by others and was
+ * published in the last PUBLISH_MAX_AGE seconds.
+ *
+ * @param table The SessionTable structure to populate.
+ * @return 0 on success, -1 if no usable segment exists (build the table instead).
+ */
+int loadPublishedSessions(SessionTable *table);
+
+#endif
@@ -0,0 +1,339 @@
+#include <stdio.h> //Per fopen()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per ERANGE
+#include <unistd.h> //Per sysconf()
+#include <pwd.h> //Per ottenere informazioni sull'utente dal file "etc/passwd"
+#include "pwcache.h"
+#include "stats.h"
+
+/**
+ * Computes the hash of a login name (FNV-1a).
+ *
+ * @param login The login name.
+ * @return The hash value.
+ */
+static size_t hashName(const char *login) {
+    size_t hash = 2166136261u;
+    while (*login) {
+        hash ^= (unsigned char)*login++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Copies a passwd entry into a single allocated block.
+ *
+ * @param pwd The passwd entry to copy.
+ * @return The copy, or NULL if memory could not be allocated.
+ */
+static struct passwd *copyPasswd(const struct passwd *pwd) {
+    const char *fields[] = {pwd->pw_name, pwd->pw_passwd, pwd->pw_gecos, pwd->pw_dir, pwd->pw_shell};
+    size_t lengths[5];
+    size_t total = sizeof(struct passwd);
+
+    for (int i = 0; i < 5; i++) {
+        lengths[i] = fields[i] ? strlen(fields[i]) + 1 : 1;
+        total += lengths[i];
+    }
+
+    struct passwd *copy = malloc(total);
+    if (copy == NULL) return NULL;
+    *copy = *pwd;
+
+    //Le stringhe sono copiate subito dopo la struttura
+    char *p = (char *)(copy + 1);
+    char **targets[] = {&copy->pw_name, &copy->pw_passwd, &copy->pw_gecos, &copy->pw_dir, &copy->pw_shell};
+    for (int i = 0; i < 5; i++) {
+        memcpy(p, fields[i] ? fields[i] : "", lengths[i]);
+        *targets[i] = p;
+        p += lengths[i];
+    }
+    return copy;
+}
+
+/**
+ * Finds the slot of a login in the open addressing table.
+ *
+ * @param cache The passwd cache.
+ * @param login The login name to look up.
+ * @return The slot holding the login, or the empty slot where it would go.
+ */
+static size_t findEntry(const PasswdCache *cache, const char *login) {
+    size_t mask = cache->slotCount - 1;
+    size_t slot = hashName(login) & mask;
+
+    while (cache->entries[slot].login != NULL && strcmp(cache->entries[slot].login, login) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Doubles the size of the table when it is more than half full.
+ *
+ * @param cache The passwd cache.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int growIfNeeded(PasswdCache *cache) {
+    if ((cache->count + 1) * 2 <= cache->slotCount) return 0;
+
+    PasswdCacheEntry *old = cache->entries;
+    size_t oldCount = cache->slotCount;
+    PasswdCacheEntry *entries = calloc(oldCount * 2, sizeof(PasswdCacheEntry));
+    if (entries == NULL) return -1;
+
+    cache->entries = entries;
+    cache->slotCount = oldCount * 2;
+    //Reinserisce tutte le voci nella nuova tabella
+    for (size_t i = 0; i < oldCount; i++) {
+        if (old[i].login != NULL) cache->entries[findEntry(cache, old[i].login)] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Stores a lookup result in the cache.
+ *
+ * @param cache The passwd cache.
+ * @param login The login name used as key.
+ * @param pwd The passwd entry to copy, or NULL if the user does not exist.
+ * @return The cached entry, or NULL if memory could not be allocated.
+ */
+static PasswdCacheEntry *insertEntry(PasswdCache *cache, const char *login, const struct passwd *pwd) {
+    if (growIfNeeded(cache) != 0) return NULL;
+
+    size_t slot = findEntry(cache, login);
+    PasswdCacheEntry *entry = &cache->entries[slot];
+    if (entry->login != NULL) return entry; //Già presente (es. voci duplicate in getpwent)
+
+    entry->login = strdup(login);
+    entry->pwd = pwd ? copyPasswd(pwd) : NULL;
+    if (entry->login == NULL || (pwd != NULL && entry->pwd == NULL)) {
+        free(entry->login);
+        free(entry->pwd);
+        entry->login = NULL;
+        entry->pwd = NULL;
+        return NULL;
+    }
+    cache->count++;
+    return entry;
+}
+
+/**
+ * Initializes an empty passwd cache.
+ *
+ * @param cache The PasswdCache structure to initialize.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int initPasswdCache(PasswdCache *cache) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->cacheMisses = 1;
+    cache->slotCount = 64;
+    cache->entries = calloc(cache->slotCount, sizeof(PasswdCacheEntry));
+    return cache->entries ? 0 : -1;
+}
+
+/**
+ * Fills the cache with a single getpwent() enumeration.
+ *
+ * @param cache The passwd cache.
+ * @return The number of entries loaded.
+ */
+size_t preloadPasswdCache(PasswdCache *cache) {
+    struct passwd *pwd;
+    size_t loaded = 0;
+
+    STAT_BEGIN(STAT_PHASE_PASSWD);
+    setpwent();
+    while ((pwd = getpwent()) != NULL) {
+        if (insertEntry(cache, pwd->pw_name, pwd) != NULL) loaded++;
+    }
+    endpwent();
+    STAT_END(STAT_PHASE_PASSWD);
+    STAT_ADD(STAT_PASSWD_ENUM, loaded);
+    cache->bulkLoaded = 1;
+    return loaded;
+}
+
+/**
+ * Fills the cache from a file in passwd(5) format instead of the NSS databases,
+ * e.g. a fixture. Logins not in the file are still resolved with getpwnam().
+ *
+ * @param cache The passwd cache.
+ * @param path The path of the file.
+ * @return The number of entries loaded, or -1 if the file cannot be opened.
+ */
+long preloadPasswdCacheFile(PasswdCache *cache, const char *path) {
+    FILE *file = fopen(path, "r");
+    struct passwd *pwd;
+    long loaded = 0;
+
+    if (file == NULL) return -1;
+    STAT_BEGIN(STAT_PHASE_PASSWD);
+    while ((pwd = fgetpwent(file)) != NULL) {
+        if (insertEntry(cache, pwd->pw_name, pwd) != NULL) loaded++;
+    }
+    fclose(file);
+    STAT_END(STAT_PHASE_PASSWD);
+    STAT_ADD(STAT_PASSWD_ENUM, loaded);
+    cache->bulkLoaded = 1;
+    return loaded;
+}
+
+/**
+ * Fills the cache with getpwent() if the number of sessions makes it worthwhile
+ * and no passwd index is attached.
+ *
+ * @param cache The passwd cache.
+ * @param sessionCount The number of sessions that will be resolved.
+ */
+void preloadPasswdCacheFor(PasswdCache *cache, size_t sessionCount) {
+    if (!cache->bulkLoaded && cache->index == NULL && sessionCount >= PASSWD_BULK_THRESHOLD) {
+        preloadPasswdCache(cache);
+    }
+}
+
+/**
+ * Returns the passwd entry of a login, resolving it only on the first request,
+ * from the index when one is attached and lists it, otherwise with getpwnam().
+ *
+ * @param cache The passwd cache.
+ * @param login The login name to look up.
+ * @return The cached passwd entry, or NULL if the user does not exist or memory could not be allocated.
+ */
+struct passwd *lookupPasswd(PasswdCache *cache, const char *login) {
+    size_t slot = findEntry(cache, login);
+    STAT_ADD(STAT_PASSWD_LOOKUPS, 1);
+    if (cache->entries[slot].login != NULL) {
+        STAT_ADD(STAT_PASSWD_HITS, 1);
+        return cache->entries[slot].pwd;
+    }
+
+    //Nell'indice su disco: nessuna interrogazione NSS
+    struct passwd indexed;
+    if (cache->index != NULL && findPasswdIndex(cache->index, login, &indexed) == 0) {
+        STAT_ADD(STAT_PASSWD_INDEX, 1);
+        PasswdCacheEntry *entry = insertEntry(cache, login, &indexed);
+        return entry ? entry->pwd : NULL; //Memoria esaurita: utente trattato come assente
+    }
+
+    //Non in cache: una sola interrogazione NSS, memorizzata anche se l'utente non esiste (salvo con cacheMisses a 0)
+    //(anche dopo getpwent() o con l'indice, che con alcuni backend non elencano tutti gli utenti)
+    STAT_BEGIN(STAT_PHASE_PASSWD);
+    struct passwd *pwd = getpwnam(login);
+    STAT_END(STAT_PHASE_PASSWD);
+    STAT_ADD(STAT_PASSWD_NSS, 1);
+    if (pwd == NULL && !cache->cacheMisses) return NULL;
+    PasswdCacheEntry *entry = insertEntry(cache, login, pwd);
+    //Memoria esaurita: utente trattato come assente, come per l'indice; il buffer statico di
+    //getpwnam() verrebbe sovrascritto dalla ricerca successiva
+    return entry ? entry->pwd : NULL;
+}
+
+/**
+ * Like lookupPasswd(), but may be called from several threads at once.
+ *
+ * A failed getpwnam_r() (e.g. the directory service is down) is never cached.
+ *
+ * @param cache The passwd cache.
+ * @param login The login name to look up.
+ * @return The cached passwd entry, or NULL if the user does not exist.
+ */
+struct passwd *lookupPasswdShared(PasswdCache *cache, const char *login) {
+    pthread_mutex_lock(&cache->lock);
+    size_t slot = findEntry(cache, login);
+    STAT_ADD(STAT_PASSWD_LOOKUPS, 1);
+    if (cache->entries[slot].login != NULL) {
+        struct passwd *cached = cache->entries[slot].pwd;
+        STAT_ADD(STAT_PASSWD_HITS, 1);
+        pthread_mutex_unlock(&cache->lock);
+        return cached;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    //L'indice è mappato in sola lettura: si consulta senza lock
+    struct passwd indexed;
+    if (cache->index != NULL && findPasswdIndex(cache->index, login, &indexed) == 0) {
+        STAT_ADD(STAT_PASSWD_INDEX, 1);
+        pthread_mutex_lock(&cache->lock);
+        PasswdCacheEntry *inserted = insertEntry(cache, login, &indexed);
+        struct passwd *result = inserted ? inserted->pwd : NULL;
+        pthread_mutex_unlock(&cache->lock);
+        return result;
+    }
+    //getpwnam() usa un buffer statico: con più thread serve getpwnam_r(), con un buffer che cresce se non basta
+    long hint = sysconf(_SC_GETPW_R_SIZE_MAX);
+    size_t size = hint > 0 ? (size_t)hint : 16384;
+    struct passwd entry, *pwd = NULL;
+    char *buf = NULL;
+    int err = 0;
+
+    STAT_BEGIN(STAT_PHASE_PASSWD);
+    do {
+        char *grown = realloc(buf, size);
+        if (grown == NULL) {
+            err = ENOMEM;
+            break;
+        }
+        buf = grown;
+        err = getpwnam_r(login, &entry, buf, size, &pwd);
+        size *= 2;
+    } while (err == ERANGE && size <= 1 << 20);
+    STAT_END(STAT_PHASE_PASSWD);
+    STAT_ADD(STAT_PASSWD_NSS, 1);
+
+    //Un errore (es. servizio di directory non raggiungibile) non dice che l'utente non esiste:
+    //non si memorizza, così la richiesta successiva riprova
+    if (pwd == NULL && (err != 0 || !cache->cacheMisses)) {
+        free(buf);
+        return NULL;
+    }
+
+    //Un altro thread può aver inserito lo stesso login nel frattempo: insertEntry() restituisce quella voce
+    pthread_mutex_lock(&cache->lock);
+    PasswdCacheEntry *inserted = insertEntry(cache, login, pwd);
+    struct passwd *result = inserted ? inserted->pwd : NULL; //Memoria esaurita: utente trattato come assente
+    pthread_mutex_unlock(&cache->lock);
+    free(buf);
+    return result;
+}
+
+/**
+ * Replaces the cached entry of a login, e.g. after /etc/passwd changed.
+ *
+ * @param cache The passwd cache.
+ * @param login The login name.
+ * @param pwd The new passwd entry to copy, or NULL if the user no longer exists.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int storePasswd(PasswdCache *cache, const char *login, const struct passwd *pwd) {
+    size_t slot = findEntry(cache, login);
+    PasswdCacheEntry *entry = &cache->entries[slot];
+
+    if (entry->login == NULL) return insertEntry(cache, login, pwd) ? 0 : -1;
+
+    struct passwd *copy = pwd ? copyPasswd(pwd) : NULL;
+    if (pwd != NULL && copy == NULL) return -1;
+    free(entry->pwd);
+    entry->pwd = copy;
+    return 0;
+}
+
+/**
+ * Releases the memory held by the passwd cache.
+ *
+ * @param cache The passwd cache to free.
+ */
+void freePasswdCache(PasswdCache *cache) {
+    for (size_t i = 0; i < cache->slotCount; i++) {
+        free(cache->entries[i].login);
+        free(cache->entries[i].pwd);
+    }
+    free(cache->entries);
+    pthread_mutex_destroy(&cache->lock);
+    memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,114 @@
+// pwcache.h
+#ifndef PWCACHE_H
+#define PWCACHE_H
+
+#include <stddef.h> //Per size_t
+#include <pwd.h> //Per la struttura passwd
+#include <pthread.h> //Per il mutex della cache
+#include "pwindex.h"
+
+/**
+ * Number of sessions from which a full getpwent() enumeration is cheaper
+ * than resolving every login on its own.
+ */
+#define PASSWD_BULK_THRESHOLD 256
+
+/**
+ * A cached passwd lookup. A NULL pwd records a login that does not exist.
+ */
+typedef struct {
+    char *login;          /**< Login name used as key */
+    struct passwd *pwd;   /**< Copy of the passwd entry, or NULL if not found */
+} PasswdCacheEntry;
+
+/**
+ * Per-run cache of passwd entries keyed by login name.
+ */
+typedef struct {
+    PasswdCacheEntry *entries; /**< Open addressing table, empty slots have login == NULL */
+    size_t slotCount;          /**< Size of the table (power of two) */
+    size_t count;              /**< Number of cached logins */
+    int bulkLoaded;            /**< 1 if the cache was filled with getpwent() */
+    int cacheMisses;           /**< 1 to also store logins that do not exist, 0 to query NSS every time */
+    const PasswdIndex *index;  /**< Index consulted before NSS, NULL for none */
+    pthread_mutex_t lock;      /**< Serializes lookupPasswdShared() */
+} PasswdCache;
+
+/**
+ * Initializes an empty passwd cache.
+ *
+ * @param cache The PasswdCache structure to initialize.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int initPasswdCache(PasswdCache *cache);
+
+/**
+ * Fills the cache with a single getpwent() enumeration.
+ *
+ * @param cache The passwd cache.
+ * @return The number of entries loaded.
+ */
+size_t preloadPasswdCache(PasswdCache *cache);
+
+/**
+ * Fills the cache from a file in passwd(5) format instead of the NSS databases,
+ * e.g. a fixture. Logins not in the file are still resolved with getpwnam().
+ *
+ * @param cache The passwd cache.
+ * @param path The path of the file.
+ * @return The number of entries loaded, or -1 if the file cannot be opened.
+ */
+long preloadPasswdCacheFile(PasswdCache *cache, const char *path);
+
+/**
+ * Fills the cache with getpwent() if the number of sessions makes it worthwhile
+ * and no passwd index is attached (the index is already the bulk copy).
+ *
+ * @param cache The passwd cache.
+ * @param sessionCount The number of sessions that will be resolved.
+ */
+void preloadPasswdCacheFor(PasswdCache *cache, size_t sessionCount);
+
+/**
+ * Returns the passwd entry of a login, resolving it only on the first request,
+ * from the index when one is attached and lists it, otherwise with getpwnam().
+ *
+ * @param cache The passwd cache.
+ * @param login The login name to look up.
+ * @return The cached passwd entry, or NULL if the user does not exist or memory could not be allocated.
+ */
+struct passwd *lookupPasswd(PasswdCache *cache, const char *login);
+
+/**
+ * Like lookupPasswd(), but may be called from several threads at once: the
+ * table is locked only to read and insert entries, and a miss is resolved
+ * with getpwnam_r() outside the lock, so NSS queries of different threads
+ * run in parallel. Must not be mixed with the other functions while threads
+ * are using it.
+ *
+ * A failed getpwnam_r() (e.g. the directory service is down) is never cached.
+ *
+ * @param cache The passwd cache.
+ * @param login The login name to look up.
+ * @return The cached passwd entry, or NULL if the user does not exist.
+ */
+struct passwd *lookupPasswdShared(PasswdCache *cache, const char *login);
+
+/**
+ * Replaces the cached entry of a login, e.g. after /etc/passwd changed.
+ *
+ * @param cache The passwd cache.
+ * @param login The login name.
+ * @param pwd The new passwd entry to copy, or NULL if the user no longer exists.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int storePasswd(PasswdCache *cache, const char *login, const struct passwd *pwd);
+
+/**
+ * Releases the memory held by the passwd cache.
+ *
+ * @param cache The passwd cache to free.
+ */
+void freePasswdCache(PasswdCache *cache);
+
+#endif
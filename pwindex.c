@@ -0,0 +1,461 @@
+#include <stdio.h> //Per fopen() e rename()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <time.h> //Per la scadenza dell'indice
+#include <fcntl.h> //Per open()
+#include <unistd.h> //Per close() e getpid()
+#include <sys/mman.h> //Per mappare l'indice
+#include <sys/stat.h> //Per lo stato del file sorgente
+#include "pwindex.h"
+#include "lib.h"
+#include "stats.h"
+
+/**
+ * Displacements tried for a bucket before the table is made larger.
+ */
+#define PLACE_MAX_DISPLACEMENT (1u << 16)
+
+/**
+ * Marks a free slot while the table is built.
+ */
+#define SLOT_FREE UINT32_MAX
+
+/**
+ * A passwd entry being indexed.
+ */
+typedef struct {
+    uint64_t hash;             /**< Hash of the login */
+    uint32_t order;            /**< Position in the enumeration, the first duplicate wins */
+    PasswdIndexRecord record;  /**< Offsets of the strings */
+} IndexEntry;
+
+/**
+ * Growable block of strings.
+ */
+typedef struct {
+    char *data;       /**< The strings */
+    size_t len;       /**< Bytes used */
+    size_t capacity;  /**< Bytes allocated */
+} IndexStrings;
+
+/**
+ * Computes the hash of a login name (64-bit FNV-1a).
+ *
+ * @param login The login name.
+ * @return The hash value.
+ */
+static uint64_t hashLogin(const char *login) {
+    uint64_t hash = 14695981039346656037ull;
+    while (*login) {
+        hash ^= (unsigned char)*login++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Returns the slot of a login for a displacement.
+ *
+ * @param hash The hash of the login.
+ * @param displacement The displacement of its bucket.
+ * @param slotCount The number of slots.
+ * @return The slot.
+ */
+static uint32_t slotOf(uint64_t hash, uint32_t displacement, uint32_t slotCount) {
+    //Finalizzatore di splitmix64: ogni spostamento dà una permutazione indipendente
+    uint64_t x = hash ^ ((uint64_t)displacement + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return (uint32_t)(x % slotCount);
+}
+
+/**
+ * Appends a string to the block.
+ *
+ * @param strings The block of strings.
+ * @param text The string, NULL for the empty string.
+ * @param offset Receives the offset of the string.
+ * @return 0 on success, -1 if memory could not be allocated or the block is full.
+ */
+static int appendIndexString(IndexStrings *strings, const char *text, uint32_t *offset) {
+    size_t len = text ? strlen(text) : 0;
+    if (len == 0) {
+        *offset = 0; //La stringa vuota è sempre all'offset 0
+        return 0;
+    }
+    if (strings->len + len + 1 >= UINT32_MAX) return -1;
+    if (strings->len + len + 1 > strings->capacity) {
+        size_t capacity = strings->capacity ? strings->capacity * 2 : 4096;
+        while (capacity < strings->len + len + 1) capacity *= 2;
+        char *data = realloc(strings->data, capacity);
+        if (data == NULL) return -1;
+        strings->data = data;
+        strings->capacity = capacity;
+    }
+    memcpy(strings->data + strings->len, text, len + 1);
+    *offset = (uint32_t)strings->len;
+    strings->len += len + 1;
+    return 0;
+}
+
+/**
+ * Strings of the entries being sorted by compareEntries().
+ */
+static const char *sortStrings;
+
+/**
+ * Orders entries by hash, then login, then enumeration order, so that
+ * duplicates are adjacent with the first one in front.
+ */
+static int compareEntries(const void *a, const void *b) {
+    const IndexEntry *ea = a, *eb = b;
+    if (ea->hash != eb->hash) return ea->hash < eb->hash ? -1 : 1;
+    int cmp = strcmp(sortStrings + ea->record.login, sortStrings + eb->record.login);
+    if (cmp != 0) return cmp;
+    return ea->order < eb->order ? -1 : ea->order > eb->order;
+}
+
+/**
+ * Finds a displacement for every bucket so that no two logins share a slot.
+ * The largest buckets are placed first, while most slots are still free.
+ *
+ * @param entries The entries, without duplicates.
+ * @param count The number of entries.
+ * @param slotCount The number of slots.
+ * @param bucketCount The number of buckets.
+ * @param displacements Receives the displacement of each bucket.
+ * @param owners Receives the entry of each slot, SLOT_FREE for an empty one.
+ * @return 0 on success, -1 if a bucket could not be placed or memory is exhausted.
+ */
+static int placeEntries(const IndexEntry *entries, uint32_t count, uint32_t slotCount, uint32_t bucketCount,
+                        uint32_t *displacements, uint32_t *owners) {
+    uint32_t *start = calloc((size_t)bucketCount + 1, sizeof(uint32_t));
+    uint32_t *members = malloc((count ? count : 1) * sizeof(uint32_t));
+    uint32_t *bySize = malloc(bucketCount * sizeof(uint32_t));
+    uint32_t *sizeStart = calloc((size_t)count + 2, sizeof(uint32_t));
+    int result = -1;
+
+    if (start != NULL && members != NULL && bySize != NULL && sizeStart != NULL) {
+        //Membri di ogni bucket contigui (ordinamento per conteggio)
+        for (uint32_t i = 0; i < count; i++) start[entries[i].hash % bucketCount + 1]++;
+        for (uint32_t b = 0; b < bucketCount; b++) start[b + 1] += start[b];
+        for (uint32_t i = 0; i < count; i++) members[start[entries[i].hash % bucketCount]++] = i;
+        for (uint32_t b = bucketCount; b > 0; b--) start[b] = start[b - 1];
+        start[0] = 0;
+
+        //Bucket in ordine di dimensione decrescente
+        for (uint32_t b = 0; b < bucketCount; b++) sizeStart[count - (start[b + 1] - start[b]) + 1]++;
+        for (uint32_t s = 0; s <= count; s++) sizeStart[s + 1] += sizeStart[s];
+        for (uint32_t b = 0; b < bucketCount; b++) bySize[sizeStart[count - (start[b + 1] - start[b])]++] = b;
+
+        for (uint32_t s = 0; s < slotCount; s++) owners[s] = SLOT_FREE;
+        memset(displacements, 0, bucketCount * sizeof(uint32_t));
+        result = 0;
+        for (uint32_t k = 0; k < bucketCount && result == 0; k++) {
+            uint32_t b = bySize[k], first = start[b], last = start[b + 1];
+            if (first == last) break; //I bucket restanti sono vuoti
+            uint32_t d = 0;
+            for (; d < PLACE_MAX_DISPLACEMENT; d++) {
+                uint32_t j = first;
+                for (; j < last; j++) {
+                    uint32_t slot = slotOf(entries[members[j]].hash, d, slotCount);
+                    if (owners[slot] != SLOT_FREE) break;
+                    owners[slot] = members[j];
+                }
+                if (j == last) break;
+                //Collisione: libera gli slot presi con questo spostamento
+                for (uint32_t u = first; u < j; u++) owners[slotOf(entries[members[u]].hash, d, slotCount)] = SLOT_FREE;
+            }
+            if (d == PLACE_MAX_DISPLACEMENT) result = -1;
+            else displacements[b] = d;
+        }
+    }
+
+    free(start);
+    free(members);
+    free(bySize);
+    free(sizeStart);
+    return result;
+}
+
+/**
+ * Writes the default path of the index.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int passwdIndexPath(char *buf, size_t size) {
+    return cacheFilePath(buf, size, "passwd-index");
+}
+
+/**
+ * Reads every entry returned by getpwent(), keeping the first of each login.
+ *
+ * @param strings Receives the strings, offset 0 is the empty string.
+ * @param count Receives the number of entries.
+ * @return The entries, or NULL if the enumeration could not be completed
+ *         (a partial index would hide users).
+ */
+static IndexEntry *enumeratePasswd(IndexStrings *strings, size_t *count) {
+    IndexEntry *entries = NULL;
+    size_t capacity = 0, n = 0;
+    struct passwd *pwd;
+
+    *count = 0;
+    strings->data = malloc(4096);
+    if (strings->data == NULL) return NULL;
+    strings->data[0] = '\0';
+    strings->len = 1;
+    strings->capacity = 4096;
+
+    STAT_BEGIN(STAT_PHASE_PASSWD);
+    setpwent();
+    while ((pwd = getpwent()) != NULL) {
+        if (pwd->pw_name == NULL || pwd->pw_name[0] == '\0') continue;
+        if (n == capacity) {
+            size_t grown = capacity ? capacity * 2 : 256;
+            IndexEntry *more = grown < UINT32_MAX ? realloc(entries, grown * sizeof(IndexEntry)) : NULL;
+            if (more == NULL) break;
+            entries = more;
+            capacity = grown;
+        }
+        IndexEntry *e = &entries[n];
+        e->hash = hashLogin(pwd->pw_name);
+        e->order = (uint32_t)n;
+        e->record.uid = pwd->pw_uid;
+        e->record.gid = pwd->pw_gid;
+        if (appendIndexString(strings, pwd->pw_name, &e->record.login) != 0 ||
+            appendIndexString(strings, pwd->pw_gecos, &e->record.gecos) != 0 ||
+            appendIndexString(strings, pwd->pw_dir, &e->record.directory) != 0 ||
+            appendIndexString(strings, pwd->pw_shell, &e->record.shell) != 0) {
+            break;
+        }
+        n++;
+    }
+    int complete = pwd == NULL;
+    endpwent();
+    STAT_END(STAT_PHASE_PASSWD);
+    STAT_ADD(STAT_PASSWD_ENUM, n);
+    if (!complete) {
+        free(entries);
+        return NULL;
+    }
+
+    //Voci duplicate (es. file locale e directory): resta la prima, come con getpwnam()
+    sortStrings = strings->data;
+    if (n > 1) qsort(entries, n, sizeof(IndexEntry), compareEntries);
+    size_t unique = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (unique > 0 && entries[unique - 1].hash == entries[i].hash &&
+            strcmp(strings->data + entries[unique - 1].record.login, strings->data + entries[i].record.login) == 0) {
+            continue;
+        }
+        entries[unique++] = entries[i];
+    }
+    *count = unique;
+    return entries ? entries : malloc(sizeof(IndexEntry));
+}
+
+/**
+ * Writes the index to a temporary file and renames it over the old one.
+ *
+ * @param path The path of the index.
+ * @param header The header, complete.
+ * @param displacements The displacement of each bucket.
+ * @param owners The entry of each slot, SLOT_FREE for an empty one.
+ * @param entries The entries.
+ * @param strings The strings of the entries.
+ * @return 0 on success, -1 on error.
+ */
+static int writePasswdIndex(const char *path, const PasswdIndexHeader *header, const uint32_t *displacements,
+                            const uint32_t *owners, const IndexEntry *entries, const IndexStrings *strings) {
+    static const PasswdIndexRecord empty = {0, 0, 0, 0, 0, 0};
+    char tmp[512];
+
+    if (snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmp)) return -1;
+    makeParentDirectories(path);
+    FILE *out = fopen(tmp, "wb");
+    if (out == NULL) return -1;
+    int ok = fwrite(header, sizeof(*header), 1, out) == 1 &&
+             fwrite(displacements, sizeof(uint32_t), header->bucketCount, out) == header->bucketCount;
+    for (uint32_t s = 0; ok && s < header->slotCount; s++) {
+        const PasswdIndexRecord *record = owners[s] == SLOT_FREE ? &empty : &entries[owners[s]].record;
+        ok = fwrite(record, sizeof(PasswdIndexRecord), 1, out) == 1;
+    }
+    ok = ok && fwrite(strings->data, 1, strings->len, out) == strings->len;
+    //Il nuovo indice sostituisce il vecchio in un colpo solo: chi lo sta leggendo tiene la sua mappatura
+    if (fclose(out) != 0 || !ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Builds the index of every entry returned by getpwent() and replaces the file atomically.
+ *
+ * @param path The path of the index.
+ * @param source The file whose state is recorded in the index.
+ * @return The number of logins indexed, or -1 on error.
+ */
+long buildPasswdIndex(const char *path, const char *source) {
+    IndexStrings strings = {NULL, 0, 0};
+    uint32_t *displacements = NULL, *owners = NULL;
+    uint32_t slotCount = 0, bucketCount;
+    size_t count;
+    long result = -1;
+    struct stat st;
+
+    //Lo stato della sorgente è letto prima dell'enumerazione: una modifica successiva invalida l'indice
+    if (stat(source, &st) != 0) return -1;
+    IndexEntry *entries = enumeratePasswd(&strings, &count);
+    if (entries == NULL || count >= UINT32_MAX / 4) {
+        free(entries);
+        free(strings.data);
+        return -1;
+    }
+
+    //Circa quattro login per bucket e un quarto di slot liberi; se non basta la tabella si allarga
+    bucketCount = (uint32_t)(count / 4 + 1);
+    displacements = malloc(bucketCount * sizeof(uint32_t));
+    for (int attempt = 0; displacements != NULL && slotCount == 0 && attempt < 4; attempt++) {
+        free(owners);
+        slotCount = (uint32_t)(count + count / 4 + 1) << attempt;
+        owners = malloc(slotCount * sizeof(uint32_t));
+        if (owners == NULL) break;
+        if (placeEntries(entries, (uint32_t)count, slotCount, bucketCount, displacements, owners) != 0) slotCount = 0;
+    }
+
+    if (owners != NULL && slotCount != 0) {
+        PasswdIndexHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, PASSWD_INDEX_MAGIC, sizeof(header.magic));
+        header.version = PASSWD_INDEX_VERSION;
+        header.sourceDevice = st.st_dev;
+        header.sourceInode = st.st_ino;
+        header.sourceSize = st.st_size;
+        header.sourceMtime = st.st_mtim.tv_sec;
+        header.sourceMtimeNs = st.st_mtim.tv_nsec;
+        header.builtAt = time(NULL);
+        header.count = (uint32_t)count;
+        header.slotCount = slotCount;
+        header.bucketCount = bucketCount;
+        header.stringsLen = strings.len;
+        if (writePasswdIndex(path, &header, displacements, owners, entries, &strings) == 0) result = (long)count;
+    }
+
+    free(strings.data);
+    free(entries);
+    free(displacements);
+    free(owners);
+    return result;
+}
+
+/**
+ * Maps the index if it is valid, current and younger than PASSWD_INDEX_TTL.
+ *
+ * @param index The PasswdIndex structure to populate.
+ * @param path The path of the index.
+ * @param source The file the index was built for.
+ * @return 0 on success, -1 if the index is missing, invalid or stale.
+ */
+int openPasswdIndex(PasswdIndex *index, const char *path, const char *source) {
+    struct stat src, st;
+
+    memset(index, 0, sizeof(*index));
+    if (stat(source, &src) != 0) return -1;
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || st.st_uid != geteuid() || (size_t)st.st_size < sizeof(PasswdIndexHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    //Il file deve contenere esattamente le parti annunciate dall'intestazione
+    const PasswdIndexHeader *header = map;
+    uint64_t expected = sizeof(PasswdIndexHeader) + (uint64_t)header->bucketCount * sizeof(uint32_t) +
+                        (uint64_t)header->slotCount * sizeof(PasswdIndexRecord) + header->stringsLen;
+    time_t now = time(NULL);
+    if (memcmp(header->magic, PASSWD_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != PASSWD_INDEX_VERSION || header->stringsLen == 0 || header->stringsLen >= UINT32_MAX ||
+        header->bucketCount == 0 || header->slotCount == 0 || header->count > header->slotCount ||
+        expected != (uint64_t)st.st_size || ((const char *)map)[st.st_size - 1] != '\0' ||
+        header->sourceDevice != (uint64_t)src.st_dev || header->sourceInode != (uint64_t)src.st_ino ||
+        header->sourceSize != (uint64_t)src.st_size || header->sourceMtime != src.st_mtim.tv_sec ||
+        header->sourceMtimeNs != src.st_mtim.tv_nsec || header->builtAt > now ||
+        now - header->builtAt > PASSWD_INDEX_TTL) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    index->map = map;
+    index->size = st.st_size;
+    index->header = header;
+    index->displacements = (const uint32_t *)(header + 1);
+    index->records = (const PasswdIndexRecord *)(index->displacements + header->bucketCount);
+    index->strings = (const char *)(index->records + header->slotCount);
+    return 0;
+}
+
+/**
+ * Maps the index, building it first if it is missing or stale.
+ *
+ * @param index The PasswdIndex structure to populate.
+ * @param path The path of the index.
+ * @param source The file the index is built for.
+ * @return 0 on success, -1 on error.
+ */
+int loadPasswdIndex(PasswdIndex *index, const char *path, const char *source) {
+    if (openPasswdIndex(index, path, source) == 0) return 0;
+    if (buildPasswdIndex(path, source) < 0) return -1;
+    return openPasswdIndex(index, path, source);
+}
+
+/**
+ * Looks up a login in the index.
+ *
+ * @param index The mapped index.
+ * @param login The login name.
+ * @param pwd Receives the entry; its strings point into the mapping.
+ * @return 0 if the login was found, -1 otherwise.
+ */
+int findPasswdIndex(const PasswdIndex *index, const char *login, struct passwd *pwd) {
+    //Gli slot vuoti hanno il login vuoto: un login vuoto non si cerca
+    if (index->map == NULL || login[0] == '\0') return -1;
+
+    const PasswdIndexHeader *header = index->header;
+    uint64_t hash = hashLogin(login);
+    uint32_t displacement = index->displacements[hash % header->bucketCount];
+    const PasswdIndexRecord *record = &index->records[slotOf(hash, displacement, header->slotCount)];
+    uint64_t len = header->stringsLen;
+
+    if (record->login >= len || record->gecos >= len || record->directory >= len || record->shell >= len ||
+        strcmp(index->strings + record->login, login) != 0) {
+        return -1;
+    }
+    memset(pwd, 0, sizeof(*pwd));
+    pwd->pw_name = (char *)index->strings + record->login;
+    pwd->pw_passwd = (char *)"x";
+    pwd->pw_uid = record->uid;
+    pwd->pw_gid = record->gid;
+    pwd->pw_gecos = (char *)index->strings + record->gecos;
+    pwd->pw_dir = (char *)index->strings + record->directory;
+    pwd->pw_shell = (char *)index->strings + record->shell;
+    return 0;
+}
+
+/**
+ * Unmaps the index.
+ *
+ * @param index The index to close.
+ */
+void closePasswdIndex(PasswdIndex *index) {
+    if (index->map != NULL) munmap(index->map, index->size);
+    memset(index, 0, sizeof(*index));
+}
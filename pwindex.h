@@ -0,0 +1,132 @@
+// pwindex.h
+#ifndef PWINDEX_H
+#define PWINDEX_H
+
+#include <stddef.h> //Per size_t
+#include <stdint.h> //Per i tipi a larghezza fissa
+#include <pwd.h> //Per la struttura passwd
+
+/**
+ * File whose inode, size and modification time invalidate the index.
+ */
+#define PASSWD_INDEX_SOURCE "/etc/passwd"
+
+/**
+ * Seconds after which the index is rebuilt even if the source did not
+ * change, for users of directory services (LDAP, SSSD, ...).
+ */
+#define PASSWD_INDEX_TTL 3600
+
+/**
+ * Identifies the index file and its layout.
+ */
+#define PASSWD_INDEX_MAGIC "MFPI"
+#define PASSWD_INDEX_VERSION 1
+
+/**
+ * Header of the index file. It is followed by bucketCount displacements
+ * (uint32_t), slotCount PasswdIndexRecord and stringsLen bytes of strings.
+ * A login is found with two hashes: the first picks its bucket, the
+ * displacement of the bucket the slot (hash and displace), so a lookup reads
+ * one record and compares one string.
+ */
+typedef struct {
+    char magic[4];          /**< PASSWD_INDEX_MAGIC */
+    uint32_t version;       /**< PASSWD_INDEX_VERSION */
+    uint64_t sourceDevice;  /**< Device of the source file */
+    uint64_t sourceInode;   /**< Inode of the source file */
+    uint64_t sourceSize;    /**< Size of the source file */
+    int64_t sourceMtime;    /**< Modification time of the source, seconds */
+    int64_t sourceMtimeNs;  /**< Modification time of the source, nanoseconds */
+    int64_t builtAt;        /**< Time the index was built */
+    uint32_t count;         /**< Number of logins */
+    uint32_t slotCount;     /**< Number of records, empty ones have login 0 */
+    uint32_t bucketCount;   /**< Number of displacements */
+    uint32_t reserved;      /**< Always 0 */
+    uint64_t stringsLen;    /**< Bytes of the strings, offset 0 is the empty string */
+} PasswdIndexHeader;
+
+/**
+ * A passwd entry of the index, with the offsets of its strings.
+ */
+typedef struct {
+    uint32_t login;      /**< Login name */
+    uint32_t gecos;      /**< GECOS field */
+    uint32_t directory;  /**< Home directory */
+    uint32_t shell;      /**< Shell */
+    uint32_t uid;        /**< User ID */
+    uint32_t gid;        /**< Group ID */
+} PasswdIndexRecord;
+
+/**
+ * An index file mapped in memory.
+ */
+typedef struct {
+    void *map;                          /**< Mapping of the file, NULL if not open */
+    size_t size;                        /**< Size of the mapping */
+    const PasswdIndexHeader *header;    /**< Header of the file */
+    const uint32_t *displacements;      /**< Displacement of each bucket */
+    const PasswdIndexRecord *records;   /**< Records, one per slot */
+    const char *strings;                /**< Strings of the records */
+} PasswdIndex;
+
+/**
+ * Writes the default path of the index: $XDG_CACHE_HOME/myFinger/passwd-index,
+ * or ~/.cache/myFinger/passwd-index.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int passwdIndexPath(char *buf, size_t size);
+
+/**
+ * Builds the index of every entry returned by getpwent() and replaces the
+ * file atomically with a rename.
+ *
+ * @param path The path of the index.
+ * @param source The file whose state is recorded in the index.
+ * @return The number of logins indexed, or -1 on error.
+ */
+long buildPasswdIndex(const char *path, const char *source);
+
+/**
+ * Maps the index if it is valid, was built for the current state of the
+ * source and is younger than PASSWD_INDEX_TTL.
+ *
+ * @param index The PasswdIndex structure to populate.
+ * @param path The path of the index.
+ * @param source The file the index was built for.
+ * @return 0 on success, -1 if the index is missing, invalid or stale.
+ */
+int openPasswdIndex(PasswdIndex *index, const char *path, const char *source);
+
+/**
+ * Maps the index, building it first if it is missing or stale.
+ *
+ * @param index The PasswdIndex structure to populate.
+ * @param path The path of the index.
+ * @param source The file the index is built for.
+ * @return 0 on success, -1 on error.
+ */
+int loadPasswdIndex(PasswdIndex *index, const char *path, const char *source);
+
+/**
+ * Looks up a login in the index. A login that is not found may still exist
+ * (e.g. a backend that getpwent() does not enumerate).
+ *
+ * @param index The mapped index.
+ * @param login The login name.
+ * @param pwd Receives the entry; its strings point into the mapping.
+ * @return 0 if the login was found, -1 otherwise.
+ */
+int findPasswdIndex(const PasswdIndex *index, const char *login, struct passwd *pwd);
+
+/**
+ * Unmaps the index.
+ *
+ * @param index The index to close.
+ */
+void closePasswdIndex(PasswdIndex *index);
+
+#endif
@@ -0,0 +1,527 @@
+#define _GNU_SOURCE //Per getaddrinfo_a()
+#include <stdio.h> //Per snprintf()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per i codici di errore
+#include <stdint.h> //Per uint64_t
+#include <time.h> //Per clock_gettime()
+#include <unistd.h> //Per read() e close()
+#include <netdb.h> //Per la risoluzione dei nomi
+#include <sys/epoll.h> //Per il ciclo di eventi
+#include <sys/socket.h> //Per i socket
+#include "remote.h"
+
+/**
+ * Progress of the query to one host.
+ */
+typedef enum {
+    REMOTE_WAITING,     /**< Not started, waiting for a free slot */
+    REMOTE_RESOLVING,   /**< Name being resolved with getaddrinfo_a() */
+    REMOTE_CONNECTING,  /**< Non-blocking connect() in progress */
+    REMOTE_SENDING,     /**< Sending the query line */
+    REMOTE_READING,     /**< Reading the answer until the server closes */
+    REMOTE_DONE,        /**< Answer complete */
+    REMOTE_FAILED       /**< Error or timeout */
+} RemoteState;
+
+/**
+ * An asynchronous name resolution. Allocated on its own because glibc keeps
+ * using it until the request completes, even after a timeout.
+ */
+typedef struct {
+    struct gaicb cb;         /**< The getaddrinfo_a() request */
+    struct addrinfo hints;   /**< Hints referenced by cb */
+    char host[256];          /**< Name referenced by cb */
+    char port[16];           /**< Port referenced by cb */
+} Resolution;
+
+/**
+ * The query of one argument to one of its hosts.
+ */
+typedef struct {
+    const char *label;       /**< Host as written on the command line */
+    char host[256];          /**< Name or address of the host */
+    char port[16];           /**< Port of the finger service */
+    char request[512];       /**< Query line, CRLF terminated */
+    size_t requestLen;       /**< Length of request */
+    int list;                /**< 1 if the query lists the users (no username) */
+    RemoteState state;       /**< Progress of the query */
+    Resolution *resolution;  /**< Pending resolution, NULL if none */
+    struct addrinfo *addrs;  /**< Addresses of the host */
+    struct addrinfo *addr;   /**< Address being tried */
+    int fd;                  /**< Socket, -1 if closed */
+    size_t sent;             /**< Bytes of request already sent */
+    char *response;          /**< Answer received so far */
+    size_t len;              /**< Bytes in response */
+    size_t capacity;         /**< Bytes allocated for response */
+    int truncated;           /**< 1 if the answer exceeded REMOTE_MAX_RESPONSE */
+    int errnum;              /**< errno of the failure, 0 if reason is set */
+    const char *reason;      /**< Description of a failure that is not an errno */
+    uint64_t deadline;       /**< Time by which the answer must be complete */
+} RemoteQuery;
+
+/**
+ * Returns the monotonic clock in milliseconds.
+ *
+ * @return The time in milliseconds.
+ */
+static uint64_t nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Tells whether a command-line argument is a remote query.
+ *
+ * @param arg The argument.
+ * @return 1 for a remote query, 0 for a local username.
+ */
+int isRemoteQuery(const char *arg) {
+    return strchr(arg, '@') != NULL;
+}
+
+/**
+ * Splits a host into name and port: "name", "name:port", "[IPv6]:port" or a
+ * bare IPv6 address.
+ *
+ * @param query The query that receives host and port.
+ * @param text The host as written on the command line.
+ * @return 0 on success, -1 if the host is empty or too long.
+ */
+static int parseHost(RemoteQuery *query, const char *text) {
+    const char *colon = strrchr(text, ':');
+    size_t hostLen = strlen(text);
+    const char *port = REMOTE_DEFAULT_PORT;
+
+    if (text[0] == '[') {
+        const char *close = strchr(text, ']');
+        if (close == NULL || (close[1] != '\0' && close[1] != ':')) return -1;
+        text++;
+        hostLen = close - text;
+        if (close[1] == ':') port = close + 2;
+    } else if (colon != NULL && strchr(text, ':') == colon) {
+        //Un solo ":" separa la porta; più di uno è un indirizzo IPv6 senza porta
+        hostLen = colon - text;
+        port = colon + 1;
+    }
+    if (hostLen == 0 || hostLen >= sizeof(query->host) || *port == '\0' || strlen(port) >= sizeof(query->port)) {
+        return -1;
+    }
+    memcpy(query->host, text, hostLen);
+    query->host[hostLen] = '\0';
+    snprintf(query->port, sizeof(query->port), "%s", port);
+    return 0;
+}
+
+/**
+ * Marks a query as failed and closes its socket.
+ *
+ * @param query The query.
+ * @param errnum The errno of the failure, or 0.
+ * @param reason The description of a failure that is not an errno, or NULL.
+ */
+static void failQuery(RemoteQuery *query, int errnum, const char *reason) {
+    if (query->fd >= 0) close(query->fd); //La chiusura rimuove anche il descrittore da epoll
+    query->fd = -1;
+    query->errnum = errnum;
+    query->reason = reason;
+    query->state = REMOTE_FAILED;
+}
+
+/**
+ * Starts a non-blocking connection to the current address of the query,
+ * moving on to the next addresses if the connection fails at once.
+ *
+ * @param query The query, with addr set.
+ * @param epfd The epoll descriptor.
+ */
+static void connectNext(RemoteQuery *query, int epfd) {
+    int errnum = ECONNREFUSED;
+
+    for (; query->addr != NULL; query->addr = query->addr->ai_next) {
+        struct addrinfo *ai = query->addr;
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            errnum = errno;
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0 && errno != EINPROGRESS) {
+            errnum = errno;
+            close(fd);
+            continue;
+        }
+        //Connessione in corso: il socket diventa scrivibile quando è stabilita o fallita
+        struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = query};
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            errnum = errno;
+            close(fd);
+            continue;
+        }
+        query->fd = fd;
+        query->state = REMOTE_CONNECTING;
+        return;
+    }
+    failQuery(query, errnum, NULL);
+}
+
+/**
+ * Starts a query: resolves the host at once if it is a numeric address,
+ * otherwise submits an asynchronous resolution.
+ *
+ * @param query The query.
+ * @param epfd The epoll descriptor.
+ * @param deadline The time by which the answer must be complete.
+ */
+static void startQuery(RemoteQuery *query, int epfd, uint64_t deadline) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM,
+                             .ai_flags = AI_NUMERICHOST | AI_NUMERICSERV};
+
+    query->deadline = deadline;
+    if (getaddrinfo(query->host, query->port, &hints, &query->addrs) == 0) {
+        query->addr = query->addrs;
+        connectNext(query, epfd);
+        return;
+    }
+
+    //Nome da risolvere: la risoluzione procede in background senza bloccare gli altri host
+    Resolution *resolution = calloc(1, sizeof(Resolution));
+    if (resolution == NULL) {
+        failQuery(query, ENOMEM, NULL);
+        return;
+    }
+    resolution->hints.ai_family = AF_UNSPEC;
+    resolution->hints.ai_socktype = SOCK_STREAM;
+    snprintf(resolution->host, sizeof(resolution->host), "%s", query->host);
+    snprintf(resolution->port, sizeof(resolution->port), "%s", query->port);
+    resolution->cb.ar_name = resolution->host;
+    resolution->cb.ar_service = resolution->port;
+    resolution->cb.ar_request = &resolution->hints;
+
+    struct gaicb *list[1] = {&resolution->cb};
+    int status = getaddrinfo_a(GAI_NOWAIT, list, 1, NULL);
+    if (status != 0) {
+        free(resolution);
+        failQuery(query, 0, gai_strerror(status));
+        return;
+    }
+    query->resolution = resolution;
+    query->state = REMOTE_RESOLVING;
+}
+
+/**
+ * Checks whether the resolution of a query has completed and connects if so.
+ *
+ * @param query The query, in REMOTE_RESOLVING.
+ * @param epfd The epoll descriptor.
+ */
+static void checkResolution(RemoteQuery *query, int epfd) {
+    int status = gai_error(&query->resolution->cb);
+    if (status == EAI_INPROGRESS) return;
+
+    query->addrs = query->resolution->cb.ar_result;
+    free(query->resolution);
+    query->resolution = NULL;
+    if (status != 0) {
+        failQuery(query, 0, gai_strerror(status));
+        return;
+    }
+    query->addr = query->addrs;
+    connectNext(query, epfd);
+}
+
+/**
+ * Gives up on a query whose deadline has passed.
+ *
+ * @param query The query, not yet finished.
+ */
+static void expireQuery(RemoteQuery *query) {
+    if (query->resolution != NULL) {
+        int status = gai_cancel(&query->resolution->cb);
+        if (status == EAI_CANCELED || status == EAI_ALLDONE) {
+            if (status == EAI_ALLDONE && gai_error(&query->resolution->cb) == 0) {
+                freeaddrinfo(query->resolution->cb.ar_result);
+            }
+            free(query->resolution);
+        }
+        //EAI_NOTCANCELED: glibc sta ancora usando la richiesta, che viene lasciata allocata
+        query->resolution = NULL;
+    }
+    failQuery(query, ETIMEDOUT, NULL);
+}
+
+/**
+ * Sends the query line once the connection is established.
+ *
+ * @param query The query, in REMOTE_CONNECTING or REMOTE_SENDING.
+ * @param epfd The epoll descriptor.
+ */
+static void onWritable(RemoteQuery *query, int epfd) {
+    if (query->state == REMOTE_CONNECTING) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(query->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+        if (error != 0) {
+            //Indirizzo non raggiungibile: si prova il successivo dell'host
+            close(query->fd);
+            query->fd = -1;
+            query->addr = query->addr->ai_next;
+            if (query->addr == NULL) failQuery(query, error, NULL);
+            else connectNext(query, epfd);
+            return;
+        }
+        query->state = REMOTE_SENDING;
+    }
+
+    while (query->sent < query->requestLen) {
+        ssize_t n = send(query->fd, query->request + query->sent, query->requestLen - query->sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR) failQuery(query, errno, NULL);
+            return;
+        }
+        query->sent += n;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = query};
+    epoll_ctl(epfd, EPOLL_CTL_MOD, query->fd, &ev);
+    query->state = REMOTE_READING;
+}
+
+/**
+ * Reads the available part of the answer; the server closes the connection at the end.
+ *
+ * @param query The query, in REMOTE_READING.
+ */
+static void onReadable(RemoteQuery *query) {
+    char buf[16384];
+
+    for (;;) {
+        ssize_t n = read(query->fd, buf, sizeof(buf));
+        if (n == 0) {
+            close(query->fd);
+            query->fd = -1;
+            query->state = REMOTE_DONE;
+            return;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR) failQuery(query, errno, NULL);
+            return;
+        }
+
+        //Oltre REMOTE_MAX_RESPONSE la risposta è letta fino alla fine ma scartata
+        size_t keep = (size_t)n;
+        if (query->len + keep > REMOTE_MAX_RESPONSE) {
+            keep = REMOTE_MAX_RESPONSE - query->len;
+            query->truncated = 1;
+        }
+        if (query->len + keep > query->capacity) {
+            size_t capacity = query->capacity ? query->capacity : 4096;
+            while (capacity < query->len + keep) capacity *= 2;
+            char *grown = realloc(query->response, capacity);
+            if (grown == NULL) {
+                failQuery(query, ENOMEM, NULL);
+                return;
+            }
+            query->response = grown;
+            query->capacity = capacity;
+        }
+        memcpy(query->response + query->len, buf, keep);
+        query->len += keep;
+    }
+}
+
+/**
+ * Appends a line received from a host, with control characters replaced by
+ * '?' so that a server cannot send escape sequences to the terminal.
+ *
+ * @param out The output buffer.
+ * @param line The line, without the line ending.
+ * @param len The length of the line.
+ */
+static void outRemoteLine(OutBuf *out, const char *line, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = line[i];
+        if ((c < 0x20 && c != '\t') || c == 0x7f) {
+            outWrite(out, line + start, i - start);
+            outPutc(out, '?');
+            start = i + 1;
+        }
+    }
+    outWrite(out, line + start, len - start);
+    outPutc(out, '\n');
+}
+
+/**
+ * Prints the answers as one table with a host column.
+ *
+ * @param out The output buffer.
+ * @param queries The finished queries.
+ * @param count The number of queries.
+ */
+static void printRemoteTable(OutBuf *out, const RemoteQuery *queries, size_t count) {
+    size_t width = 4; //"Host"
+    const char *header = NULL;
+    size_t headerLen = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(queries[i].label);
+        if (queries[i].state == REMOTE_DONE && len > width) width = len;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const RemoteQuery *query = &queries[i];
+        if (query->state != REMOTE_DONE) continue;
+        if (!query->list) header = NULL;
+
+        for (size_t start = 0, lineNo = 0; start < query->len; lineNo++) {
+            const char *nl = memchr(query->response + start, '\n', query->len - start);
+            size_t end = nl ? (size_t)(nl - query->response) : query->len;
+            const char *line = query->response + start;
+            size_t len = end - start;
+            if (len > 0 && line[len - 1] == '\r') len--;
+            start = end + 1;
+
+            //Intestazione di un elenco: stampata una volta per gli host che rispondono con la stessa
+            if (query->list && lineNo == 0) {
+                if (header != NULL && len == headerLen && memcmp(line, header, len) == 0) continue;
+                header = line;
+                headerLen = len;
+                outColumn(out, "Host", width);
+                outRemoteLine(out, line, len);
+                continue;
+            }
+            if (len == 0) {
+                outPuts(out, query->label);
+                outPutc(out, '\n');
+                continue;
+            }
+            outColumn(out, query->label, width);
+            outRemoteLine(out, line, len);
+        }
+        if (query->truncated) {
+            outColumn(out, query->label, width);
+            outPuts(out, "[answer truncated]\n");
+        }
+    }
+}
+
+/**
+ * Sends every remote query to its hosts at the same time and prints the answers.
+ *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param queries The remote queries, as accepted by isRemoteQuery().
+ * @param count The number of queries.
+ * @param mode The mode of the run: 'l' asks for the long format ("/W").
+ * @param timeoutMs The time each host has to answer, in milliseconds.
+ * @return The number of hosts that did not answer.
+ */
+size_t fingerRemote(OutBuf *out, OutBuf *err, char *const *queries, size_t count, char mode, long timeoutMs) {
+    size_t total = 0, failed = 0;
+    char **copies = calloc(count ? count : 1, sizeof(char *));
+    RemoteQuery *remote = NULL;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    //Un'interrogazione per ogni host di ogni argomento ("user@hostA,hostB" ne produce due)
+    int ok = copies != NULL && epfd >= 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        copies[i] = strdup(queries[i]);
+        ok = copies[i] != NULL;
+        for (const char *p = ok ? strrchr(copies[i], '@') : NULL; p != NULL; p = strchr(p + 1, ',')) total++;
+    }
+    if (ok && total > 0) remote = calloc(total, sizeof(RemoteQuery));
+    if (!ok || (total > 0 && remote == NULL)) {
+        outFlush(out);
+        outPuts(err, "myFinger: unable to query the remote hosts\n");
+        outFlush(err);
+        for (size_t i = 0; copies != NULL && i < count; i++) free(copies[i]);
+        free(copies);
+        free(remote);
+        if (epfd >= 0) close(epfd);
+        return total;
+    }
+
+    total = 0;
+    for (size_t i = 0; i < count; i++) {
+        char *at = strrchr(copies[i], '@');
+        *at = '\0';
+        const char *user = copies[i]; //Può contenere altri "@": l'host lo inoltra (RFC 1288, {Q2})
+
+        for (char *host = at + 1, *next; host != NULL; host = next) {
+            next = strchr(host, ',');
+            if (next != NULL) *next++ = '\0';
+            RemoteQuery *query = &remote[total++];
+            query->label = host;
+            query->fd = -1;
+            query->list = user[0] == '\0';
+            int len = snprintf(query->request, sizeof(query->request), "%s%s%s\r\n",
+                               mode == 'l' ? "/W" : "", mode == 'l' && user[0] ? " " : "", user);
+            query->requestLen = len > 0 && (size_t)len < sizeof(query->request) ? (size_t)len : 0;
+            if (query->requestLen == 0) failQuery(query, ENAMETOOLONG, NULL);
+            else if (parseHost(query, host) != 0) failQuery(query, 0, "invalid host");
+        }
+    }
+
+    //Ciclo di eventi: al massimo REMOTE_MAX_PARALLEL host in corso, ognuno con la propria scadenza
+    size_t started = 0, active = 0;
+    struct epoll_event events[64];
+    for (;;) {
+        uint64_t now = nowMs();
+        while (active < REMOTE_MAX_PARALLEL && started < total) {
+            RemoteQuery *query = &remote[started++];
+            if (query->state != REMOTE_WAITING) continue;
+            startQuery(query, epfd, now + timeoutMs);
+            active++;
+        }
+
+        //Risoluzioni completate, scadenze superate e host ancora in corso
+        long timeout = -1;
+        int resolving = 0;
+        active = 0;
+        for (size_t i = 0; i < started; i++) {
+            RemoteQuery *query = &remote[i];
+            if (query->state == REMOTE_RESOLVING) checkResolution(query, epfd);
+            if (query->state == REMOTE_DONE || query->state == REMOTE_FAILED) continue;
+            if (now >= query->deadline) {
+                expireQuery(query);
+                continue;
+            }
+            active++;
+            if (query->state == REMOTE_RESOLVING) resolving = 1;
+            if (timeout < 0 || (long)(query->deadline - now) < timeout) timeout = query->deadline - now;
+        }
+        if (active == 0 && started == total) break;
+        if (active < REMOTE_MAX_PARALLEL && started < total) continue;
+        //getaddrinfo_a() non ha un descrittore da attendere: le risoluzioni sono controllate ogni 10 ms
+        if (resolving && timeout > 10) timeout = 10;
+
+        int n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), (int)timeout);
+        for (int i = 0; i < n; i++) {
+            RemoteQuery *query = events[i].data.ptr;
+            if (query->state == REMOTE_CONNECTING || query->state == REMOTE_SENDING) onWritable(query, epfd);
+            else if (query->state == REMOTE_READING) onReadable(query);
+        }
+    }
+
+    printRemoteTable(out, remote, total);
+    for (size_t i = 0; i < total; i++) {
+        RemoteQuery *query = &remote[i];
+        if (query->state == REMOTE_FAILED) {
+            outFlush(out);
+            outPuts(err, "myFinger: ");
+            outPuts(err, query->label);
+            outPuts(err, ": ");
+            outPuts(err, query->reason ? query->reason : strerror(query->errnum));
+            outPutc(err, '\n');
+            outFlush(err);
+            failed++;
+        }
+        if (query->addrs != NULL) freeaddrinfo(query->addrs);
+        free(query->response);
+    }
+    for (size_t i = 0; i < count; i++) free(copies[i]);
+    free(copies);
+    free(remote);
+    close(epfd);
+    return failed;
+}
@@ -0,0 +1,56 @@
+// remote.h
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stddef.h> //Per size_t
+#include "outbuf.h"
+
+/**
+ * TCP port of the finger service (RFC 1288), used when a host has no ":port".
+ */
+#define REMOTE_DEFAULT_PORT "79"
+
+/**
+ * Default time a host has to resolve, connect and send its whole answer, in milliseconds.
+ */
+#define REMOTE_TIMEOUT_MS 5000
+
+/**
+ * Maximum number of hosts queried at the same time.
+ */
+#define REMOTE_MAX_PARALLEL 32
+
+/**
+ * Maximum size of the answer kept for a host; the rest is discarded.
+ */
+#define REMOTE_MAX_RESPONSE (1 << 20)
+
+/**
+ * Tells whether a command-line argument is a remote query: "@host",
+ * "user@host" or a comma-separated list of hosts, e.g. "user@hostA,hostB".
+ *
+ * @param arg The argument.
+ * @return 1 for a remote query, 0 for a local username.
+ */
+int isRemoteQuery(const char *arg);
+
+/**
+ * Sends every remote query to its hosts at the same time over non-blocking
+ * sockets, at most REMOTE_MAX_PARALLEL at once, each with its own deadline,
+ * and prints the answers as one table with a host column, in argument and
+ * host order. The header of a listing is printed once for the hosts that
+ * answer with the same one. Hosts that fail or time out are reported on err
+ * without delaying the others. A host may be given as name, address,
+ * "name:port" or "[IPv6]:port".
+ *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param queries The remote queries, as accepted by isRemoteQuery().
+ * @param count The number of queries.
+ * @param mode The mode of the run: 'l' asks for the long format ("/W").
+ * @param timeoutMs The time each host has to answer, in milliseconds.
+ * @return The number of hosts that did not answer.
+ */
+size_t fingerRemote(OutBuf *out, OutBuf *err, char *const *queries, size_t count, char mode, long timeoutMs);
+
+#endif
@@ -0,0 +1,911 @@
+#define _GNU_SOURCE //Per accept4()
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per i codici di errore
+#include <signal.h> //Per la gestione dei segnali
+#include <stdint.h> //Per uint64_t
+#include <time.h> //Per la gestione del tempo
+#include <unistd.h> //Per close()
+#include <pthread.h> //Per i thread che preparano le risposte
+#include <ctype.h> //Per isspace()
+#include <netinet/in.h> //Per gli indirizzi IPv4
+#include <sys/epoll.h> //Per il ciclo di eventi
+#include <sys/resource.h> //Per il limite dei descrittori aperti
+#include <sys/socket.h> //Per i socket
+#include <sys/timerfd.h> //Per il timer di aggiornamento
+#include <sys/eventfd.h> //Per segnalare al ciclo di eventi i lavori completati
+#include "server.h"
+#include "finger.h"
+#include "snapshot.h"
+
+/**
+ * A rendered response, shared by the cache and the connections sending it.
+ * Only the loop thread counts its references: a worker hands over the one it creates.
+ */
+typedef struct {
+    int refs;     /**< Number of owners (cache, jobs and connections) */
+    size_t len;   /**< Length of data */
+    char data[];  /**< Response text with CRLF line endings */
+} Response;
+
+/**
+ * A cached answer for a username query.
+ */
+typedef struct {
+    char *username;      /**< Queried username (NULL for an empty slot) */
+    Response *response;  /**< Rendered answer */
+    time_t rendered;     /**< When the answer was rendered */
+} UserResponse;
+
+/**
+ * Work handed to the worker threads.
+ */
+typedef enum {
+    JOB_USER,    /**< Render the answer for a username */
+    JOB_LISTS,   /**< Render the two listings again (idle times change) */
+    JOB_UPDATE   /**< Apply the changes reported by inotify, then render the listings */
+} JobKind;
+
+/**
+ * A job, queued by the loop thread and handed back once a worker has finished it.
+ */
+typedef struct Job {
+    JobKind kind;               /**< What to do */
+    char *username;             /**< Queried username (JOB_USER) */
+    Response *response;         /**< Answer for the username (JOB_USER), NULL on error */
+    Response *list;             /**< Answer to the empty query (JOB_LISTS, JOB_UPDATE), NULL on error */
+    Response *listLong;         /**< Answer to the "/W" query (JOB_LISTS, JOB_UPDATE), NULL on error */
+    unsigned long generation;   /**< Generation of the state the answers were rendered from */
+    struct Conn *waiters;       /**< Connections waiting for the answer (loop thread only) */
+    struct Job *next;           /**< Next job of the queue it is in */
+    struct Job *nextPending;    /**< Next unfinished user job (loop thread only) */
+} Job;
+
+/**
+ * Live state of the system, the workers rendering from it and the answers
+ * cached by the loop thread.
+ */
+typedef struct {
+    LiveSnapshot live;              /**< utmpx, passwd and mail spool, kept current with inotify */
+    FingerContext ctx;              /**< Rendering context over live */
+    pthread_rwlock_t stateLock;     /**< live and ctx: shared by user jobs, exclusive for updates and listings */
+    unsigned long stateGeneration;  /**< Number of updates that changed live, under stateLock */
+
+    pthread_mutex_t lock;           /**< Protects queue, done and stop */
+    pthread_cond_t work;            /**< Signalled when a job is queued or the workers must stop */
+    Job *queue, *queueTail;         /**< Jobs waiting for a worker */
+    Job *done, *doneTail;           /**< Finished jobs waiting for the loop thread */
+    int stop;                       /**< 1 when the workers must exit */
+    int doneFd;                     /**< eventfd written when a job is finished */
+    pthread_t workers[SERVE_WORKERS]; /**< Worker threads */
+    size_t workerCount;             /**< Number of workers started */
+
+    //Da qui in poi solo il thread del ciclo di eventi
+    Response *list;                 /**< Answer to the empty query */
+    Response *listLong;             /**< Answer to the "/W" query */
+    UserResponse *users;            /**< Answers to username queries, rendered on demand */
+    size_t userSlots;               /**< Size of users (power of two) */
+    size_t userCount;               /**< Number of cached answers */
+    unsigned long generation;       /**< Generation of the cached answers */
+    Job *pending;                   /**< User jobs queued or running */
+    int listsQueued;                /**< 1 while a JOB_LISTS or JOB_UPDATE is not finished */
+} Snapshot;
+
+/**
+ * A client connection.
+ */
+typedef struct Conn {
+    int fd;                     /**< Client socket */
+    char in[SERVE_MAX_REQUEST]; /**< Query received so far */
+    size_t inLen;               /**< Bytes in in */
+    Response *out;              /**< Response being sent, NULL while reading */
+    size_t outPos;              /**< Bytes of out already sent */
+    time_t deadline;            /**< Time by which the query, then the answer, must be complete */
+    Job *job;                   /**< Job rendering the answer, NULL if not waiting */
+    struct Conn *nextWaiter;    /**< Next connection waiting for the same job */
+    struct Conn *prev, *next;   /**< List of open connections */
+} Conn;
+
+/**
+ * The open client connections.
+ */
+typedef struct {
+    Conn *head;    /**< First connection, NULL if none */
+    size_t count;  /**< Number of connections */
+} ConnList;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * Signal handler for SIGINT and SIGTERM.
+ *
+ * @param sig The signal number.
+ */
+static void requestStop(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+/**
+ * Drops a reference to a response, freeing it with the last owner.
+ *
+ * @param response The response, may be NULL.
+ */
+static void releaseResponse(Response *response) {
+    if (response != NULL && --response->refs == 0) free(response);
+}
+
+/**
+ * Turns text rendered with LF line endings into a CRLF response.
+ *
+ * @param text The rendered text.
+ * @param len The length of the text.
+ * @return The response with one reference, or NULL if memory could not be allocated.
+ */
+static Response *makeResponse(const char *text, size_t len) {
+    size_t lines = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\n') lines++;
+    }
+
+    Response *response = malloc(sizeof(Response) + len + lines);
+    if (response == NULL) return NULL;
+    response->refs = 1;
+    response->len = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\n') response->data[response->len++] = '\r';
+        response->data[response->len++] = text[i];
+    }
+    return response;
+}
+
+/**
+ * Turns the output rendered in memory into a response and releases the buffer.
+ *
+ * @param out The output buffer, created with fd -1.
+ * @return The response, or NULL on error.
+ */
+static Response *finishResponse(OutBuf *out) {
+    size_t lines = 0;
+    for (size_t c = 0; c < out->chunkCount; c++) {
+        for (size_t i = 0; i < out->chunks[c].len; i++) {
+            if (out->chunks[c].data[i] == '\n') lines++;
+        }
+    }
+
+    //Conversione in CRLF direttamente dai blocchi del buffer, senza copie intermedie
+    Response *response = out->error ? NULL : malloc(sizeof(Response) + out->total + lines);
+    if (response != NULL) {
+        response->refs = 1;
+        response->len = 0;
+        for (size_t c = 0; c < out->chunkCount; c++) {
+            for (size_t i = 0; i < out->chunks[c].len; i++) {
+                if (out->chunks[c].data[i] == '\n') response->data[response->len++] = '\r';
+                response->data[response->len++] = out->chunks[c].data[i];
+            }
+        }
+    }
+    freeOutBuf(out);
+    return response;
+}
+
+/**
+ * Renders a listing of the snapshot into a response.
+ *
+ * @param snapshot The snapshot to render.
+ * @param mode The listLoggedUsers() mode.
+ * @return The response, or NULL on error.
+ */
+static Response *renderList(Snapshot *snapshot, char mode) {
+    OutBuf out;
+    initOutBuf(&out, -1);
+    listLoggedUsers(&out, &snapshot->ctx, mode);
+    return finishResponse(&out);
+}
+
+/**
+ * Renders the answer for a username from the snapshot. Runs on the workers,
+ * several at once, with the state lock held for reading.
+ *
+ * @param snapshot The snapshot to render.
+ * @param username The queried username.
+ * @return The response, or NULL on error.
+ */
+static Response *renderUser(Snapshot *snapshot, const char *username) {
+    //Come in handleUsers(): la ricerca condivisa è l'unica che più thread possono fare insieme
+    struct passwd *pwd = lookupPasswdShared(snapshot->ctx.cache, username);
+    OutBuf out;
+    initOutBuf(&out, -1);
+    if (pwd != NULL) printUserEntry(&out, &snapshot->ctx, username, pwd, 0);
+    else printUserNotFound(&out, username);
+    return finishResponse(&out);
+}
+
+/**
+ * Hands a finished job back to the loop thread.
+ *
+ * @param snapshot The snapshot.
+ * @param job The finished job.
+ */
+static void finishJob(Snapshot *snapshot, Job *job) {
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&snapshot->lock);
+    job->next = NULL;
+    if (snapshot->doneTail) snapshot->doneTail->next = job;
+    else snapshot->done = job;
+    snapshot->doneTail = job;
+    pthread_mutex_unlock(&snapshot->lock);
+    if (write(snapshot->doneFd, &one, sizeof(one)) < 0) {
+        //Il contatore può solo essere già pieno: il ciclo di eventi è comunque svegliato
+    }
+}
+
+/**
+ * Runs a job on a worker.
+ *
+ * @param snapshot The snapshot.
+ * @param job The job.
+ */
+static void runJob(Snapshot *snapshot, Job *job) {
+    if (job->kind == JOB_USER) {
+        //.plan, caselle di posta e wtmp si leggono qui, fuori dal ciclo di eventi
+        pthread_rwlock_rdlock(&snapshot->stateLock);
+        job->response = renderUser(snapshot, job->username);
+        job->generation = snapshot->stateGeneration;
+        pthread_rwlock_unlock(&snapshot->stateLock);
+        finishJob(snapshot, job);
+        return;
+    }
+
+    //Aggiornamenti ed elenchi usano la cache di passwd senza lock: nessun'altra lettura in corso
+    pthread_rwlock_wrlock(&snapshot->stateLock);
+    if (job->kind == JOB_UPDATE && updateLiveSnapshot(&snapshot->live) > 0) snapshot->stateGeneration++;
+    job->list = renderList(snapshot, 0);
+    job->listLong = renderList(snapshot, 'l');
+    job->generation = snapshot->stateGeneration;
+    //Consegnato prima di rilasciare il lock: le risposte rese dal nuovo stato arrivano dopo
+    finishJob(snapshot, job);
+    pthread_rwlock_unlock(&snapshot->stateLock);
+}
+
+/**
+ * Worker thread: runs the queued jobs until the server stops.
+ *
+ * @param arg The Snapshot.
+ * @return Always NULL.
+ */
+static void *serveWorker(void *arg) {
+    Snapshot *snapshot = arg;
+
+    pthread_mutex_lock(&snapshot->lock);
+    for (;;) {
+        while (!snapshot->stop && snapshot->queue == NULL) pthread_cond_wait(&snapshot->work, &snapshot->lock);
+        if (snapshot->stop) break;
+        Job *job = snapshot->queue;
+        snapshot->queue = job->next;
+        if (snapshot->queue == NULL) snapshot->queueTail = NULL;
+        pthread_mutex_unlock(&snapshot->lock);
+
+        runJob(snapshot, job);
+
+        pthread_mutex_lock(&snapshot->lock);
+    }
+    pthread_mutex_unlock(&snapshot->lock);
+    return NULL;
+}
+
+/**
+ * Queues a job for the workers.
+ *
+ * @param snapshot The snapshot.
+ * @param kind The kind of job.
+ * @param username The queried username for JOB_USER, NULL otherwise.
+ * @return The job, or NULL if memory could not be allocated.
+ */
+static Job *queueJob(Snapshot *snapshot, JobKind kind, const char *username) {
+    Job *job = calloc(1, sizeof(Job));
+    if (job == NULL) return NULL;
+    job->kind = kind;
+    if (username != NULL && (job->username = strdup(username)) == NULL) {
+        free(job);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&snapshot->lock);
+    if (snapshot->queueTail) snapshot->queueTail->next = job;
+    else snapshot->queue = job;
+    snapshot->queueTail = job;
+    pthread_cond_signal(&snapshot->work);
+    pthread_mutex_unlock(&snapshot->lock);
+    return job;
+}
+
+/**
+ * Frees a job and the answers it still owns.
+ *
+ * @param job The job, may be NULL.
+ */
+static void freeJob(Job *job) {
+    if (job == NULL) return;
+    free(job->username);
+    releaseResponse(job->response);
+    releaseResponse(job->list);
+    releaseResponse(job->listLong);
+    free(job);
+}
+
+/**
+ * Drops the cached answers to username queries. Responses still being sent
+ * survive until their connection ends.
+ *
+ * @param snapshot The snapshot.
+ */
+static void dropUserResponses(Snapshot *snapshot) {
+    for (size_t i = 0; i < snapshot->userSlots; i++) {
+        free(snapshot->users[i].username);
+        releaseResponse(snapshot->users[i].response);
+    }
+    memset(snapshot->users, 0, snapshot->userSlots * sizeof(UserResponse));
+    snapshot->userCount = 0;
+}
+
+/**
+ * Stops the workers and frees the jobs they left.
+ *
+ * @param snapshot The snapshot.
+ */
+static void stopWorkers(Snapshot *snapshot) {
+    pthread_mutex_lock(&snapshot->lock);
+    snapshot->stop = 1;
+    pthread_cond_broadcast(&snapshot->work);
+    pthread_mutex_unlock(&snapshot->lock);
+    for (size_t i = 0; i < snapshot->workerCount; i++) pthread_join(snapshot->workers[i], NULL);
+    snapshot->workerCount = 0;
+
+    //Ogni lavoro è in coda o concluso: i thread sono fermi
+    for (Job *job = snapshot->queue, *next; job != NULL; job = next) {
+        next = job->next;
+        freeJob(job);
+    }
+    for (Job *job = snapshot->done, *next; job != NULL; job = next) {
+        next = job->next;
+        freeJob(job);
+    }
+    snapshot->queue = snapshot->queueTail = NULL;
+    snapshot->done = snapshot->doneTail = NULL;
+    snapshot->pending = NULL;
+}
+
+/**
+ * Releases a snapshot. Responses still being sent survive until their connection ends.
+ *
+ * @param snapshot The snapshot to free.
+ */
+static void freeSnapshot(Snapshot *snapshot) {
+    if (snapshot == NULL) return;
+    stopWorkers(snapshot);
+    pthread_cond_destroy(&snapshot->work);
+    pthread_mutex_destroy(&snapshot->lock);
+    pthread_rwlock_destroy(&snapshot->stateLock);
+    dropUserResponses(snapshot);
+    free(snapshot->users);
+    releaseResponse(snapshot->list);
+    releaseResponse(snapshot->listLong);
+    closeLiveSnapshot(&snapshot->live);
+    close(snapshot->doneFd);
+    free(snapshot);
+}
+
+/**
+ * Builds the snapshot: loads utmpx, passwd and the mail spool, starts watching
+ * them, renders the listings and starts the workers.
+ *
+ * @return The snapshot, or NULL on error.
+ */
+static Snapshot *loadSnapshot(void) {
+    Snapshot *snapshot = calloc(1, sizeof(Snapshot));
+    if (snapshot == NULL) return NULL;
+
+    snapshot->userSlots = 64;
+    snapshot->users = calloc(snapshot->userSlots, sizeof(UserResponse));
+    snapshot->doneFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (snapshot->users == NULL || snapshot->doneFd < 0 || openLiveSnapshot(&snapshot->live) != 0) {
+        if (snapshot->doneFd >= 0) close(snapshot->doneFd);
+        free(snapshot->users);
+        free(snapshot);
+        return NULL;
+    }
+    //I nomi inesistenti arrivano dai client: memorizzarli farebbe crescere la cache senza limite
+    snapshot->live.cache.cacheMisses = 0;
+    snapshotContext(&snapshot->live, &snapshot->ctx);
+
+    //Le due liste sono le interrogazioni più frequenti: si preparano subito
+    snapshot->list = renderList(snapshot, 0);
+    snapshot->listLong = renderList(snapshot, 'l');
+
+    //Con gli scrittori in attesa non entrano nuovi lettori: gli aggiornamenti non restano indietro
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&snapshot->stateLock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&snapshot->lock, NULL);
+    pthread_cond_init(&snapshot->work, NULL);
+    while (snapshot->workerCount < SERVE_WORKERS &&
+           pthread_create(&snapshot->workers[snapshot->workerCount], NULL, serveWorker, snapshot) == 0) {
+        snapshot->workerCount++;
+    }
+    if (snapshot->workerCount == 0) {
+        freeSnapshot(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+/**
+ * Finds the slot of a username in the table of cached answers.
+ *
+ * @param snapshot The snapshot.
+ * @param username The queried username.
+ * @return The slot holding the username, or the empty slot where it would go.
+ */
+static size_t findUserSlot(const Snapshot *snapshot, const char *username) {
+    size_t hash = 2166136261u;
+    for (const char *p = username; *p; p++) {
+        hash ^= (unsigned char)*p;
+        hash *= 16777619u;
+    }
+
+    size_t mask = snapshot->userSlots - 1;
+    size_t slot = hash & mask;
+    while (snapshot->users[slot].username != NULL && strcmp(snapshot->users[slot].username, username) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Caches the answer for a username, replacing an older one.
+ *
+ * @param snapshot The snapshot.
+ * @param username The queried username.
+ * @param response The answer; the cache takes a new reference.
+ */
+static void cacheUserResponse(Snapshot *snapshot, const char *username, Response *response) {
+    size_t slot = findUserSlot(snapshot, username);
+    if (snapshot->users[slot].username != NULL) {
+        releaseResponse(snapshot->users[slot].response);
+        snapshot->users[slot].response = response;
+        snapshot->users[slot].rendered = time(NULL);
+        response->refs++;
+        return;
+    }
+
+    //Oltre il limite la risposta non viene memorizzata, per non crescere con nomi casuali
+    if (snapshot->userCount >= SERVE_MAX_CACHED_USERS) return;
+
+    //Raddoppia la tabella quando è piena per metà
+    if ((snapshot->userCount + 1) * 2 > snapshot->userSlots) {
+        UserResponse *old = snapshot->users;
+        size_t oldSlots = snapshot->userSlots;
+        UserResponse *grown = calloc(oldSlots * 2, sizeof(UserResponse));
+        if (grown == NULL) return;
+        snapshot->users = grown;
+        snapshot->userSlots = oldSlots * 2;
+        for (size_t i = 0; i < oldSlots; i++) {
+            if (old[i].username != NULL) snapshot->users[findUserSlot(snapshot, old[i].username)] = old[i];
+        }
+        free(old);
+        slot = findUserSlot(snapshot, username);
+    }
+
+    snapshot->users[slot].username = strdup(username);
+    if (snapshot->users[slot].username == NULL) return;
+    snapshot->users[slot].response = response;
+    snapshot->users[slot].rendered = time(NULL);
+    snapshot->userCount++;
+    response->refs++;
+}
+
+/**
+ * Returns the cached answer for a username or queues its rendering. While
+ * the answer is rendered the connection waits for the job, shared by every
+ * connection asking for the same username.
+ *
+ * @param snapshot The snapshot.
+ * @param username The queried username.
+ * @param conn The connection asking.
+ * @return A new reference to the response, or NULL if the connection now waits or on error.
+ */
+static Response *userResponse(Snapshot *snapshot, const char *username, Conn *conn) {
+    size_t slot = findUserSlot(snapshot, username);
+    if (snapshot->users[slot].username != NULL &&
+        time(NULL) - snapshot->users[slot].rendered < SERVE_USER_MAX_AGE) {
+        snapshot->users[slot].response->refs++;
+        return snapshot->users[slot].response;
+    }
+
+    Job *job = snapshot->pending;
+    while (job != NULL && strcmp(job->username, username) != 0) job = job->nextPending;
+    if (job == NULL) {
+        job = queueJob(snapshot, JOB_USER, username);
+        if (job == NULL) return NULL;
+        job->nextPending = snapshot->pending;
+        snapshot->pending = job;
+    }
+    conn->job = job;
+    conn->nextWaiter = job->waiters;
+    job->waiters = conn;
+    return NULL;
+}
+
+/**
+ * Parses an RFC 1288 query line and returns the matching response.
+ *
+ * @param snapshot The current snapshot.
+ * @param line The query, without the line terminator.
+ * @param conn The connection asking, set waiting if the answer must be rendered.
+ * @return A new reference to the response, or NULL if the connection now waits or on error.
+ */
+static Response *answerQuery(Snapshot *snapshot, char *line, Conn *conn) {
+    static const char denied[] = "Finger forwarding service denied.\n";
+    int verbose = 0;
+
+    //{Q1} ::= [{W}|{W}{S}{U}]{C}: "/W" opzionale, poi il nome utente
+    while (isspace((unsigned char)*line)) line++;
+    if (line[0] == '/' && (line[1] == 'W' || line[1] == 'w')) {
+        verbose = 1;
+        line += 2;
+        while (isspace((unsigned char)*line)) line++;
+    }
+    char *end = line;
+    while (*end && !isspace((unsigned char)*end)) end++;
+    *end = '\0';
+
+    if (line[0] == '\0') {
+        Response *list = verbose ? snapshot->listLong : snapshot->list;
+        if (list != NULL) list->refs++;
+        return list;
+    }
+    //{Q2}: l'inoltro verso altri host non è supportato
+    if (strchr(line, '@') != NULL) return makeResponse(denied, sizeof(denied) - 1);
+    return userResponse(snapshot, line, conn);
+}
+
+/**
+ * Closes a connection and removes it from the list and from the job it waits for.
+ *
+ * @param conns The connection list.
+ * @param conn The connection to close.
+ */
+static void closeConn(ConnList *conns, Conn *conn) {
+    if (conn->job != NULL) {
+        Conn **link = &conn->job->waiters;
+        while (*link != conn) link = &(*link)->nextWaiter;
+        *link = conn->nextWaiter;
+    }
+    if (conn->prev) conn->prev->next = conn->next;
+    else conns->head = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    conns->count--;
+    close(conn->fd); //La chiusura rimuove anche il descrittore da epoll
+    releaseResponse(conn->out);
+    free(conn);
+}
+
+/**
+ * Sends as much of the response as the socket accepts.
+ *
+ * @param conn The connection.
+ * @return 1 if the response is complete, 0 if the socket is full, -1 on error.
+ */
+static int flushConn(Conn *conn) {
+    while (conn->outPos < conn->out->len) {
+        ssize_t sent = send(conn->fd, conn->out->data + conn->outPos,
+                            conn->out->len - conn->outPos, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        conn->outPos += sent;
+    }
+    return 1;
+}
+
+/**
+ * Starts sending the answer of a connection.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn The connection, with out set.
+ * @return 1 if the connection must be closed, 0 otherwise.
+ */
+static int startSending(int epfd, Conn *conn) {
+    //Da qui il limite di tempo vale per la ricezione: un client che non legge non tiene la risposta per sempre
+    conn->deadline = time(NULL) + SERVE_SEND_TIMEOUT;
+    int done = flushConn(conn);
+    if (done != 0) return 1;
+
+    //Socket pieno: il resto della risposta parte quando torna scrivibile
+    struct epoll_event ev = {.events = EPOLLOUT, .data.ptr = conn};
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) != 0;
+}
+
+/**
+ * Reads the query from a client and starts sending the answer once it is complete.
+ *
+ * @param epfd The epoll descriptor.
+ * @param snapshot The current snapshot.
+ * @param conn The connection.
+ * @return 1 if the connection must be closed, 0 otherwise.
+ */
+static int readConn(int epfd, Snapshot *snapshot, Conn *conn) {
+    for (;;) {
+        ssize_t got = recv(conn->fd, conn->in + conn->inLen, sizeof(conn->in) - 1 - conn->inLen, 0);
+        if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        if (got == 0) return 1; //Il client ha chiuso senza completare la richiesta
+        conn->inLen += got;
+        conn->in[conn->inLen] = '\0';
+
+        char *eol = strpbrk(conn->in, "\r\n");
+        if (eol == NULL) {
+            if (conn->inLen == sizeof(conn->in) - 1) return 1; //Richiesta troppo lunga
+            continue;
+        }
+        *eol = '\0';
+
+        conn->out = answerQuery(snapshot, conn->in, conn);
+        if (conn->out != NULL) return startSending(epfd, conn);
+        if (conn->job == NULL) return 1;
+
+        //In attesa della risposta non serve altro dal client; errori e chiusure arrivano comunque
+        struct epoll_event ev = {.events = 0, .data.ptr = conn};
+        return epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) != 0;
+    }
+}
+
+/**
+ * Takes the jobs finished by the workers: caches their answers and starts
+ * sending them to the waiting connections.
+ *
+ * @param epfd The epoll descriptor.
+ * @param snapshot The snapshot.
+ * @param conns The connection list.
+ * @param watch The inotify descriptor, armed again after an update.
+ * @param watchTag The tag of the inotify descriptor in epoll.
+ */
+static void collectJobs(int epfd, Snapshot *snapshot, ConnList *conns, int watch, void *watchTag) {
+    uint64_t count;
+    if (read(snapshot->doneFd, &count, sizeof(count)) < 0) return;
+
+    pthread_mutex_lock(&snapshot->lock);
+    Job *done = snapshot->done;
+    snapshot->done = snapshot->doneTail = NULL;
+    pthread_mutex_unlock(&snapshot->lock);
+
+    //I lavori arrivano nell'ordine in cui sono stati conclusi
+    for (Job *job = done, *next; job != NULL; job = next) {
+        next = job->next;
+
+        if (job->kind != JOB_USER) {
+            //Lo stato è cambiato: le risposte per utente vanno rifatte alla prossima richiesta
+            if (job->generation != snapshot->generation) {
+                dropUserResponses(snapshot);
+                snapshot->generation = job->generation;
+            }
+            if (job->list != NULL) {
+                releaseResponse(snapshot->list);
+                snapshot->list = job->list;
+                job->list = NULL;
+            }
+            if (job->listLong != NULL) {
+                releaseResponse(snapshot->listLong);
+                snapshot->listLong = job->listLong;
+                job->listLong = NULL;
+            }
+            snapshot->listsQueued = 0;
+            if (job->kind == JOB_UPDATE) {
+                struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = watchTag};
+                epoll_ctl(epfd, EPOLL_CTL_MOD, watch, &ev);
+            }
+            freeJob(job);
+            continue;
+        }
+
+        Job **link = &snapshot->pending;
+        while (*link != job) link = &(*link)->nextPending;
+        *link = job->nextPending;
+
+        //Una risposta resa prima dell'ultimo cambiamento serve solo a chi l'aveva chiesta
+        if (job->response != NULL && job->generation == snapshot->generation) {
+            cacheUserResponse(snapshot, job->username, job->response);
+        }
+        for (Conn *conn = job->waiters, *nextWaiter; conn != NULL; conn = nextWaiter) {
+            nextWaiter = conn->nextWaiter;
+            conn->job = NULL;
+            conn->out = job->response;
+            if (conn->out != NULL) conn->out->refs++;
+            if (conn->out == NULL || startSending(epfd, conn)) closeConn(conns, conn);
+        }
+        freeJob(job);
+    }
+}
+
+/**
+ * Opens the listening socket.
+ *
+ * @param port The TCP port to listen on.
+ * @return The socket, or -1 on error.
+ */
+static int openListener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Runs an RFC 1288 finger server on the given TCP port until SIGINT or SIGTERM.
+ *
+ * @param port The TCP port to listen on.
+ * @return 0 on a clean shutdown, 1 on error.
+ */
+int runFingerServer(int port) {
+    static char listenerTag, timerTag, watchTag, doneTag; //Identificano i descrittori non associati a una connessione
+    struct epoll_event events[256];
+    ConnList conns = {NULL, 0};
+
+    //Con migliaia di client servono tutti i descrittori consentiti
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = requestStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = openListener(port);
+    if (listener < 0) {
+        perror("myFinger: unable to listen");
+        return 1;
+    }
+
+    Snapshot *snapshot = loadSnapshot();
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (snapshot == NULL || epfd < 0 || timer < 0) {
+        perror("myFinger: unable to start the server");
+        freeSnapshot(snapshot);
+        close(listener);
+        if (epfd >= 0) close(epfd);
+        if (timer >= 0) close(timer);
+        return 1;
+    }
+
+    struct itimerspec period = {
+        .it_interval = {SERVE_REFRESH_MS / 1000, (SERVE_REFRESH_MS % 1000) * 1000000L},
+        .it_value = {SERVE_REFRESH_MS / 1000, (SERVE_REFRESH_MS % 1000) * 1000000L},
+    };
+    timerfd_settime(timer, 0, &period, NULL);
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &listenerTag};
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev);
+    ev.data.ptr = &timerTag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, timer, &ev);
+    ev.data.ptr = &doneTag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, snapshot->doneFd, &ev);
+    //Una notifica alla volta: il descrittore è riarmato quando il worker ha applicato i cambiamenti
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = &watchTag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, snapshot->live.fd, &ev);
+    int refreshWanted = 0, updateWanted = 0;
+
+    while (!stopRequested) {
+        int n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("myFinger: epoll_wait");
+            break;
+        }
+        int sweep = 0, collect = 0;
+
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+
+            if (tag == &listenerTag) {
+                //Accetta tutte le connessioni in attesa
+                int fd;
+                while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    //Oltre il limite la connessione è chiusa subito: il client lo vede invece di restare in attesa
+                    Conn *conn = conns.count < SERVE_MAX_CONNECTIONS ? calloc(1, sizeof(Conn)) : NULL;
+                    if (conn == NULL) {
+                        close(fd);
+                        continue;
+                    }
+                    conn->fd = fd;
+                    conn->deadline = time(NULL) + SERVE_CLIENT_TIMEOUT;
+                    conn->next = conns.head;
+                    if (conns.head) conns.head->prev = conn;
+                    conns.head = conn;
+                    conns.count++;
+
+                    struct epoll_event cev = {.events = EPOLLIN, .data.ptr = conn};
+                    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev) != 0) closeConn(&conns, conn);
+                }
+            } else if (tag == &timerTag) {
+                uint64_t expirations;
+                if (read(timer, &expirations, sizeof(expirations)) < 0) continue;
+
+                //Solo i tempi di inattività cambiano: si rifanno gli elenchi, non le risposte per utente
+                refreshWanted = 1;
+                sweep = 1;
+            } else if (tag == &watchTag) {
+                //utmpx, passwd o caselle di posta modificati: le differenze le applica un worker
+                updateWanted = 1;
+            } else if (tag == &doneTag) {
+                collect = 1;
+            } else {
+                Conn *conn = tag;
+                int closeIt;
+                if (conn->job != NULL) {
+                    closeIt = 1; //Errore o chiusura mentre la risposta è in preparazione
+                } else if (conn->out == NULL) {
+                    closeIt = readConn(epfd, snapshot, conn);
+                } else {
+                    closeIt = flushConn(conn) != 0;
+                }
+                if (closeIt) closeConn(&conns, conn);
+            }
+        }
+
+        //Dopo il ciclo sugli eventi, che può ancora riferirsi alle connessioni in attesa
+        if (collect) collectJobs(epfd, snapshot, &conns, snapshot->live.fd, &watchTag);
+
+        //Un aggiornamento o un nuovo elenco alla volta; quelli in coda ne prendono il posto
+        if (!snapshot->listsQueued && (updateWanted || refreshWanted) &&
+            queueJob(snapshot, updateWanted ? JOB_UPDATE : JOB_LISTS, NULL) != NULL) {
+            snapshot->listsQueued = 1;
+            updateWanted = refreshWanted = 0;
+        }
+
+        //Chiude i client che non hanno completato la richiesta o la ricezione in tempo; fatto dopo
+        //il ciclo sugli eventi perché il gruppo corrente può ancora riferirsi a loro
+        if (sweep) {
+            time_t now = time(NULL);
+            for (Conn *conn = conns.head, *next; conn != NULL; conn = next) {
+                next = conn->next;
+                if (conn->job == NULL && conn->deadline < now) closeConn(&conns, conn);
+            }
+        }
+    }
+
+    while (conns.head != NULL) closeConn(&conns, conns.head);
+    freeSnapshot(snapshot);
+    close(timer);
+    close(epfd);
+    close(listener);
+    return 0;
+}
@@ -0,0 +1,64 @@
+// server.h
+#ifndef SERVER_H
+#define SERVER_H
+
+/**
+ * Interval between two renderings of the listings, in milliseconds (idle
+ * times change even when the watched files do not).
+ */
+#define SERVE_REFRESH_MS 1000
+
+/**
+ * Maximum length of a query line, terminator included.
+ */
+#define SERVE_MAX_REQUEST 512
+
+/**
+ * Seconds a client may take to send its query before it is disconnected.
+ */
+#define SERVE_CLIENT_TIMEOUT 10
+
+/**
+ * Seconds a client may take to receive the whole answer once sending starts.
+ */
+#define SERVE_SEND_TIMEOUT 30
+
+/**
+ * Maximum number of open client connections: beyond it new ones are closed
+ * as soon as they are accepted.
+ */
+#define SERVE_MAX_CONNECTIONS 4096
+
+/**
+ * Maximum number of per-user responses kept in a snapshot.
+ */
+#define SERVE_MAX_CACHED_USERS 4096
+
+/**
+ * Seconds a per-user response is served from the cache. It is dropped
+ * earlier when inotify reports a change.
+ */
+#define SERVE_USER_MAX_AGE 30
+
+/**
+ * Worker threads rendering the answers, so that reading a `.plan`, a mailbox
+ * or wtmp never stalls the event loop.
+ */
+#define SERVE_WORKERS 4
+
+/**
+ * Runs an RFC 1288 finger server on the given TCP port until SIGINT or SIGTERM.
+ * Queries are answered from a live snapshot of utmpx, passwd and the mail
+ * spool updated through inotify. Answers are rendered by SERVE_WORKERS
+ * threads: the listings again every SERVE_REFRESH_MS milliseconds, each
+ * user's answer on the first query, kept until the state changes or for
+ * SERVE_USER_MAX_AGE seconds. Formats are the same as the command line:
+ * an empty query lists the users, "/W" lists them in long format and a
+ * username prints the detailed information of that user.
+ *
+ * @param port The TCP port to listen on.
+ * @return 0 on a clean shutdown, 1 on error.
+ */
+int runFingerServer(int port);
+
+#endif
@@ -0,0 +1,173 @@
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <utmpx.h> //Per accedere alla tabella degli utenti connessi
+#include "session.h"
+#include "stats.h"
+
+/**
+ * Computes the hash of a login name (FNV-1a).
+ *
+ * @param login The login name, at most __UT_NAMESIZE characters.
+ * @return The hash value.
+ */
+static size_t hashLogin(const char *login) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < __UT_NAMESIZE && login[i] != '\0'; i++) {
+        hash ^= (unsigned char)login[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Finds the slot of a login in the open addressing table.
+ *
+ * @param index The session index.
+ * @param login The login name to look up.
+ * @return The slot holding the login, or the empty slot where it would go.
+ */
+static size_t findSlot(const SessionIndex *index, const char *login) {
+    size_t mask = index->slotCount - 1;
+    size_t slot = hashLogin(login) & mask;
+
+    //Scansione lineare fino allo slot dell'utente o al primo slot vuoto
+    while (index->slots[slot] != 0) {
+        const SessionUser *user = &index->users[index->slots[slot] - 1];
+        if (strncmp(user->login, login, __UT_NAMESIZE) == 0) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Reads the whole utmpx table and builds the session index.
+ *
+ * @param index The SessionIndex structure to populate.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int loadSessionIndex(SessionIndex *index) {
+    struct utmpx *ut;
+    struct utmpx *records;
+    size_t count = 0, capacity = 64;
+
+    STAT_BEGIN(STAT_PHASE_UTMP);
+    records = malloc(capacity * sizeof(struct utmpx));
+    if (records == NULL) return -1;
+
+    //Unica lettura della tabella utmpx: copia in memoria le sessioni attive
+    setutxent();
+    while ((ut = getutxent()) != NULL) {
+        STAT_ADD(STAT_UTMP_RECORDS, 1);
+        if (ut->ut_type != USER_PROCESS) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            struct utmpx *grown = realloc(records, capacity * sizeof(struct utmpx));
+            if (grown == NULL) {
+                endutxent();
+                free(records);
+                return -1;
+            }
+            records = grown;
+        }
+        records[count++] = *ut;
+    }
+    endutxent();
+
+    int status = buildSessionIndex(index, records, count);
+    free(records);
+    STAT_END(STAT_PHASE_UTMP);
+    return status;
+}
+
+/**
+ * Builds the session index from utmpx records already in memory.
+ * Records that are not USER_PROCESS are skipped.
+ *
+ * @param index The SessionIndex structure to populate.
+ * @param records The utmpx records, in file order.
+ * @param recordCount The number of records.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int buildSessionIndex(SessionIndex *index, const struct utmpx *records, size_t recordCount) {
+    memset(index, 0, sizeof(*index));
+    index->sessions = malloc((recordCount ? recordCount : 1) * sizeof(struct utmpx));
+    if (index->sessions == NULL) return -1;
+    for (size_t i = 0; i < recordCount; i++) {
+        if (records[i].ut_type == USER_PROCESS) index->sessions[index->count++] = records[i];
+    }
+    STAT_ADD(STAT_SESSIONS, index->count);
+
+    //Tabella hash dimensionata sul numero di sessioni (fattore di carico <= 0.5)
+    index->slotCount = 16;
+    while (index->slotCount < index->count * 2) index->slotCount *= 2;
+    index->slots = calloc(index->slotCount, sizeof(size_t));
+    index->users = malloc((index->count ? index->count : 1) * sizeof(SessionUser));
+    index->ttyLists = malloc((index->count ? index->count : 1) * sizeof(struct utmpx *));
+    if (index->slots == NULL || index->users == NULL || index->ttyLists == NULL) {
+        freeSessionIndex(index);
+        return -1;
+    }
+
+    //Primo passaggio in memoria: utenti distinti, numero di sessioni e ultimo login
+    for (size_t i = 0; i < index->count; i++) {
+        const struct utmpx *s = &index->sessions[i];
+        size_t slot = findSlot(index, s->ut_user);
+        SessionUser *user;
+
+        if (index->slots[slot] == 0) {
+            user = &index->users[index->userCount];
+            memset(user, 0, sizeof(*user));
+            strncpy(user->login, s->ut_user, __UT_NAMESIZE);
+            index->slots[slot] = ++index->userCount;
+        } else {
+            user = &index->users[index->slots[slot] - 1];
+        }
+        if (user->latest == NULL || s->ut_tv.tv_sec > user->latestLogin) {
+            user->latestLogin = s->ut_tv.tv_sec;
+            user->latest = s;
+        }
+        user->count++;
+    }
+
+    //Assegna a ogni utente la sua porzione della lista dei terminali
+    size_t offset = 0;
+    for (size_t u = 0; u < index->userCount; u++) {
+        index->users[u].sessions = index->ttyLists + offset;
+        offset += index->users[u].count;
+        index->users[u].count = 0;
+    }
+
+    //Secondo passaggio in memoria: riempie le liste mantenendo l'ordine di utmpx
+    for (size_t i = 0; i < index->count; i++) {
+        const struct utmpx *s = &index->sessions[i];
+        SessionUser *user = &index->users[index->slots[findSlot(index, s->ut_user)] - 1];
+        user->sessions[user->count++] = s;
+    }
+    return 0;
+}
+
+/**
+ * Looks up the sessions of a login.
+ *
+ * @param index The session index.
+ * @param login The login name to look up.
+ * @return The SessionUser entry, or NULL if the user is not logged in.
+ */
+const SessionUser *findSessionUser(const SessionIndex *index, const char *login) {
+    if (index->slots == NULL) return NULL;
+    size_t slot = findSlot(index, login);
+    return index->slots[slot] ? &index->users[index->slots[slot] - 1] : NULL;
+}
+
+/**
+ * Releases the memory held by the session index.
+ *
+ * @param index The session index to free.
+ */
+void freeSessionIndex(SessionIndex *index) {
+    free(index->sessions);
+    free(index->users);
+    free(index->slots);
+    free(index->ttyLists);
+    memset(index, 0, sizeof(*index));
+}
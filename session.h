@@ -0,0 +1,68 @@
+// session.h
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stddef.h> //Per size_t
+#include <time.h> //Per la gestione del tempo
+#include <utmpx.h> //Per la struttura utmpx
+
+/**
+ * A login found in the utmpx table, together with all of its sessions.
+ */
+typedef struct {
+    char login[__UT_NAMESIZE + 1]; /**< User login name (NUL terminated) */
+    time_t latestLogin;             /**< Most recent login time among the sessions */
+    const struct utmpx *latest;     /**< Session with the most recent login */
+    const struct utmpx **sessions;  /**< Sessions of the user (one per tty) in utmpx order */
+    size_t count;                   /**< Number of sessions of the user */
+} SessionUser;
+
+/**
+ * In-memory index of the utmpx table, read once per invocation.
+ */
+typedef struct {
+    struct utmpx *sessions;  /**< USER_PROCESS records in utmpx order */
+    size_t count;            /**< Number of records in sessions */
+    SessionUser *users;      /**< Distinct logins in first-seen order */
+    size_t userCount;        /**< Number of distinct logins */
+    size_t *slots;           /**< Open addressing table: user index + 1, 0 if empty */
+    size_t slotCount;        /**< Size of the table (power of two) */
+    const struct utmpx **ttyLists; /**< Storage shared by every SessionUser.sessions list */
+} SessionIndex;
+
+/**
+ * Reads the whole utmpx table and builds the session index.
+ *
+ * @param index The SessionIndex structure to populate.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int loadSessionIndex(SessionIndex *index);
+
+/**
+ * Builds the session index from utmpx records already in memory.
+ * Records that are not USER_PROCESS are skipped.
+ *
+ * @param index The SessionIndex structure to populate.
+ * @param records The utmpx records, in file order.
+ * @param recordCount The number of records.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int buildSessionIndex(SessionIndex *index, const struct utmpx *records, size_t recordCount);
+
+/**
+ * Looks up the sessions of a login.
+ *
+ * @param index The session index.
+ * @param login The login name to look up.
+ * @return The SessionUser entry, or NULL if the user is not logged in.
+ */
+const SessionUser *findSessionUser(const SessionIndex *index, const char *login);
+
+/**
+ * Releases the memory held by the session index.
+ *
+ * @param index The session index to free.
+ */
+void freeSessionIndex(SessionIndex *index);
+
+#endif
@@ -0,0 +1,490 @@
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <stdio.h> //Per snprintf()
+#include "sessiontable.h"
+#include "timefmt.h"
+#include "stats.h"
+
+/**
+ * Computes the hash of a string of known length (FNV-1a).
+ *
+ * @param s The string.
+ * @param len The length of the string.
+ * @return The hash value.
+ */
+static size_t hashBytes(const char *s, size_t len) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Finds the slot of a string in the table of the arena.
+ *
+ * @param arena The string arena.
+ * @param s The string to look up.
+ * @param len The length of the string (not 0).
+ * @return The slot holding the string, or the empty slot where it would go.
+ */
+static size_t findStringSlot(const StringArena *arena, const char *s, size_t len) {
+    size_t mask = arena->slotCount - 1;
+    size_t slot = hashBytes(s, len) & mask;
+
+    while (arena->slots[slot].len != 0 &&
+           (arena->slots[slot].len != len || memcmp(arena->data + arena->slots[slot].offset, s, len) != 0)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Stores a string in the arena, or finds the copy already stored.
+ *
+ * @param arena The string arena.
+ * @param s The string (not necessarily NUL-terminated).
+ * @param len The length of the string.
+ * @param ref Receives the handle of the string.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int internString(StringArena *arena, const char *s, size_t len, StrRef *ref) {
+    ref->offset = 0;
+    ref->len = 0;
+    if (len == 0) return 0; //La stringa vuota è il terminatore all'offset 0
+
+    //Raddoppia la tabella quando è piena per metà
+    if ((arena->count + 1) * 2 > arena->slotCount) {
+        StrRef *old = arena->slots;
+        size_t oldCount = arena->slotCount;
+        size_t slotCount = oldCount ? oldCount * 2 : 256;
+        StrRef *grown = calloc(slotCount, sizeof(StrRef));
+        if (grown == NULL) return -1;
+        arena->slots = grown;
+        arena->slotCount = slotCount;
+        for (size_t i = 0; i < oldCount; i++) {
+            if (old[i].len != 0) grown[findStringSlot(arena, arena->data + old[i].offset, old[i].len)] = old[i];
+        }
+        free(old);
+    }
+
+    size_t slot = findStringSlot(arena, s, len);
+    if (arena->slots[slot].len != 0) {
+        *ref = arena->slots[slot];
+        return 0;
+    }
+
+    //Nuova stringa in coda all'arena, con il terminatore
+    size_t need = arena->len + len + 1 + (arena->len == 0);
+    if (need > UINT32_MAX) return -1; //Gli offset sono a 32 bit
+    if (need > arena->capacity) {
+        size_t capacity = arena->capacity ? arena->capacity : 4096;
+        while (capacity < need) capacity *= 2;
+        char *grown = realloc(arena->data, capacity);
+        if (grown == NULL) return -1;
+        arena->data = grown;
+        arena->capacity = capacity;
+    }
+    if (arena->len == 0) arena->data[arena->len++] = '\0';
+
+    ref->offset = (uint32_t)arena->len;
+    ref->len = (uint32_t)len;
+    memcpy(arena->data + arena->len, s, len);
+    arena->data[arena->len + len] = '\0';
+    arena->len += len + 1;
+    arena->slots[slot] = *ref;
+    arena->count++;
+    return 0;
+}
+
+/**
+ * Stores the fields of a GECOS string: name, office and phone, taken like
+ * strtok() does as the first three non-empty comma-separated parts. A phone
+ * of ten digits is written as 061-234-5678.
+ *
+ * @param arena The string arena.
+ * @param gecos The GECOS field.
+ * @param refs Receives the handles of name, office and phone.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int internGecos(StringArena *arena, const char *gecos, PasswdRefs *refs) {
+    StrRef *targets[3] = {&refs->name, &refs->office, &refs->phone};
+    const char *p = gecos ? gecos : "";
+
+    for (int field = 0; field < 3; field++) {
+        while (*p == ',') p++; //Come strtok(): le parti vuote sono saltate
+        size_t len = strcspn(p, ",");
+        if (field == 2 && len == 10) {
+            char phone[16];
+            snprintf(phone, sizeof(phone), "%.3s-%.3s-%.4s", p, p + 3, p + 6);
+            if (internString(arena, phone, 12, targets[field]) != 0) return -1;
+        } else if (internString(arena, p, len, targets[field]) != 0) {
+            return -1;
+        }
+        p += len;
+    }
+    return 0;
+}
+
+/**
+ * Initializes an empty session table. Nothing is allocated until the first
+ * session. GECOS is parsed unless withGecos is cleared before appending.
+ *
+ * @param table The SessionTable structure to initialize.
+ * @param withMailAndPlan 1 to keep mailbox and `.plan` probes for every session.
+ */
+void initSessionTable(SessionTable *table, int withMailAndPlan) {
+    memset(table, 0, sizeof(*table));
+    table->withMailAndPlan = withMailAndPlan;
+    table->withGecos = 1;
+}
+
+/**
+ * Resizes one column of the table.
+ *
+ * @param column The column, replaced on success.
+ * @param size The size of one element.
+ * @param capacity The new number of rows.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int growColumn(void **column, size_t size, size_t capacity) {
+    void *grown = realloc(*column, capacity * size);
+    if (grown == NULL) return -1;
+    *column = grown;
+    return 0;
+}
+
+/**
+ * Doubles the number of rows of every column.
+ *
+ * @param table The session table.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int growSessionTable(SessionTable *table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : 16;
+    StrRef **refs[] = {&table->login, &table->name, &table->tty, &table->directory,
+                       &table->shell, &table->office, &table->phone};
+
+    //Le colonne già ingrandite restano valide anche se una successiva fallisce
+    for (size_t i = 0; i < sizeof(refs) / sizeof(refs[0]); i++) {
+        if (growColumn((void **)refs[i], sizeof(StrRef), capacity) != 0) return -1;
+    }
+    if (growColumn((void **)&table->uid, sizeof(uid_t), capacity) != 0 ||
+        growColumn((void **)&table->loginTime, sizeof(time_t), capacity) != 0 ||
+        growColumn((void **)&table->idleSeconds, sizeof(long), capacity) != 0 ||
+        growColumn((void **)&table->what, sizeof(StrRef), capacity) != 0 ||
+        growColumn((void **)&table->messages, sizeof(signed char), capacity) != 0) {
+        return -1;
+    }
+    if (table->withMailAndPlan &&
+        (growColumn((void **)&table->mail, sizeof(FileProbe), capacity) != 0 ||
+         growColumn((void **)&table->mailMessages, sizeof(long), capacity) != 0 ||
+         growColumn((void **)&table->plan, sizeof(FileProbe), capacity) != 0)) {
+        return -1;
+    }
+    table->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Stores the login and the passwd strings of a user in the arena.
+ *
+ * @param table The session table.
+ * @param login The login name, not necessarily NUL-terminated.
+ * @param loginLen The length of the login name.
+ * @param pwd The passwd entry of the user.
+ * @param refs Receives the handles.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int internPasswdFields(SessionTable *table, const char *login, size_t loginLen, const struct passwd *pwd,
+                              PasswdRefs *refs) {
+    if (internString(&table->strings, login, loginLen, &refs->login) != 0 ||
+        internString(&table->strings, pwd->pw_dir, strlen(pwd->pw_dir), &refs->directory) != 0 ||
+        internString(&table->strings, pwd->pw_shell, strlen(pwd->pw_shell), &refs->shell) != 0) {
+        return -1;
+    }
+    //Nome, ufficio e telefono solo se qualche colonna li stampa
+    if (table->withGecos) return internGecos(&table->strings, pwd->pw_gecos, refs);
+    refs->name = refs->office = refs->phone = (StrRef){0, 0};
+    return 0;
+}
+
+/**
+ * Stores the strings of a passwd entry in the table without adding a
+ * session, e.g. for a user who is not logged in.
+ *
+ * @param table The session table.
+ * @param pwd The passwd entry.
+ * @param refs Receives the handles (pwd is left NULL).
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int internPasswd(SessionTable *table, const struct passwd *pwd, PasswdRefs *refs) {
+    memset(refs, 0, sizeof(*refs));
+    return internPasswdFields(table, pwd->pw_name, strlen(pwd->pw_name), pwd, refs);
+}
+
+/**
+ * Appends a session.
+ *
+ * @param table The session table.
+ * @param ut The utmpx record of the session.
+ * @param pwd The passwd entry of its user.
+ * @return The row of the session, or -1 if memory could not be allocated.
+ */
+long appendSession(SessionTable *table, const struct utmpx *ut, const struct passwd *pwd) {
+    if (table->count == table->capacity && growSessionTable(table) != 0) return -1;
+
+    //Le stringhe di passwd sono le stesse per tutte le sessioni di un utente. La chiave è il login:
+    //lo stesso puntatore può indicare utenti diversi (es. il buffer statico di getpwnam())
+    size_t loginLen = strnlen(ut->ut_user, sizeof(ut->ut_user));
+    PasswdRefs *memo = &table->memo[hashBytes(ut->ut_user, loginLen) & (SESSION_MEMO_SLOTS - 1)];
+    if (memo->pwd != pwd || memo->login.len != loginLen ||
+        memcmp(sessionString(table, memo->login), ut->ut_user, loginLen) != 0) {
+        memo->pwd = NULL;
+        if (internPasswdFields(table, ut->ut_user, loginLen, pwd, memo) != 0) return -1;
+        memo->pwd = pwd;
+    }
+
+    size_t row = table->count;
+    if (internString(&table->strings, ut->ut_line, strnlen(ut->ut_line, sizeof(ut->ut_line)), &table->tty[row]) != 0) {
+        return -1;
+    }
+    table->login[row] = memo->login;
+    table->name[row] = memo->name;
+    table->directory[row] = memo->directory;
+    table->shell[row] = memo->shell;
+    table->office[row] = memo->office;
+    table->phone[row] = memo->phone;
+    table->uid[row] = pwd->pw_uid;
+    table->loginTime[row] = ut->ut_tv.tv_sec;
+    table->idleSeconds[row] = -1;
+    table->what[row] = (StrRef){0, 0};
+    table->messages[row] = -1;
+    if (table->withMailAndPlan) {
+        memset(&table->mail[row], 0, sizeof(FileProbe));
+        memset(&table->plan[row], 0, sizeof(FileProbe));
+        table->mailMessages[row] = -1;
+    }
+    table->count++;
+    return (long)row;
+}
+
+/**
+ * Stores the command in the foreground of the terminal of a session.
+ *
+ * @param table The session table.
+ * @param row The row of the session.
+ * @param command The command line.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int setSessionCommand(SessionTable *table, size_t row, const char *command) {
+    return internString(&table->strings, command, strlen(command), &table->what[row]);
+}
+
+/**
+ * Returns the string of a handle.
+ *
+ * @param table The session table.
+ * @param ref The handle.
+ * @return The NUL-terminated string, valid until the table grows or is freed.
+ */
+const char *sessionString(const SessionTable *table, StrRef ref) {
+    return ref.len ? table->strings.data + ref.offset : "";
+}
+
+/**
+ * Reads every field of a session as a string.
+ *
+ * @param table The session table.
+ * @param row The row of the session.
+ * @param out The SessionRow structure to populate.
+ */
+void getSessionRow(const SessionTable *table, size_t row, SessionRow *out) {
+    const StrRef *stored[SESSION_FIELD_COUNT] = {
+        [SESSION_LOGIN] = &table->login[row],   [SESSION_NAME] = &table->name[row],
+        [SESSION_TTY] = &table->tty[row],       [SESSION_DIRECTORY] = &table->directory[row],
+        [SESSION_SHELL] = &table->shell[row],   [SESSION_OFFICE] = &table->office[row],
+        [SESSION_PHONE] = &table->phone[row],
+    };
+    for (int i = 0; i < SESSION_FIELD_COUNT; i++) {
+        if (stored[i] == NULL) continue;
+        out->text[i] = sessionString(table, *stored[i]);
+        out->len[i] = stored[i]->len;
+    }
+
+    //Campi calcolati: inattività, data e ora del login
+    out->idle[0] = '\0';
+    if (table->idleSeconds[row] >= 0) getIdleTimeFormatted_r(table->idleSeconds[row], false, out->idle, sizeof(out->idle));
+    STAT_BEGIN(STAT_PHASE_TIME);
+    formatMonthDay(table->loginTime[row], out->weekDay, sizeof(out->weekDay));
+    formatHoursMinutes(table->loginTime[row], out->hoursMinutes, sizeof(out->hoursMinutes));
+    STAT_END(STAT_PHASE_TIME);
+    out->text[SESSION_IDLE] = out->idle;
+    out->len[SESSION_IDLE] = strlen(out->idle);
+    out->text[SESSION_WEEKDAY] = out->weekDay;
+    out->len[SESSION_WEEKDAY] = strlen(out->weekDay);
+    out->text[SESSION_HOURS_MINUTES] = out->hoursMinutes;
+    out->len[SESSION_HOURS_MINUTES] = strlen(out->hoursMinutes);
+}
+
+/**
+ * Returns the text columns of a table, in the order of the image.
+ *
+ * @param table The session table.
+ * @param columns Receives the seven columns.
+ */
+static void textColumns(const SessionTable *table, StrRef **columns) {
+    columns[0] = table->login;
+    columns[1] = table->name;
+    columns[2] = table->tty;
+    columns[3] = table->directory;
+    columns[4] = table->shell;
+    columns[5] = table->office;
+    columns[6] = table->phone;
+}
+
+/**
+ * Returns the size of the image of a table.
+ *
+ * @param table The session table.
+ * @return The size in bytes.
+ */
+size_t sessionTableImageSize(const SessionTable *table) {
+    return sizeof(SessionImageHeader) + table->count * (7 * sizeof(StrRef) + 2 * sizeof(int64_t)) +
+           table->strings.len;
+}
+
+/**
+ * Writes the image of a table: sessions, strings, login and idle times.
+ *
+ * @param table The session table.
+ * @param image The destination, of sessionTableImageSize() bytes.
+ */
+void writeSessionTableImage(const SessionTable *table, void *image) {
+    SessionImageHeader header = {table->count, table->strings.len};
+    StrRef *columns[7];
+    char *p = image;
+
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    textColumns(table, columns);
+    for (int c = 0; c < 7; c++) {
+        if (table->count > 0) memcpy(p, columns[c], table->count * sizeof(StrRef));
+        p += table->count * sizeof(StrRef);
+    }
+    //time_t e long possono essere più stretti: l'immagine usa sempre 64 bit
+    for (size_t i = 0; i < table->count; i++, p += sizeof(int64_t)) {
+        int64_t value = table->loginTime[i];
+        memcpy(p, &value, sizeof(value));
+    }
+    for (size_t i = 0; i < table->count; i++, p += sizeof(int64_t)) {
+        int64_t value = table->idleSeconds[i];
+        memcpy(p, &value, sizeof(value));
+    }
+    if (table->strings.len > 0) memcpy(p, table->strings.data, table->strings.len);
+}
+
+/**
+ * Fills an empty table from an image.
+ *
+ * @param table The SessionTable structure to populate.
+ * @param image The image.
+ * @param size The number of readable bytes at image.
+ * @return 0 on success, -1 if the image is invalid or memory could not be allocated.
+ */
+int readSessionTableImage(SessionTable *table, const void *image, size_t size) {
+    SessionImageHeader header;
+    const char *p = image;
+    const size_t rowSize = 7 * sizeof(StrRef) + 2 * sizeof(int64_t);
+
+    initSessionTable(table, 0);
+    if (size < sizeof(header)) return -1;
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    size -= sizeof(header);
+    if (header.count > size / rowSize || header.stringsLen != size - header.count * rowSize ||
+        header.stringsLen > UINT32_MAX) {
+        return -1;
+    }
+
+    table->capacity = header.count;
+    table->count = header.count;
+    size_t rows = header.count ? header.count : 1;
+    StrRef *columns[7];
+    StrRef **targets[] = {&table->login, &table->name, &table->tty, &table->directory,
+                          &table->shell, &table->office, &table->phone};
+    for (int c = 0; c < 7; c++) *targets[c] = malloc(rows * sizeof(StrRef));
+    table->uid = malloc(rows * sizeof(uid_t));
+    table->loginTime = malloc(rows * sizeof(time_t));
+    table->idleSeconds = malloc(rows * sizeof(long));
+    table->what = calloc(rows, sizeof(StrRef));
+    table->messages = malloc(rows * sizeof(signed char));
+    table->strings.data = malloc(header.stringsLen ? header.stringsLen : 1);
+    textColumns(table, columns);
+    int allocated = table->uid != NULL && table->loginTime != NULL && table->idleSeconds != NULL && table->what != NULL &&
+                    table->messages != NULL && table->strings.data != NULL;
+    for (int c = 0; c < 7; c++) allocated = allocated && columns[c] != NULL;
+    if (!allocated) {
+        freeSessionTable(table);
+        return -1;
+    }
+    for (int c = 0; c < 7; c++) {
+        memcpy(columns[c], p, header.count * sizeof(StrRef));
+        p += header.count * sizeof(StrRef);
+    }
+    for (size_t i = 0; i < header.count; i++, p += sizeof(int64_t)) {
+        int64_t value;
+        memcpy(&value, p, sizeof(value));
+        table->loginTime[i] = (time_t)value;
+    }
+    for (size_t i = 0; i < header.count; i++, p += sizeof(int64_t)) {
+        int64_t value;
+        memcpy(&value, p, sizeof(value));
+        table->idleSeconds[i] = (long)value;
+    }
+    memset(table->messages, -1, rows * sizeof(signed char));
+    memset(table->uid, 0xff, rows * sizeof(uid_t)); //Nessun proprietario: nessun .plan mostrato
+    memcpy(table->strings.data, p, header.stringsLen);
+    table->strings.len = header.stringsLen;
+    table->strings.capacity = header.stringsLen;
+
+    //Ogni stringa deve stare dentro l'arena ed essere terminata
+    for (int c = 0; c < 7; c++) {
+        for (size_t i = 0; i < header.count; i++) {
+            StrRef ref = columns[c][i];
+            if (ref.len == 0) continue;
+            if ((uint64_t)ref.offset + ref.len >= header.stringsLen || table->strings.data[ref.offset + ref.len] != '\0') {
+                freeSessionTable(table);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Releases the memory held by the session table.
+ *
+ * @param table The session table to free.
+ */
+void freeSessionTable(SessionTable *table) {
+    free(table->strings.data);
+    free(table->strings.slots);
+    free(table->login);
+    free(table->name);
+    free(table->tty);
+    free(table->directory);
+    free(table->shell);
+    free(table->office);
+    free(table->phone);
+    free(table->uid);
+    free(table->loginTime);
+    free(table->idleSeconds);
+    free(table->what);
+    free(table->messages);
+    free(table->mail);
+    free(table->mailMessages);
+    free(table->plan);
+    memset(table, 0, sizeof(*table));
+}
@@ -0,0 +1,206 @@
+// sessiontable.h
+#ifndef SESSIONTABLE_H
+#define SESSIONTABLE_H
+
+#include <stddef.h> //Per size_t
+#include <stdint.h> //Per i tipi a larghezza fissa
+#include <time.h> //Per time_t
+#include <pwd.h> //Per la struttura passwd
+#include <utmpx.h> //Per la struttura utmpx
+#include "lib.h"
+
+/**
+ * Handle of a string stored in a StringArena. Stays valid when the arena grows.
+ */
+typedef struct {
+    uint32_t offset;  /**< Offset of the first byte in the arena */
+    uint32_t len;     /**< Length without the terminator (0 for the empty string) */
+} StrRef;
+
+/**
+ * Growable block of NUL-terminated strings, each stored once.
+ */
+typedef struct {
+    char *data;        /**< The strings, offset 0 is the empty string */
+    size_t len;        /**< Bytes used */
+    size_t capacity;   /**< Bytes allocated */
+    StrRef *slots;     /**< Open addressing table of the strings (len 0 for an empty slot) */
+    size_t slotCount;  /**< Size of the table (power of two) */
+    size_t count;      /**< Number of distinct strings */
+} StringArena;
+
+/**
+ * Fields of a session, in the order used by the tables and by --format.
+ */
+typedef enum {
+    SESSION_LOGIN,
+    SESSION_NAME,
+    SESSION_TTY,
+    SESSION_IDLE,
+    SESSION_DIRECTORY,
+    SESSION_SHELL,
+    SESSION_WEEKDAY,
+    SESSION_HOURS_MINUTES,
+    SESSION_OFFICE,
+    SESSION_PHONE,
+    SESSION_FIELD_COUNT
+} SessionField;
+
+/**
+ * Strings of a passwd entry already stored, reused by its other sessions.
+ */
+typedef struct {
+    const struct passwd *pwd;  /**< Entry the handles belong to, NULL for an empty slot */
+    StrRef login, name, directory, shell, office, phone;
+} PasswdRefs;
+
+/**
+ * Number of passwd entries remembered while appending sessions (power of two).
+ */
+#define SESSION_MEMO_SLOTS 64
+
+/**
+ * Sessions of a query, one array per field. Text fields are handles into a
+ * single arena in which repeated strings (login, shell, directory, ...) are
+ * stored once; idle time, date and hour are formatted when a row is read.
+ */
+typedef struct {
+    StringArena strings;   /**< Text of every session */
+    size_t count;          /**< Number of sessions */
+    size_t capacity;       /**< Rows allocated in every array */
+    int withMailAndPlan;   /**< 1 if mail, mailMessages and plan are allocated */
+    int withGecos;         /**< 1 to parse name, office and phone from GECOS, 0 to leave them empty */
+    StrRef *login;         /**< Login name */
+    StrRef *name;          /**< Full name from GECOS */
+    StrRef *tty;           /**< Terminal */
+    StrRef *directory;     /**< Home directory */
+    StrRef *shell;         /**< Shell */
+    StrRef *office;        /**< Office location from GECOS */
+    StrRef *phone;         /**< Office phone from GECOS */
+    uid_t *uid;            /**< User id, owner of the `.plan` shown; -1 if unknown */
+    time_t *loginTime;     /**< Login time */
+    long *idleSeconds;     /**< Idle time in seconds, -1 if unknown */
+    StrRef *what;          /**< Command in the foreground of the terminal, empty if not probed */
+    signed char *messages; /**< 1 if the terminal accepts messages (mesg y), 0 if not, -1 if unknown */
+    FileProbe *mail;       /**< Probe of the mailbox (withMailAndPlan only) */
+    long *mailMessages;    /**< Messages in the mailbox, -1 if unknown (withMailAndPlan only) */
+    FileProbe *plan;       /**< Probe of the `.plan` file (withMailAndPlan only) */
+    PasswdRefs memo[SESSION_MEMO_SLOTS]; /**< Handles of the passwd entries seen last */
+} SessionTable;
+
+/**
+ * A session read from the table: every field as a NUL-terminated string.
+ */
+typedef struct {
+    const char *text[SESSION_FIELD_COUNT]; /**< Value of each field */
+    size_t len[SESSION_FIELD_COUNT];       /**< Length of each value */
+    char idle[32];                         /**< Storage of the idle time */
+    char weekDay[16];                      /**< Storage of the login date */
+    char hoursMinutes[8];                  /**< Storage of the login hour */
+} SessionRow;
+
+/**
+ * Header of the image of a session table written by writeSessionTableImage().
+ * It is followed by the seven StrRef columns (login, name, tty, directory,
+ * shell, office, phone), the loginTime and idleSeconds columns as int64_t
+ * and the strings, so the image can be copied to and from shared memory.
+ */
+typedef struct {
+    uint64_t count;       /**< Number of sessions */
+    uint64_t stringsLen;  /**< Bytes of the strings */
+} SessionImageHeader;
+
+/**
+ * Initializes an empty session table. Nothing is allocated until the first
+ * session. GECOS is parsed unless withGecos is cleared before appending.
+ *
+ * @param table The SessionTable structure to initialize.
+ * @param withMailAndPlan 1 to keep mailbox and `.plan` probes for every session.
+ */
+void initSessionTable(SessionTable *table, int withMailAndPlan);
+
+/**
+ * Stores the strings of a passwd entry in the table without adding a
+ * session, e.g. for a user who is not logged in.
+ *
+ * @param table The session table.
+ * @param pwd The passwd entry.
+ * @param refs Receives the handles (pwd is left NULL).
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int internPasswd(SessionTable *table, const struct passwd *pwd, PasswdRefs *refs);
+
+/**
+ * Appends a session.
+ *
+ * @param table The session table.
+ * @param ut The utmpx record of the session.
+ * @param pwd The passwd entry of its user.
+ * @return The row of the session, or -1 if memory could not be allocated.
+ */
+long appendSession(SessionTable *table, const struct utmpx *ut, const struct passwd *pwd);
+
+/**
+ * Stores the command in the foreground of the terminal of a session.
+ *
+ * @param table The session table.
+ * @param row The row of the session.
+ * @param command The command line.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int setSessionCommand(SessionTable *table, size_t row, const char *command);
+
+/**
+ * Returns the string of a handle.
+ *
+ * @param table The session table.
+ * @param ref The handle.
+ * @return The NUL-terminated string, valid until the table grows or is freed.
+ */
+const char *sessionString(const SessionTable *table, StrRef ref);
+
+/**
+ * Reads every field of a session as a string.
+ *
+ * @param table The session table.
+ * @param row The row of the session.
+ * @param out The SessionRow structure to populate.
+ */
+void getSessionRow(const SessionTable *table, size_t row, SessionRow *out);
+
+/**
+ * Returns the size of the image of a table.
+ *
+ * @param table The session table.
+ * @return The size in bytes.
+ */
+size_t sessionTableImageSize(const SessionTable *table);
+
+/**
+ * Writes the image of a table: sessions, strings, login and idle times
+ * (mail and `.plan` probes, user ids, commands and mesg status are not included).
+ *
+ * @param table The session table.
+ * @param image The destination, of sessionTableImageSize() bytes.
+ */
+void writeSessionTableImage(const SessionTable *table, void *image);
+
+/**
+ * Fills an empty table from an image. Every handle is checked against the
+ * strings, so an image that is damaged or being rewritten is rejected.
+ *
+ * @param table The SessionTable structure to populate.
+ * @param image The image.
+ * @param size The number of readable bytes at image.
+ * @return 0 on success, -1 if the image is invalid or memory could not be allocated.
+ */
+int readSessionTableImage(SessionTable *table, const void *image, size_t size);
+
+/**
+ * Releases the memory held by the session table.
+ *
+ * @param table The session table to free.
+ */
+void freeSessionTable(SessionTable *table);
+
+#endif
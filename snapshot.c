@@ -0,0 +1,377 @@
+#define _GNU_SOURCE //Per UTMPX_FILE
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <unistd.h> //Per read() e close()
+#include <fcntl.h> //Per open()
+#include <libgen.h> //Per dirname() e basename()
+#include <limits.h> //Per NAME_MAX
+#include <sys/inotify.h> //Per la notifica delle modifiche ai file
+#include <sys/stat.h> //Per fstat()
+#include "snapshot.h"
+
+/**
+ * Computes a 64-bit FNV-1a hash.
+ *
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @return The hash value.
+ */
+static uint64_t hashBytes(const char *data, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Reads a whole file into memory.
+ *
+ * @param path The path of the file.
+ * @param size Receives the size of the file.
+ * @return The contents (NUL terminated), or NULL on error.
+ */
+static char *readWholeFile(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = malloc(st.st_size + 1);
+    size_t got = 0;
+    while (data != NULL && got < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + got, st.st_size - got);
+        if (n <= 0) break; //Il file si è accorciato durante la lettura
+        got += n;
+    }
+    close(fd);
+    if (data != NULL) data[got] = '\0';
+    *size = got;
+    return data;
+}
+
+/**
+ * Finds the slot of a login in a table of passwd line hashes.
+ *
+ * @param lines The table.
+ * @param slots The size of the table (power of two).
+ * @param login The login, not necessarily NUL terminated.
+ * @param len The length of the login.
+ * @return The slot holding the login, or the empty slot where it would go.
+ */
+static size_t findLine(const PasswdLine *lines, size_t slots, const char *login, size_t len) {
+    size_t slot = hashBytes(login, len) & (slots - 1);
+    while (lines[slot].login != NULL &&
+           (strncmp(lines[slot].login, login, len) != 0 || lines[slot].login[len] != '\0')) {
+        slot = (slot + 1) & (slots - 1);
+    }
+    return slot;
+}
+
+/**
+ * Splits a passwd line into a passwd structure. The line is modified in place.
+ *
+ * @param line The line, without the newline.
+ * @param pwd The passwd structure to fill.
+ * @return 0 on success, -1 if the line is malformed.
+ */
+static int parsePasswdLine(char *line, struct passwd *pwd) {
+    char *fields[7];
+    for (int i = 0; i < 7; i++) {
+        fields[i] = line;
+        line = strchr(line, ':');
+        if (line == NULL && i < 6) return -1;
+        if (line != NULL) *line++ = '\0';
+    }
+    pwd->pw_name = fields[0];
+    pwd->pw_passwd = fields[1];
+    pwd->pw_uid = strtoul(fields[2], NULL, 10);
+    pwd->pw_gid = strtoul(fields[3], NULL, 10);
+    pwd->pw_gecos = fields[4];
+    pwd->pw_dir = fields[5];
+    pwd->pw_shell = fields[6];
+    return 0;
+}
+
+/**
+ * Reads the passwd file and applies the lines whose hash changed to the cache.
+ * On the first call (empty table) only the hashes are recorded.
+ *
+ * @param snapshot The live snapshot.
+ * @return The number of logins added, modified or removed.
+ */
+static unsigned long applyPasswdDelta(LiveSnapshot *snapshot) {
+    size_t size;
+    char *data = readWholeFile(SNAPSHOT_PASSWD_FILE, &size);
+    if (data == NULL) return 0;
+
+    size_t lineCount = 1;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n') lineCount++;
+    }
+    size_t slots = 64;
+    while (slots < lineCount * 2) slots *= 2;
+    PasswdLine *lines = calloc(slots, sizeof(PasswdLine));
+    if (lines == NULL) {
+        free(data);
+        return 0;
+    }
+
+    int first = snapshot->lines == NULL;
+    unsigned long changed = 0;
+    char *line = data;
+    while (line < data + size) {
+        char *end = strchr(line, '\n');
+        if (end == NULL) end = data + size;
+        *end = '\0';
+
+        char *colon = strchr(line, ':');
+        if (colon != NULL && line[0] != '#' && line[0] != '+' && line[0] != '-') {
+            size_t loginLen = colon - line;
+            uint64_t hash = hashBytes(line, end - line);
+            size_t slot = findLine(lines, slots, line, loginLen);
+            if (lines[slot].login == NULL) {
+                lines[slot].login = strndup(line, loginLen);
+                lines[slot].hash = hash;
+
+                //Solo le righe nuove o modificate vengono interpretate
+                size_t old = first ? 0 : findLine(snapshot->lines, snapshot->lineSlots, line, loginLen);
+                if (!first && (snapshot->lines[old].login == NULL || snapshot->lines[old].hash != hash)) {
+                    struct passwd pwd;
+                    if (lines[slot].login != NULL && parsePasswdLine(line, &pwd) == 0) {
+                        storePasswd(&snapshot->cache, lines[slot].login, &pwd);
+                        changed++;
+                    }
+                }
+            }
+        }
+        line = end + 1;
+    }
+
+    //Gli utenti spariti dal file diventano voci negative della cache
+    for (size_t i = 0; !first && i < snapshot->lineSlots; i++) {
+        const char *login = snapshot->lines[i].login;
+        if (login != NULL && lines[findLine(lines, slots, login, strlen(login))].login == NULL) {
+            storePasswd(&snapshot->cache, login, NULL);
+            changed++;
+        }
+    }
+
+    for (size_t i = 0; i < snapshot->lineSlots; i++) free(snapshot->lines[i].login);
+    free(snapshot->lines);
+    snapshot->lines = lines;
+    snapshot->lineSlots = slots;
+    free(data);
+    return changed;
+}
+
+/**
+ * Reads the utmpx file and compares it slot by slot with the copy in memory.
+ * The session index is rebuilt from memory only if a USER_PROCESS slot changed.
+ *
+ * @param snapshot The live snapshot.
+ * @return The number of sessions added or removed.
+ */
+static unsigned long applyUtmpDelta(LiveSnapshot *snapshot) {
+    size_t size;
+    struct utmpx *records = (struct utmpx *)readWholeFile(UTMPX_FILE, &size);
+    if (records == NULL) return 0;
+
+    size_t count = size / sizeof(struct utmpx);
+    size_t common = count < snapshot->recordCount ? count : snapshot->recordCount;
+    unsigned long added = 0, removed = 0;
+
+    //Confronto degli slot presenti in entrambe le copie
+    for (size_t i = 0; i < common; i++) {
+        if (memcmp(&records[i], &snapshot->records[i], sizeof(struct utmpx)) == 0) continue;
+        if (snapshot->records[i].ut_type == USER_PROCESS) removed++;
+        if (records[i].ut_type == USER_PROCESS) added++;
+    }
+    //Slot aggiunti in coda o troncati
+    for (size_t i = common; i < count; i++) {
+        if (records[i].ut_type == USER_PROCESS) added++;
+    }
+    for (size_t i = common; i < snapshot->recordCount; i++) {
+        if (snapshot->records[i].ut_type == USER_PROCESS) removed++;
+    }
+
+    free(snapshot->records);
+    snapshot->records = records;
+    snapshot->recordCount = count;
+
+    if (added + removed > 0) {
+        SessionIndex index;
+        if (buildSessionIndex(&index, records, count) == 0) {
+            freeSessionIndex(&snapshot->index);
+            snapshot->index = index;
+        }
+    }
+    snapshot->last.sessionsAdded += added;
+    snapshot->last.sessionsRemoved += removed;
+    return added + removed;
+}
+
+/**
+ * Probes one mailbox again after inotify reported a change.
+ *
+ * @param snapshot The live snapshot.
+ * @param name The name of the mailbox.
+ */
+static void applyMailboxChange(LiveSnapshot *snapshot, const char *name) {
+    char path[512];
+    FileProbe probe;
+
+    if (name[0] == '.') return; //File di lock e file nascosti
+    snprintf(path, sizeof(path), MAIL_SPOOL_DIR "/%s", name);
+    probeFile(path, &probe);
+    //Una casella eliminata resta nella tabella con found = 0
+    if (probe.found || findMailbox(&snapshot->mailboxes, name) != NULL) {
+        setMailbox(&snapshot->mailboxes, name, &probe);
+        snapshot->last.mailboxesChanged++;
+    }
+}
+
+/**
+ * Adds an inotify watch on the directory containing a file.
+ *
+ * @param fd The inotify descriptor.
+ * @param file The path of the file.
+ * @param mask The events to watch.
+ * @return The watch descriptor, or -1 on error.
+ */
+static int watchDirectoryOf(int fd, const char *file, uint32_t mask) {
+    char copy[PATH_MAX];
+    snprintf(copy, sizeof(copy), "%s", file);
+    return inotify_add_watch(fd, dirname(copy), mask);
+}
+
+/**
+ * Returns the last component of a path.
+ *
+ * @param path The path.
+ * @return A pointer into path.
+ */
+static const char *lastComponent(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+/**
+ * Loads utmpx, passwd and the mail spool and starts watching them.
+ *
+ * @param snapshot The LiveSnapshot structure to populate.
+ * @return 0 on success, -1 on error.
+ */
+int openLiveSnapshot(LiveSnapshot *snapshot) {
+    const uint32_t fileEvents = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (snapshot->fd < 0) return -1;
+
+    //Le directory, non i file, così anche una sostituzione con rename() viene notata;
+    //i watch sono attivi prima della lettura iniziale per non perdere modifiche
+    snapshot->utmpWatch = watchDirectoryOf(snapshot->fd, UTMPX_FILE, fileEvents);
+    snapshot->passwdWatch = watchDirectoryOf(snapshot->fd, SNAPSHOT_PASSWD_FILE, fileEvents);
+    snapshot->mailWatch = inotify_add_watch(snapshot->fd, MAIL_SPOOL_DIR, fileEvents | IN_ATTRIB | IN_ACCESS);
+
+    if (initPasswdCache(&snapshot->cache) != 0 || initMailboxTable(&snapshot->mailboxes) != 0 ||
+        initMailCountCache(&snapshot->mailCounts) != 0 || buildSessionIndex(&snapshot->index, NULL, 0) != 0) {
+        closeLiveSnapshot(snapshot);
+        return -1;
+    }
+    applyUtmpDelta(snapshot);
+    applyPasswdDelta(snapshot);
+    scanMailSpool(&snapshot->mailboxes, MAIL_SPOOL_DIR);
+    preloadPasswdCacheFor(&snapshot->cache, snapshot->index.count);
+    memset(&snapshot->last, 0, sizeof(snapshot->last));
+    return 0;
+}
+
+/**
+ * Applies the changes reported by inotify since the last call.
+ *
+ * @param snapshot The live snapshot.
+ * @return The number of changes applied (0 if the state is unchanged).
+ */
+unsigned long updateLiveSnapshot(LiveSnapshot *snapshot) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *utmpName = lastComponent(UTMPX_FILE);
+    const char *passwdName = lastComponent(SNAPSHOT_PASSWD_FILE);
+    int utmpDirty = 0, passwdDirty = 0, overflow = 0;
+    ssize_t len;
+
+    memset(&snapshot->last, 0, sizeof(snapshot->last));
+
+    //Raccoglie tutti gli eventi in attesa; posta aggiornata subito, utmpx e passwd una volta sola
+    while ((len = read(snapshot->fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) overflow = 1;
+            if (event->len == 0) continue;
+            if (event->wd == snapshot->utmpWatch && strcmp(event->name, utmpName) == 0) utmpDirty = 1;
+            if (event->wd == snapshot->passwdWatch && strcmp(event->name, passwdName) == 0) passwdDirty = 1;
+            if (event->wd == snapshot->mailWatch) applyMailboxChange(snapshot, event->name);
+        }
+    }
+
+    //Coda di inotify traboccata: eventi persi, si confrontano comunque solo le differenze
+    if (overflow) {
+        utmpDirty = passwdDirty = 1;
+        scanMailSpool(&snapshot->mailboxes, MAIL_SPOOL_DIR);
+        snapshot->last.mailboxesChanged++;
+    }
+    if (utmpDirty) applyUtmpDelta(snapshot);
+    if (passwdDirty) snapshot->last.passwdChanged = applyPasswdDelta(snapshot);
+
+    unsigned long changes = snapshot->last.sessionsAdded + snapshot->last.sessionsRemoved +
+                            snapshot->last.passwdChanged + snapshot->last.mailboxesChanged;
+    if (changes > 0) snapshot->generation++;
+    return changes;
+}
+
+/**
+ * Fills a FingerContext that renders from the snapshot.
+ *
+ * @param snapshot The live snapshot.
+ * @param ctx The FingerContext to fill.
+ */
+void snapshotContext(LiveSnapshot *snapshot, FingerContext *ctx) {
+    ctx->index = &snapshot->index;
+    ctx->cache = &snapshot->cache;
+    ctx->mailboxes = snapshot->mailWatch >= 0 ? &snapshot->mailboxes : NULL;
+    ctx->format = EXPORT_TEXT;
+    ctx->devDir = NULL;
+    ctx->mailDir = NULL;
+    ctx->planLimits = NULL;
+    ctx->mailCounts = &snapshot->mailCounts;
+    ctx->list = NULL;
+    ctx->lastLogins = NULL;
+    ctx->processes = NULL;
+    ctx->columns = NULL;
+}
+
+/**
+ * Stops watching and releases the memory held by the snapshot.
+ *
+ * @param snapshot The live snapshot to close.
+ */
+void closeLiveSnapshot(LiveSnapshot *snapshot) {
+    if (snapshot->fd >= 0) close(snapshot->fd); //Chiudere il descrittore rimuove tutti i watch
+    for (size_t i = 0; i < snapshot->lineSlots; i++) free(snapshot->lines[i].login);
+    free(snapshot->lines);
+    free(snapshot->records);
+    freeSessionIndex(&snapshot->index);
+    if (snapshot->cache.entries != NULL) freePasswdCache(&snapshot->cache);
+    if (snapshot->mailboxes.entries != NULL) freeMailboxTable(&snapshot->mailboxes);
+    if (snapshot->mailCounts.entries != NULL) freeMailCountCache(&snapshot->mailCounts);
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->fd = -1;
+}
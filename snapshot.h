@@ -0,0 +1,89 @@
+// snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h> //Per size_t
+#include <stdint.h> //Per uint64_t
+#include <utmpx.h> //Per la struttura utmpx
+#include "session.h"
+#include "pwcache.h"
+#include "mail.h"
+#include "finger.h"
+
+/**
+ * File with the local user database watched by the snapshot.
+ */
+#define SNAPSHOT_PASSWD_FILE "/etc/passwd"
+
+/**
+ * Changes applied by the last call to updateLiveSnapshot().
+ */
+typedef struct {
+    unsigned long sessionsAdded;    /**< utmpx slots that became USER_PROCESS */
+    unsigned long sessionsRemoved;  /**< USER_PROCESS slots that ended */
+    unsigned long passwdChanged;    /**< Logins added, modified or removed in passwd */
+    unsigned long mailboxesChanged; /**< Mailboxes probed again */
+} SnapshotDelta;
+
+/**
+ * Hash of one line of the passwd file, used to find the entries that changed.
+ */
+typedef struct {
+    char *login;    /**< Login of the line (NULL for an empty slot) */
+    uint64_t hash;  /**< Hash of the whole line */
+} PasswdLine;
+
+/**
+ * State of utmpx, passwd and the mail spool kept current with inotify.
+ */
+typedef struct {
+    int fd;                    /**< inotify descriptor, can be polled for readability */
+    int utmpWatch;             /**< Watch on the directory of the utmpx file */
+    int passwdWatch;           /**< Watch on the directory of the passwd file */
+    int mailWatch;             /**< Watch on the mail spool directory */
+    struct utmpx *records;     /**< Copy of every slot of the utmpx file */
+    size_t recordCount;        /**< Number of slots in records */
+    SessionIndex index;        /**< Sessions derived from records */
+    PasswdCache cache;         /**< passwd entries, updated when the file changes */
+    PasswdLine *lines;         /**< Hashes of the passwd lines, keyed by login */
+    size_t lineSlots;          /**< Size of lines (power of two) */
+    MailboxTable mailboxes;    /**< State of every mailbox in the spool */
+    MailCountCache mailCounts; /**< Message counts of the mailboxes, kept in memory */
+    unsigned long generation;  /**< Incremented each time a change is applied */
+    SnapshotDelta last;        /**< Changes applied by the last update */
+} LiveSnapshot;
+
+/**
+ * Loads utmpx, passwd and the mail spool and starts watching them.
+ *
+ * @param snapshot The LiveSnapshot structure to populate.
+ * @return 0 on success, -1 on error.
+ */
+int openLiveSnapshot(LiveSnapshot *snapshot);
+
+/**
+ * Applies the changes reported by inotify since the last call. Only the
+ * utmpx slots, passwd lines and mailboxes that changed are processed.
+ * Does not block if there are no pending events.
+ *
+ * @param snapshot The live snapshot.
+ * @return The number of changes applied (0 if the state is unchanged).
+ */
+unsigned long updateLiveSnapshot(LiveSnapshot *snapshot);
+
+/**
+ * Fills a FingerContext that renders from the snapshot.
+ *
+ * @param snapshot The live snapshot.
+ * @param ctx The FingerContext to fill.
+ */
+void snapshotContext(LiveSnapshot *snapshot, FingerContext *ctx);
+
+/**
+ * Stops watching and releases the memory held by the snapshot.
+ *
+ * @param snapshot The live snapshot to close.
+ */
+void closeLiveSnapshot(LiveSnapshot *snapshot);
+
+#endif
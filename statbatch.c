@@ -0,0 +1,366 @@
+#define _GNU_SOURCE //Per statx()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <unistd.h> //Per syscall() e close()
+#include <fcntl.h> //Per AT_FDCWD
+#include <errno.h> //Per i codici di errore
+#include <pthread.h> //Per il pool di thread di riserva
+#include <sys/mman.h> //Per mappare gli anelli di io_uring
+#include <sys/stat.h> //Per statx()
+#include <sys/sysmacros.h> //Per makedev()
+#include <sys/syscall.h> //Per i numeri delle chiamate di sistema io_uring
+#include <linux/io_uring.h> //Per le strutture di io_uring
+#include "statbatch.h"
+#include "stats.h"
+
+/**
+ * Converts the result of statx() into a FileProbe.
+ *
+ * @param stx The statx result.
+ * @param probe The FileProbe structure to populate.
+ */
+static void probeFromStatx(const struct statx *stx, FileProbe *probe) {
+    probe->found = 1;
+    probe->atime = stx->stx_atime.tv_sec;
+    probe->mtime = stx->stx_mtime.tv_sec;
+    probe->mode = stx->stx_mode;
+    probe->size = stx->stx_size;
+    probe->inode = stx->stx_ino;
+    probe->rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+}
+
+/**
+ * Mapped io_uring instance.
+ */
+typedef struct {
+    int fd;                    /**< Ring file descriptor */
+    void *sqRing;              /**< Mapped submission ring */
+    void *cqRing;              /**< Mapped completion ring (may equal sqRing) */
+    size_t sqRingSize;         /**< Size of the submission ring mapping */
+    size_t cqRingSize;         /**< Size of the completion ring mapping */
+    struct io_uring_sqe *sqes; /**< Submission queue entries */
+    size_t sqesSize;           /**< Size of the sqes mapping */
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+    unsigned entries;          /**< Number of submission entries */
+} Ring;
+
+/**
+ * Releases the mappings and the descriptor of a ring.
+ *
+ * @param ring The ring to close.
+ */
+static void closeRing(Ring *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing && ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing) munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing && ring->sqRing != MAP_FAILED) munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0) close(ring->fd);
+}
+
+/**
+ * Creates and maps an io_uring instance.
+ *
+ * @param ring The Ring structure to populate.
+ * @param entries The requested number of submission entries.
+ * @return 0 on success, -1 if io_uring is not available.
+ */
+static int openRing(Ring *ring, unsigned entries) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    STAT_ADD(STAT_SYS_URING, 1);
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) return -1;
+
+    ring->entries = params.sq_entries;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cqRingSize > ring->sqRingSize) ring->sqRingSize = ring->cqRingSize;
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        closeRing(ring);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cqRing = ring->sqRing;
+    } else {
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            closeRing(ring);
+            return -1;
+        }
+    }
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        closeRing(ring);
+        return -1;
+    }
+
+    char *sq = ring->sqRing;
+    char *cq = ring->cqRing;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+/**
+ * Waits for completions, submitting the entries queued up to tail that the
+ * kernel has not consumed yet. A signal (SIGWINCH in -w, SIGTERM in --serve)
+ * does not interrupt the wait.
+ *
+ * @param ring The ring.
+ * @param tail The tail of the submission queue.
+ * @return 0 on success, -1 if io_uring_enter() fails.
+ */
+static int enterRing(Ring *ring, unsigned tail) {
+    long ret;
+    do {
+        unsigned pending = tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+        STAT_ADD(STAT_SYS_URING, 1);
+        ret = syscall(__NR_io_uring_enter, ring->fd, pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? -1 : 0;
+}
+
+/**
+ * Probes the batch through io_uring. Every ring slot owns a statx buffer;
+ * a slot is refilled with the next request as soon as its completion arrives.
+ * After an error no new request is queued, but the buffers are released only
+ * once every request handed to the kernel has completed.
+ *
+ * @param batch The batch to run.
+ * @param completed Set to 1 for every request answered through the ring.
+ * @return 0 if every request was answered, -1 if some are left to the thread pool.
+ */
+static int runWithRing(StatBatch *batch, unsigned char *completed) {
+    Ring ring;
+    //Anello non più grande del batch: la preparazione costa in proporzione alle voci
+    if (openRing(&ring, batch->count < STAT_BATCH_RING_SIZE ? batch->count : STAT_BATCH_RING_SIZE) != 0) return -1;
+
+    unsigned slots = ring.entries;
+    struct statx *buffers = malloc(slots * sizeof(struct statx));
+    size_t *owner = malloc(slots * sizeof(size_t)); //Richiesta servita da ogni slot
+    unsigned *freeSlots = malloc(slots * sizeof(unsigned));
+    if (buffers == NULL || owner == NULL || freeSlots == NULL) {
+        free(buffers);
+        free(owner);
+        free(freeSlots);
+        closeRing(&ring);
+        return -1;
+    }
+
+    unsigned freeCount = slots;
+    for (unsigned i = 0; i < slots; i++) freeSlots[i] = i;
+
+    unsigned startHead = *ring.sqHead;
+    unsigned reaped = 0, inFlight = 0; //Voci consegnate al kernel e non ancora completate
+    size_t next = 0, answered = 0;
+    int failed = 0, lost = 0;
+    while (inFlight > 0 || (!failed && next < batch->count)) {
+        //Riempie gli slot liberi con le richieste successive
+        unsigned tail = *ring.sqTail;
+        unsigned queued = 0;
+        while (!failed && freeCount > 0 && next < batch->count) {
+            unsigned slot = freeSlots[--freeCount];
+            struct io_uring_sqe *sqe = &ring.sqes[tail & *ring.sqMask];
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (unsigned long)batch->requests[next].path;
+            sqe->len = STATX_BASIC_STATS;
+            sqe->off = (unsigned long)&buffers[slot];
+            sqe->user_data = slot;
+            ring.sqArray[tail & *ring.sqMask] = tail & *ring.sqMask;
+            owner[slot] = next++;
+            tail++;
+            queued++;
+        }
+        __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+        STAT_ADD(STAT_SYS_STATX, queued);
+
+        //Invia le nuove richieste e attende almeno un completamento
+        if (enterRing(&ring, tail) != 0) {
+            if (failed) {
+                //Le richieste in volo non si possono più attendere: i buffer restano allocati
+                lost = 1;
+                break;
+            }
+            //Le voci non consegnate sono ritirate dalla coda; per quelle in volo si attende il completamento
+            failed = 1;
+            unsigned head = __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+            for (unsigned t = head; t != tail; t++) freeSlots[freeCount++] = (unsigned)ring.sqes[t & *ring.sqMask].user_data;
+            __atomic_store_n(ring.sqTail, head, __ATOMIC_RELEASE);
+        }
+
+        //Raccoglie i completamenti disponibili
+        unsigned head = *ring.cqHead;
+        while (head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+            unsigned slot = (unsigned)cqe->user_data;
+            size_t request = owner[slot];
+
+            if (cqe->res == -EINVAL) {
+                //Kernel senza IORING_OP_STATX: questa e le successive vanno al pool di thread
+                failed = 1;
+            } else {
+                FileProbe *probe = batch->requests[request].result;
+                memset(probe, 0, sizeof(*probe));
+                if (cqe->res == 0) probeFromStatx(&buffers[slot], probe);
+                completed[request] = 1;
+                answered++;
+            }
+            freeSlots[freeCount++] = slot;
+            reaped++;
+            head++;
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        inFlight = __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) - startHead - reaped;
+    }
+
+    //Nessuna richiesta in volo (salvo lost): l'anello e i buffer si possono rilasciare
+    closeRing(&ring);
+    if (!lost) free(buffers);
+    free(owner);
+    free(freeSlots);
+    return answered == batch->count ? 0 : -1;
+}
+
+/**
+ * Shared state of the fallback thread pool.
+ */
+typedef struct {
+    StatRequest *requests;  /**< Requests being probed */
+    size_t count;           /**< Number of requests */
+    size_t next;            /**< Next request to take (updated atomically) */
+} PoolState;
+
+/**
+ * Worker of the fallback thread pool: takes requests until the batch is exhausted.
+ *
+ * @param arg The shared PoolState.
+ * @return Always NULL.
+ */
+static void *statWorker(void *arg) {
+    PoolState *state = arg;
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&state->next, 1, __ATOMIC_RELAXED)) < state->count) {
+        StatRequest *request = &state->requests[i];
+        probeFile(request->path, request->result);
+    }
+    return NULL;
+}
+
+/**
+ * Probes requests with a small pool of threads doing blocking stat() calls.
+ *
+ * @param requests The requests to probe.
+ * @param count The number of requests.
+ */
+static void runWithThreads(StatRequest *requests, size_t count) {
+    PoolState state = {requests, count, 0};
+    pthread_t threads[STAT_BATCH_MAX_THREADS];
+    size_t wanted = count < STAT_BATCH_MAX_THREADS ? count : STAT_BATCH_MAX_THREADS;
+    size_t started = 0;
+
+    //Il thread chiamante partecipa al lavoro: ne servono wanted - 1 in più
+    while (started + 1 < wanted && pthread_create(&threads[started], NULL, statWorker, &state) == 0) {
+        started++;
+    }
+    statWorker(&state);
+    for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+}
+
+/**
+ * Initializes an empty batch.
+ *
+ * @param batch The StatBatch structure to initialize.
+ */
+void initStatBatch(StatBatch *batch) {
+    memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * Adds a path to the batch. The result is written when runStatBatch() is called.
+ *
+ * @param batch The batch.
+ * @param path The path to probe (copied).
+ * @param result Where to store the result of the probe.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int addStatRequest(StatBatch *batch, const char *path, FileProbe *result) {
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 64;
+        StatRequest *grown = realloc(batch->requests, capacity * sizeof(StatRequest));
+        if (grown == NULL) return -1;
+        batch->requests = grown;
+        batch->capacity = capacity;
+    }
+
+    char *copy = strdup(path);
+    if (copy == NULL) return -1;
+    batch->requests[batch->count].path = copy;
+    batch->requests[batch->count].result = result;
+    batch->count++;
+    return 0;
+}
+
+/**
+ * Probes every path of the batch, submitting them together as statx requests
+ * through io_uring, or through a small thread pool if io_uring is unavailable.
+ * Batches smaller than STAT_BATCH_MIN_RING are probed directly.
+ *
+ * @param batch The batch to run.
+ */
+void runStatBatch(StatBatch *batch) {
+    //Poche richieste (es. terminale, posta e .plan di un utente) non giustificano né l'anello né i thread
+    if (batch->count < STAT_BATCH_MIN_RING) {
+        for (size_t i = 0; i < batch->count; i++) probeFile(batch->requests[i].path, batch->requests[i].result);
+        return;
+    }
+    unsigned char *completed = calloc(batch->count, 1);
+    if (completed == NULL) {
+        runWithThreads(batch->requests, batch->count);
+        return;
+    }
+    if (runWithRing(batch, completed) != 0) {
+        //Al pool di thread vanno solo le richieste rimaste senza risposta (tutte, se manca la memoria per separarle)
+        StatRequest *left = malloc(batch->count * sizeof(StatRequest));
+        size_t count = 0;
+        for (size_t i = 0; left != NULL && i < batch->count; i++) {
+            if (!completed[i]) left[count++] = batch->requests[i];
+        }
+        if (left != NULL) runWithThreads(left, count);
+        else runWithThreads(batch->requests, batch->count);
+        free(left);
+    }
+    free(completed);
+}
+
+/**
+ * Releases the memory held by the batch.
+ *
+ * @param batch The batch to free.
+ */
+void freeStatBatch(StatBatch *batch) {
+    for (size_t i = 0; i < batch->count; i++) free(batch->requests[i].path);
+    free(batch->requests);
+    memset(batch, 0, sizeof(*batch));
+}
@@ -0,0 +1,74 @@
+// statbatch.h
+#ifndef STATBATCH_H
+#define STATBATCH_H
+
+#include <stddef.h> //Per size_t
+#include "lib.h"
+
+/**
+ * Maximum number of statx requests in flight on the io_uring ring.
+ */
+#define STAT_BATCH_RING_SIZE 256
+
+/**
+ * Smallest batch submitted through io_uring: below it, setting up a ring costs
+ * more than probing the paths one after the other.
+ */
+#define STAT_BATCH_MIN_RING 8
+
+/**
+ * Maximum number of threads used when io_uring is not available.
+ */
+#define STAT_BATCH_MAX_THREADS 8
+
+/**
+ * A file to probe during the batched stat stage.
+ */
+typedef struct {
+    char *path;         /**< Path to probe (owned by the StatBatch) */
+    FileProbe *result;  /**< Where the result of the probe is stored */
+} StatRequest;
+
+/**
+ * The set of paths a run needs to probe before rendering.
+ */
+typedef struct {
+    StatRequest *requests; /**< Requests in insertion order */
+    size_t count;          /**< Number of requests */
+    size_t capacity;       /**< Allocated size of requests */
+} StatBatch;
+
+/**
+ * Initializes an empty batch.
+ *
+ * @param batch The StatBatch structure to initialize.
+ */
+void initStatBatch(StatBatch *batch);
+
+/**
+ * Adds a path to the batch. The result is written when runStatBatch() is called.
+ *
+ * @param batch The batch.
+ * @param path The path to probe (copied).
+ * @param result Where to store the result of the probe.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int addStatRequest(StatBatch *batch, const char *path, FileProbe *result);
+
+/**
+ * Probes every path of the batch, submitting them together as statx requests
+ * through io_uring, or through a small thread pool if io_uring is unavailable.
+ * Batches smaller than STAT_BATCH_MIN_RING are probed directly.
+ *
+ * @param batch The batch to run.
+ */
+void runStatBatch(StatBatch *batch);
+
+/**
+ * Releases the memory held by the batch.
+ *
+ * @param batch The batch to free.
+ */
+void freeStatBatch(StatBatch *batch);
+
+#endif
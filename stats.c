@@ -0,0 +1,98 @@
+#include <stdio.h> //Operazioni di input/output
+#include <time.h> //Per clock_gettime()
+#include "stats.h"
+
+static const char *const phaseNames[STAT_PHASE_COUNT] = {
+    "utmp", "passwd", "time", "probe", "mail", "plan", "wtmp", "proc", "output",
+};
+
+static const char *const counterNames[STAT_COUNTER_COUNT] = {
+    "utmp_records", "sessions", "passwd_lookups", "passwd_hits", "passwd_nss", "passwd_enum", "passwd_index",
+    "time_formats",
+    "tty_probes", "mail_probes", "plan_probes", "mail_scans", "wtmp_records", "proc_reads",
+    "sys_stat", "sys_statx", "sys_uring", "sys_open", "sys_read", "sys_write",
+};
+
+#ifndef MYFINGER_RELEASE
+
+int statsActive = 0;
+uint64_t statPhaseNs[STAT_PHASE_COUNT];
+unsigned long statCounters[STAT_COUNTER_COUNT];
+static uint64_t statStartNs;
+
+/**
+ * Returns the monotonic clock in nanoseconds.
+ *
+ * @return The time in nanoseconds.
+ */
+uint64_t statNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/**
+ * Turns the instrumentation on and starts the total time.
+ *
+ * @return 0 on success, -1 if the program was built without instrumentation.
+ */
+int enableStats(void) {
+    statsActive = 1;
+    statStartNs = statNow();
+    return 0;
+}
+
+/**
+ * Prints the phase timings and the counters.
+ *
+ * @param out The stream that receives the report.
+ * @param json 1 for a single JSON line, 0 for a table.
+ */
+void reportStats(FILE *out, int json) {
+    uint64_t total = statNow() - statStartNs;
+    unsigned long syscalls = 0;
+    for (int c = STAT_SYS_STAT; c <= STAT_SYS_WRITE; c++) {
+        if (c != STAT_SYS_STATX) syscalls += statCounters[c]; //Le statx viaggiano dentro io_uring_enter
+    }
+
+    if (json) {
+        fprintf(out, "{\"total_us\":%.1f", total / 1e3);
+        for (int p = 0; p < STAT_PHASE_COUNT; p++) fprintf(out, ",\"%s_us\":%.1f", phaseNames[p], statPhaseNs[p] / 1e3);
+        for (int c = 0; c < STAT_COUNTER_COUNT; c++) fprintf(out, ",\"%s\":%lu", counterNames[c], statCounters[c]);
+        fprintf(out, ",\"syscalls\":%lu}\n", syscalls);
+        return;
+    }
+
+    fprintf(out, "%-16s %12s\n", "phase", "us");
+    for (int p = 0; p < STAT_PHASE_COUNT; p++) fprintf(out, "%-16s %12.1f\n", phaseNames[p], statPhaseNs[p] / 1e3);
+    fprintf(out, "%-16s %12.1f\n", "total", total / 1e3);
+    fprintf(out, "%-16s %12s\n", "counter", "count");
+    for (int c = 0; c < STAT_COUNTER_COUNT; c++) fprintf(out, "%-16s %12lu\n", counterNames[c], statCounters[c]);
+    fprintf(out, "%-16s %12lu\n", "syscalls", syscalls);
+}
+
+#else
+
+/**
+ * Turns the instrumentation on and starts the total time.
+ *
+ * @return 0 on success, -1 if the program was built without instrumentation.
+ */
+int enableStats(void) {
+    (void)phaseNames;
+    (void)counterNames;
+    return -1;
+}
+
+/**
+ * Prints the phase timings and the counters.
+ *
+ * @param out The stream that receives the report.
+ * @param json 1 for a single JSON line, 0 for a table.
+ */
+void reportStats(FILE *out, int json) {
+    (void)out;
+    (void)json;
+}
+
+#endif
@@ -0,0 +1,102 @@
+// stats.h
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h> //Per uint64_t
+#include <stdio.h> //Per il tipo FILE
+
+/*
+ * Lightweight instrumentation for --stats. The STAT_* macros cost a branch on
+ * a global flag when --stats is not given, and expand to nothing when the
+ * program is built with -DMYFINGER_RELEASE (see `make release`).
+ */
+
+/**
+ * Phases timed with the monotonic clock.
+ */
+typedef enum {
+    STAT_PHASE_UTMP,    /**< Reading utmpx and building the session index */
+    STAT_PHASE_PASSWD,  /**< getpwnam(), getpwent() and passwd files */
+    STAT_PHASE_TIME,    /**< Formatting of login times */
+    STAT_PHASE_PROBE,   /**< Batched stat of terminals, mailboxes and `.plan` files */
+    STAT_PHASE_MAIL,    /**< Mail status reports */
+    STAT_PHASE_PLAN,    /**< Reading `.plan` files */
+    STAT_PHASE_WTMP,    /**< Last logins from wtmp or its index */
+    STAT_PHASE_PROC,    /**< Walk of /proc for the foreground processes */
+    STAT_PHASE_OUTPUT,  /**< Writing the output */
+    STAT_PHASE_COUNT
+} StatPhase;
+
+/**
+ * Event counters.
+ */
+typedef enum {
+    STAT_UTMP_RECORDS,   /**< utmpx records read */
+    STAT_SESSIONS,       /**< USER_PROCESS sessions indexed */
+    STAT_PASSWD_LOOKUPS, /**< Lookups in the passwd cache */
+    STAT_PASSWD_HITS,    /**< Lookups answered by the passwd cache */
+    STAT_PASSWD_NSS,     /**< getpwnam() calls (cache misses) */
+    STAT_PASSWD_ENUM,    /**< Entries read by getpwent() or fgetpwent() */
+    STAT_PASSWD_INDEX,   /**< Lookups answered by the passwd index */
+    STAT_TIME_FORMATS,   /**< Minutes formatted (misses of the timefmt cache) */
+    STAT_TTY_PROBES,     /**< Terminals probed */
+    STAT_MAIL_PROBES,    /**< Mailboxes probed */
+    STAT_PLAN_PROBES,    /**< `.plan` files probed */
+    STAT_MAIL_SCANS,     /**< Mailboxes read to count the messages (count cache misses) */
+    STAT_WTMP_RECORDS,   /**< wtmp records examined for last logins */
+    STAT_PROC_READS,     /**< /proc/<pid>/stat files read */
+    STAT_SYS_STAT,       /**< stat() system calls */
+    STAT_SYS_STATX,      /**< statx requests submitted to io_uring */
+    STAT_SYS_URING,      /**< io_uring_setup() and io_uring_enter() system calls */
+    STAT_SYS_OPEN,       /**< open() system calls */
+    STAT_SYS_READ,       /**< read() system calls */
+    STAT_SYS_WRITE,      /**< writev() system calls */
+    STAT_COUNTER_COUNT
+} StatCounter;
+
+#ifndef MYFINGER_RELEASE
+
+extern int statsActive;
+extern uint64_t statPhaseNs[STAT_PHASE_COUNT];
+extern unsigned long statCounters[STAT_COUNTER_COUNT];
+
+/**
+ * Returns the monotonic clock in nanoseconds.
+ *
+ * @return The time in nanoseconds.
+ */
+uint64_t statNow(void);
+
+/** Starts timing a phase; the variable is local to the enclosing block. */
+#define STAT_BEGIN(phase) uint64_t statStart_##phase = statsActive ? statNow() : 0
+/** Adds the time elapsed since STAT_BEGIN(phase) to the phase; safe from several threads. */
+#define STAT_END(phase) \
+    do { if (statsActive) __atomic_fetch_add(&statPhaseNs[phase], statNow() - statStart_##phase, __ATOMIC_RELAXED); } while (0)
+/** Adds n to a counter; safe from several threads. */
+#define STAT_ADD(counter, n) \
+    do { if (statsActive) __atomic_fetch_add(&statCounters[counter], (n), __ATOMIC_RELAXED); } while (0)
+
+#else
+
+#define STAT_BEGIN(phase) do { } while (0)
+#define STAT_END(phase) do { } while (0)
+#define STAT_ADD(counter, n) do { } while (0)
+
+#endif
+
+/**
+ * Turns the instrumentation on and starts the total time.
+ *
+ * @return 0 on success, -1 if the program was built without instrumentation.
+ */
+int enableStats(void);
+
+/**
+ * Prints the phase timings and the counters.
+ *
+ * @param out The stream that receives the report.
+ * @param json 1 for a single JSON line, 0 for a table.
+ */
+void reportStats(FILE *out, int json);
+
+#endif
@@ -0,0 +1,274 @@
+#include <stdio.h> //Per snprintf()
+#include <string.h> //Per operazioni sulle stringhe
+#include <pthread.h> //Per pthread_once()
+#include "timefmt.h"
+#include "stats.h"
+
+/**
+ * UTC offset and zone abbreviation valid for a whole hour of UTC time.
+ */
+typedef struct {
+    long long hour;  /**< Hours since the epoch (UTC) */
+    int valid;       /**< 1 if the slot holds an hour */
+    long offset;     /**< Seconds east of UTC */
+    char zone[16];   /**< Zone abbreviation, as printed by %Z */
+} ZoneHour;
+
+/**
+ * The strings of one minute, in every supported format.
+ */
+typedef struct {
+    long long minute;      /**< Minutes since the epoch (UTC) */
+    int valid;             /**< 1 if the slot holds a minute */
+    char monthDay[8];      /**< "%b %d" */
+    char hoursMinutes[8];  /**< "%H:%M" */
+    char login[40];        /**< "%a %b %d %H:%M (%Z)" */
+    char mail[48];         /**< "%a %b %d %H:%M %Y (%Z)" */
+} MinuteStrings;
+
+static const char monthNames[12][4] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+static const char dayNames[7][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+
+static const char twoDigits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static pthread_once_t zoneOnce = PTHREAD_ONCE_INIT;
+static __thread ZoneHour zoneHours[TIME_CACHE_HOURS];
+static __thread MinuteStrings minuteStrings[TIME_CACHE_MINUTES];
+
+/**
+ * Reads the TZ variable and the zone files, once per run.
+ */
+static void loadZone(void) {
+    tzset();
+}
+
+/**
+ * Divides rounding towards minus infinity, for times before the epoch.
+ *
+ * @param value The dividend.
+ * @param divisor The divisor (positive).
+ * @return The quotient.
+ */
+static long long floorDiv(long long value, long long divisor) {
+    long long q = value / divisor;
+    return (value % divisor < 0) ? q - 1 : q;
+}
+
+/**
+ * Returns the UTC offset and the zone of the hour containing a time.
+ *
+ * @param when The time.
+ * @param offset Receives the seconds east of UTC.
+ * @return The zone abbreviation, or NULL if the offset changes inside the hour.
+ */
+static const char *zoneOfHour(time_t when, long *offset) {
+    long long hour = floorDiv(when, 3600);
+    ZoneHour *slot = &zoneHours[hour & (TIME_CACHE_HOURS - 1)];
+
+    if (!slot->valid || slot->hour != hour) {
+        //Inizio e fine dell'ora: se coincidono non c'è un cambio d'ora in mezzo
+        time_t start = hour * 3600, end = start + 3599;
+        struct tm first, last;
+        pthread_once(&zoneOnce, loadZone);
+        if (localtime_r(&start, &first) == NULL || localtime_r(&end, &last) == NULL ||
+            first.tm_gmtoff != last.tm_gmtoff || strcmp(first.tm_zone, last.tm_zone) != 0) {
+            return NULL;
+        }
+        slot->hour = hour;
+        slot->offset = first.tm_gmtoff;
+        snprintf(slot->zone, sizeof(slot->zone), "%s", first.tm_zone);
+        slot->valid = 1;
+    }
+    *offset = slot->offset;
+    return slot->zone;
+}
+
+/**
+ * Appends a number from 0 to 99 with two digits.
+ *
+ * @param p Where to write.
+ * @param value The number.
+ * @return The position after the digits.
+ */
+static char *putTwoDigits(char *p, int value) {
+    memcpy(p, twoDigits + 2 * value, 2);
+    return p + 2;
+}
+
+/**
+ * Appends a three-letter name followed by a space.
+ *
+ * @param p Where to write.
+ * @param name The name.
+ * @return The position after the space.
+ */
+static char *putName(char *p, const char *name) {
+    memcpy(p, name, 3);
+    p[3] = ' ';
+    return p + 4;
+}
+
+/**
+ * Fills the strings of a minute from the local date, computed with integer
+ * arithmetic (days to civil date, H. Hinnant).
+ *
+ * @param strings The strings to fill.
+ * @param local The time in seconds, already shifted to local time.
+ * @param zone The zone abbreviation.
+ * @return 0 on success, -1 if the year has not four digits.
+ */
+static int buildStrings(MinuteStrings *strings, long long local, const char *zone) {
+    long long days = floorDiv(local, 86400);
+    int secondOfDay = (int)(local - days * 86400);
+    int weekDay = (int)((days % 7 + 11) % 7); //1 gennaio 1970: giovedì
+
+    //Giorni dal 1° marzo dell'anno 0, in ere di 400 anni
+    long long z = days + 719468;
+    long long era = floorDiv(z, 146097);
+    unsigned dayOfEra = (unsigned)(z - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    int month = shiftedMonth < 10 ? shiftedMonth + 2 : shiftedMonth - 10;
+    long long year = yearOfEra + era * 400 + (month <= 1);
+    if (year < 1000 || year > 9999) return -1; //%Y senza zeri iniziali né segno: lasciato a strftime()
+
+    char *p = putName(strings->monthDay, monthNames[month]);
+    p = putTwoDigits(p, day);
+    *p = '\0';
+
+    p = putTwoDigits(strings->hoursMinutes, secondOfDay / 3600);
+    *p++ = ':';
+    p = putTwoDigits(p, secondOfDay / 60 % 60);
+    *p = '\0';
+
+    //"Mon Apr 05 15:30" è comune ai due formati lunghi
+    p = putName(strings->login, dayNames[weekDay]);
+    memcpy(p, strings->monthDay, 6);
+    p[6] = ' ';
+    memcpy(p + 7, strings->hoursMinutes, 5);
+    memcpy(strings->mail, strings->login, 16);
+    snprintf(strings->login + 16, sizeof(strings->login) - 16, " (%s)", zone);
+
+    p = strings->mail + 16;
+    *p++ = ' ';
+    p = putTwoDigits(p, (int)(year / 100));
+    p = putTwoDigits(p, (int)(year % 100));
+    snprintf(p, sizeof(strings->mail) - (p - strings->mail), " (%s)", zone);
+    return 0;
+}
+
+/**
+ * Fills the strings of a minute with localtime_r() and strftime(), for the
+ * hours with a change of offset and the years that need the general code.
+ *
+ * @param strings The strings to fill.
+ * @param when The time.
+ */
+static void buildStringsSlow(MinuteStrings *strings, time_t when) {
+    struct tm tm_info;
+    pthread_once(&zoneOnce, loadZone);
+    localtime_r(&when, &tm_info);
+    strftime(strings->monthDay, sizeof(strings->monthDay), "%b %d", &tm_info);
+    strftime(strings->hoursMinutes, sizeof(strings->hoursMinutes), "%H:%M", &tm_info);
+    strftime(strings->login, sizeof(strings->login), "%a %b %d %H:%M (%Z)", &tm_info);
+    strftime(strings->mail, sizeof(strings->mail), "%a %b %d %H:%M %Y (%Z)", &tm_info);
+}
+
+/**
+ * Returns the strings of the minute containing a time.
+ *
+ * @param when The time.
+ * @param scratch Filled and returned when the minute cannot be cached.
+ * @return The strings of the minute.
+ */
+static const MinuteStrings *stringsOf(time_t when, MinuteStrings *scratch) {
+    long long minute = floorDiv(when, 60);
+    MinuteStrings *slot = &minuteStrings[minute & (TIME_CACHE_MINUTES - 1)];
+    long offset;
+
+    if (slot->valid && slot->minute == minute) return slot;
+    STAT_ADD(STAT_TIME_FORMATS, 1);
+
+    //Con un offset che non è in minuti interi, due istanti dello stesso minuto UTC differiscono
+    const char *zone = zoneOfHour(when, &offset);
+    if (zone == NULL || offset % 60 != 0 || buildStrings(slot, (long long)when + offset, zone) != 0) {
+        buildStringsSlow(scratch, when);
+        return scratch;
+    }
+    slot->minute = minute;
+    slot->valid = 1;
+    return slot;
+}
+
+/**
+ * Copies a string into a caller buffer, truncating it if needed.
+ *
+ * @param buff The buffer.
+ * @param size The size of the buffer.
+ * @param s The string.
+ * @return The buffer.
+ */
+static char *copyString(char *buff, size_t size, const char *s) {
+    if (size > 0) snprintf(buff, size, "%s", s);
+    return buff;
+}
+
+/**
+ * Formats a time as strftime("%b %d"), e.g. "Apr 05".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatMonthDay(time_t when, char *buff, size_t size) {
+    MinuteStrings scratch;
+    return copyString(buff, size, stringsOf(when, &scratch)->monthDay);
+}
+
+/**
+ * Formats a time as strftime("%H:%M"), e.g. "15:30".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatHoursMinutes(time_t when, char *buff, size_t size) {
+    MinuteStrings scratch;
+    return copyString(buff, size, stringsOf(when, &scratch)->hoursMinutes);
+}
+
+/**
+ * Formats a time as strftime("%a %b %d %H:%M (%Z)"), e.g. "Mon Apr 05 15:30 (CET)".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatLoginTime(time_t when, char *buff, size_t size) {
+    MinuteStrings scratch;
+    return copyString(buff, size, stringsOf(when, &scratch)->login);
+}
+
+/**
+ * Formats a time as strftime("%a %b %d %H:%M %Y (%Z)"), e.g. "Mon Apr 05 15:30 2025 (CET)".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatMailTime(time_t when, char *buff, size_t size) {
+    MinuteStrings scratch;
+    return copyString(buff, size, stringsOf(when, &scratch)->mail);
+}
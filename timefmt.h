@@ -0,0 +1,67 @@
+// timefmt.h
+#ifndef TIMEFMT_H
+#define TIMEFMT_H
+
+#include <stddef.h> //Per size_t
+#include <time.h> //Per time_t
+
+/*
+ * Local time formatting without strftime(). The UTC offset and the zone
+ * abbreviation are resolved once per hour of UTC time (two localtime_r()
+ * calls, to detect a transition inside the hour) and the date is computed
+ * with integer arithmetic. The strings of each minute are kept in a small
+ * per-thread cache, so sessions that started in the same minute cost a lookup.
+ * The output is identical to strftime() in the C locale.
+ */
+
+/**
+ * Number of minutes kept in the per-thread cache (power of two).
+ */
+#define TIME_CACHE_MINUTES 256
+
+/**
+ * Number of hours whose UTC offset is kept in the per-thread cache (power of two).
+ */
+#define TIME_CACHE_HOURS 64
+
+/**
+ * Formats a time as strftime("%b %d"), e.g. "Apr 05".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatMonthDay(time_t when, char *buff, size_t size);
+
+/**
+ * Formats a time as strftime("%H:%M"), e.g. "15:30".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatHoursMinutes(time_t when, char *buff, size_t size);
+
+/**
+ * Formats a time as strftime("%a %b %d %H:%M (%Z)"), e.g. "Mon Apr 05 15:30 (CET)".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatLoginTime(time_t when, char *buff, size_t size);
+
+/**
+ * Formats a time as strftime("%a %b %d %H:%M %Y (%Z)"), e.g. "Mon Apr 05 15:30 2025 (CET)".
+ *
+ * @param when The time to format.
+ * @param buff The buffer that receives the string.
+ * @param size The size of the buffer.
+ * @return The buffer.
+ */
+char *formatMailTime(time_t when, char *buff, size_t size);
+
+#endif
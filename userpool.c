@@ -0,0 +1,161 @@
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <pthread.h> //Per il pool di thread
+#include "userpool.h"
+
+/**
+ * Output of one username, rendered by a worker.
+ */
+typedef struct {
+    OutBuf out;  /**< Rendered output, kept in memory */
+    int found;   /**< 1 if the user exists */
+    int done;    /**< 1 once the worker has finished */
+} UserResult;
+
+/**
+ * Shared state of the pool.
+ */
+typedef struct {
+    const FingerContext *ctx;  /**< Data of the run */
+    char *const *usernames;    /**< Usernames to handle */
+    size_t count;              /**< Number of usernames */
+    char mode;                 /**< Mode of the output */
+    UserResult *results;       /**< One result per username */
+    size_t next;               /**< Next username to take */
+    size_t written;            /**< Results already written by the main thread */
+    size_t window;             /**< Usernames that may be handled ahead of written */
+    pthread_mutex_t lock;      /**< Protects next, written and the done flags */
+    pthread_cond_t changed;    /**< Signalled when a result is done or written */
+} UserPool;
+
+/**
+ * Renders one username into its result.
+ *
+ * @param pool The pool.
+ * @param i The index of the username.
+ */
+static void renderUser(UserPool *pool, size_t i) {
+    UserResult *result = &pool->results[i];
+    const char *username = pool->usernames[i];
+    struct passwd *pwd = lookupPasswdShared(pool->ctx->cache, username);
+
+    initOutBuf(&result->out, -1);
+    result->found = pwd != NULL;
+    if (pwd != NULL) printUserEntry(&result->out, pool->ctx, username, pwd, pool->mode);
+}
+
+/**
+ * Worker of the pool: takes usernames in order until the list is exhausted,
+ * waiting when it is too far ahead of the output.
+ *
+ * @param arg The shared UserPool.
+ * @return Always NULL.
+ */
+static void *userWorker(void *arg) {
+    UserPool *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->next < pool->count && pool->next >= pool->written + pool->window) {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        if (pool->next >= pool->count) break;
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        renderUser(pool, i);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->results[i].done = 1;
+        pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Prints the message for a user that does not exist on stderr, after the
+ * output already rendered for the previous users.
+ *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param username The username that was not found.
+ */
+static void reportNotFound(OutBuf *out, OutBuf *err, const char *username) {
+    outFlush(out);
+    printUserNotFound(err, username);
+    outFlush(err);
+}
+
+/**
+ * Writes the result of a username after those before it.
+ *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param result The result to write, freed afterwards.
+ * @param username The username of the result.
+ */
+static void writeResult(OutBuf *out, OutBuf *err, UserResult *result, const char *username) {
+    for (size_t c = 0; c < result->out.chunkCount; c++) {
+        outWrite(out, result->out.chunks[c].data, result->out.chunks[c].len);
+    }
+    freeOutBuf(&result->out);
+    if (!result->found) reportNotFound(out, err, username);
+}
+
+/**
+ * Handles a list of usernames like handleUser() called for each one in turn,
+ * with a pool of worker threads.
+ *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param ctx The data of the run.
+ * @param usernames The usernames to handle.
+ * @param count The number of usernames.
+ * @param mode The mode to determine the level of detail to print.
+ */
+void handleUsers(OutBuf *out, OutBuf *err, const FingerContext *ctx, char *const *usernames, size_t count, char mode) {
+    size_t wanted = count < USER_POOL_MAX_THREADS ? count : USER_POOL_MAX_THREADS;
+    pthread_t threads[USER_POOL_MAX_THREADS];
+    size_t started = 0;
+    UserPool pool = {ctx, usernames, count, mode, NULL, 0, 0, wanted * USER_POOL_WINDOW};
+
+    //Un solo utente, o memoria esaurita: nessun thread, un utente dopo l'altro
+    if (count > 1) pool.results = calloc(count, sizeof(UserResult));
+    if (pool.results == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            if (handleUser(out, ctx, usernames[i], mode) != 0) reportNotFound(out, err, usernames[i]);
+        }
+        return;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.changed, NULL);
+    while (started < wanted && pthread_create(&threads[started], NULL, userWorker, &pool) == 0) started++;
+
+    //Il thread principale scrive i risultati nell'ordine degli argomenti man mano che sono pronti
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_lock(&pool.lock);
+        if (started == 0 && pool.next == i) {
+            //Nessun thread avviato: l'utente è gestito qui
+            pool.next++;
+            pthread_mutex_unlock(&pool.lock);
+            renderUser(&pool, i);
+            pthread_mutex_lock(&pool.lock);
+            pool.results[i].done = 1;
+        }
+        while (!pool.results[i].done) pthread_cond_wait(&pool.changed, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+
+        writeResult(out, err, &pool.results[i], usernames[i]);
+
+        pthread_mutex_lock(&pool.lock);
+        pool.written = i + 1;
+        pthread_cond_broadcast(&pool.changed);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_cond_destroy(&pool.changed);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.results);
+}
@@ -0,0 +1,37 @@
+// userpool.h
+#ifndef USERPOOL_H
+#define USERPOOL_H
+
+#include <stddef.h> //Per size_t
+#include "outbuf.h"
+#include "finger.h"
+
+/**
+ * Maximum number of worker threads handling the usernames of a run.
+ * The work is mostly waiting on NSS and on the disk, so it may exceed the CPUs.
+ */
+#define USER_POOL_MAX_THREADS 16
+
+/**
+ * Usernames each worker may handle ahead of the output, bounding the
+ * memory held by results that cannot be written yet.
+ */
+#define USER_POOL_WINDOW 4
+
+/**
+ * Handles a list of usernames like handleUser() called for each one in turn,
+ * with a pool of worker threads. Every user is rendered into its own buffer
+ * and the buffers are written in argument order, so the output is the same
+ * as the sequential one; a user that does not exist is reported on err at
+ * its position.
+ *
+ * @param out The buffer of the standard output.
+ * @param err The buffer of the standard error.
+ * @param ctx The data of the run.
+ * @param usernames The usernames to handle.
+ * @param count The number of usernames.
+ * @param mode The mode to determine the level of detail to print.
+ */
+void handleUsers(OutBuf *out, OutBuf *err, const FingerContext *ctx, char *const *usernames, size_t count, char mode);
+
+#endif
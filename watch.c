@@ -0,0 +1,328 @@
+#include <stdio.h> //Operazioni di input/output
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per i codici di errore
+#include <signal.h> //Per la gestione dei segnali
+#include <time.h> //Per la gestione del tempo
+#include <unistd.h> //Per STDOUT_FILENO
+#include <sys/ioctl.h> //Per le dimensioni del terminale
+#include "watch.h"
+#include "finger.h"
+#include "snapshot.h"
+
+/**
+ * A rendered screen: one NUL-terminated string per line.
+ */
+typedef struct {
+    char *text;           /**< The lines, one after the other */
+    size_t len;           /**< Bytes used in text */
+    size_t capacity;      /**< Bytes allocated for text */
+    size_t *lines;        /**< Offset of each line in text */
+    size_t lineCount;     /**< Number of lines */
+    size_t lineCapacity;  /**< Offsets allocated in lines */
+} WatchFrame;
+
+static volatile sig_atomic_t stopRequested = 0;
+static volatile sig_atomic_t resizeRequested = 0;
+
+/**
+ * Signal handler for SIGINT and SIGTERM.
+ *
+ * @param sig The signal number.
+ */
+static void requestStop(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+/**
+ * Signal handler for SIGWINCH.
+ *
+ * @param sig The signal number.
+ */
+static void requestResize(int sig) {
+    (void)sig;
+    resizeRequested = 1;
+}
+
+/**
+ * Reads the size of the terminal.
+ *
+ * @param rows Receives the number of rows, 0 if unknown.
+ * @param cols Receives the number of columns, 0 if unknown.
+ */
+static void terminalSize(size_t *rows, size_t *cols) {
+    struct winsize ws;
+    *rows = *cols = 0;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+        *rows = ws.ws_row;
+        *cols = ws.ws_col;
+    }
+}
+
+/**
+ * Appends a line to a frame, cut to the width of the terminal.
+ *
+ * @param frame The frame.
+ * @param s The text of the line (not necessarily NUL-terminated).
+ * @param len The length of the text.
+ * @param cols The columns of the terminal, 0 for no limit.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int addFrameLine(WatchFrame *frame, const char *s, size_t len, size_t cols) {
+    //L'ultima colonna resta libera: scriverci sposterebbe il cursore a capo in alcuni terminali
+    if (cols > 1 && len > cols - 1) {
+        len = cols - 1;
+        while (len > 0 && ((unsigned char)s[len] & 0xC0) == 0x80) len--; //Non taglia un carattere UTF-8
+    }
+    if (frame->lineCount == frame->lineCapacity) {
+        size_t capacity = frame->lineCapacity ? frame->lineCapacity * 2 : 64;
+        size_t *grown = realloc(frame->lines, capacity * sizeof(size_t));
+        if (grown == NULL) return -1;
+        frame->lines = grown;
+        frame->lineCapacity = capacity;
+    }
+    if (frame->len + len + 1 > frame->capacity) {
+        size_t capacity = frame->capacity ? frame->capacity : 4096;
+        while (capacity < frame->len + len + 1) capacity *= 2;
+        char *grown = realloc(frame->text, capacity);
+        if (grown == NULL) return -1;
+        frame->text = grown;
+        frame->capacity = capacity;
+    }
+    frame->lines[frame->lineCount++] = frame->len;
+    memcpy(frame->text + frame->len, s, len);
+    frame->text[frame->len + len] = '\0';
+    frame->len += len + 1;
+    return 0;
+}
+
+/**
+ * Splits the output rendered in memory into the lines of a frame.
+ *
+ * @param frame The frame, emptied first.
+ * @param out The output buffer, created with fd -1.
+ * @param cols The columns of the terminal, 0 for no limit.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int fillFrame(WatchFrame *frame, const OutBuf *out, size_t cols) {
+    char *line = malloc(out->total + 1);
+    size_t len = 0;
+
+    frame->len = 0;
+    frame->lineCount = 0;
+    if (line == NULL || out->error) {
+        free(line);
+        return -1;
+    }
+    //Le righe possono essere divise tra due blocchi del buffer
+    for (size_t c = 0; c < out->chunkCount; c++) {
+        for (size_t i = 0; i < out->chunks[c].len; i++) {
+            char ch = out->chunks[c].data[i];
+            if (ch != '\n') {
+                line[len++] = ch;
+            } else if (addFrameLine(frame, line, len, cols) != 0) {
+                free(line);
+                return -1;
+            } else {
+                len = 0;
+            }
+        }
+    }
+    int status = len > 0 ? addFrameLine(frame, line, len, cols) : 0;
+    free(line);
+    return status;
+}
+
+/**
+ * Appends the escape sequences that turn the previous frame into the next
+ * one: only the lines that changed are moved to and rewritten.
+ *
+ * @param out The buffer of the standard output.
+ * @param prev The frame on the screen, NULL if the screen must be redrawn.
+ * @param next The frame to show.
+ */
+static void drawFrame(OutBuf *out, const WatchFrame *prev, const WatchFrame *next) {
+    char move[32];
+
+    if (prev == NULL) outPuts(out, "\033[H\033[2J");
+    for (size_t i = 0; i < next->lineCount; i++) {
+        const char *line = next->text + next->lines[i];
+        if (prev != NULL && i < prev->lineCount && strcmp(line, prev->text + prev->lines[i]) == 0) continue;
+        snprintf(move, sizeof(move), "\033[%zu;1H", i + 1);
+        outPuts(out, move);
+        outPuts(out, line);
+        outPuts(out, "\033[K"); //Cancella il resto della riga precedente
+    }
+    //Righe in più del frame precedente
+    if (prev != NULL && prev->lineCount > next->lineCount) {
+        snprintf(move, sizeof(move), "\033[%zu;1H\033[J", next->lineCount + 1);
+        outPuts(out, move);
+    }
+}
+
+/**
+ * Fills the table with the sessions of the snapshot that fit on the screen,
+ * in utmpx order like listLoggedUsers().
+ *
+ * @param ctx The data of the run.
+ * @param table The session table, emptied first.
+ * @param limit The maximum number of sessions, 0 for no limit.
+ */
+static void loadVisibleSessions(const FingerContext *ctx, SessionTable *table, size_t limit) {
+    freeSessionTable(table);
+    initSessionTable(table, 0);
+    for (size_t i = 0; i < ctx->index->count && (limit == 0 || table->count < limit); i++) {
+        struct utmpx *ut = &ctx->index->sessions[i];
+        struct passwd *pwd = lookupPasswd(ctx->cache, ut->ut_user); //Voci già in cache, aggiornate da inotify
+        if (pwd != NULL && appendSession(table, ut, pwd) < 0) break;
+    }
+}
+
+/**
+ * Renders the status line and the list of the sessions into a frame.
+ *
+ * @param frame The frame to fill.
+ * @param ctx The data of the run.
+ * @param table The sessions on the screen, already probed.
+ * @param intervalMs The interval between two refreshes.
+ * @param cols The columns of the terminal, 0 for no limit.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int renderFrame(WatchFrame *frame, const FingerContext *ctx, const SessionTable *table,
+                       long intervalMs, size_t cols) {
+    OutBuf out;
+    char status[128], clockText[16];
+    time_t now = time(NULL);
+    struct tm tm_info;
+    ColumnLayout columns;
+
+    //Riga di stato: ora, utenti e sessioni totali anche se non tutte entrano nello schermo
+    localtime_r(&now, &tm_info);
+    strftime(clockText, sizeof(clockText), "%H:%M:%S", &tm_info);
+    snprintf(status, sizeof(status), "%s  %zu users, %zu sessions  (every %ld.%lds)\n", clockText,
+             ctx->index->userCount, ctx->index->count, intervalMs / 1000, intervalMs % 1000 / 100);
+
+    initOutBuf(&out, -1);
+    outPuts(&out, status);
+    modeColumns(&columns, 'w', COLUMN_SCOPE_LIST);
+    printSessionList(&out, table, &columns);
+    int result = fillFrame(frame, &out, cols);
+    freeOutBuf(&out);
+    return result;
+}
+
+/**
+ * Waits until a time of the monotonic clock, or until a signal arrives.
+ *
+ * @param deadline The time to wait for.
+ */
+static void sleepUntil(const struct timespec *deadline) {
+    while (!stopRequested && !resizeRequested) {
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) != EINTR) break;
+    }
+}
+
+/**
+ * Shows the list of the logged-in users, refreshed until SIGINT or SIGTERM.
+ *
+ * @param intervalMs The interval between two refreshes, in milliseconds.
+ * @return 0 on a clean exit, 1 on error.
+ */
+int runWatch(long intervalMs) {
+    LiveSnapshot live; //Sessioni e passwd aggiornate con inotify, senza rileggere i file a ogni giro
+    FingerContext ctx;
+    SessionTable table;
+    WatchFrame frames[2];
+    WatchFrame *prev = NULL, *next = &frames[0];
+    size_t rows, cols;
+    OutBuf out;
+    struct timespec deadline;
+    int status = 0;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = requestStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = requestResize;
+    sigaction(SIGWINCH, &sa, NULL);
+
+    if (openLiveSnapshot(&live) != 0) {
+        perror("myFinger: unable to watch the sessions");
+        return 1;
+    }
+    snapshotContext(&live, &ctx);
+    memset(frames, 0, sizeof(frames));
+    initSessionTable(&table, 0);
+    initOutBuf(&out, STDOUT_FILENO);
+    terminalSize(&rows, &cols);
+    //Sessioni lette dallo snapshot solo quando cambia o cambiano le righe del terminale
+    loadVisibleSessions(&ctx, &table, rows > 2 ? rows - 2 : 0);
+
+    outPuts(&out, "\033[?1049h\033[?25l"); //Schermo alternativo, cursore nascosto
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (!stopRequested) {
+        if (resizeRequested) {
+            resizeRequested = 0;
+            terminalSize(&rows, &cols);
+            loadVisibleSessions(&ctx, &table, rows > 2 ? rows - 2 : 0);
+            prev = NULL; //Dopo un ridimensionamento lo schermo è ridisegnato per intero
+        }
+
+        //I comandi cambiano da un giro all'altro: ogni tanto le righe sono ricostruite senza quelli vecchi
+        if (table.strings.len > WATCH_MAX_STRINGS) loadVisibleSessions(&ctx, &table, rows > 2 ? rows - 2 : 0);
+
+        //Solo i terminali delle sessioni visibili, tutti con un unico batch di stat
+        for (size_t i = 0; i < table.count; i++) {
+            table.idleSeconds[i] = -1;
+            table.what[i] = (StrRef){0, 0};
+        }
+        //Processi in primo piano: un solo passaggio su /proc per giro, qualunque sia il numero di sessioni
+        ProcessTable processes;
+        ctx.processes = loadProcessTable(&processes, NULL) == 0 ? &processes : NULL;
+        probeSessions(&ctx, &table);
+        if (ctx.processes != NULL) freeProcessTable(&processes);
+        ctx.processes = NULL;
+        if (renderFrame(next, &ctx, &table, intervalMs, cols) != 0) {
+            status = 1;
+            break;
+        }
+        drawFrame(&out, prev, next);
+        if (outFlush(&out) != 0) {
+            status = 1;
+            break;
+        }
+        prev = next;
+        next = next == &frames[0] ? &frames[1] : &frames[0];
+
+        deadline.tv_sec += intervalMs / 1000;
+        deadline.tv_nsec += intervalMs % 1000 * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        //Dopo una sospensione si riparte da ora invece di recuperare i giri persi
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (deadline.tv_sec < now.tv_sec || (deadline.tv_sec == now.tv_sec && deadline.tv_nsec < now.tv_nsec)) {
+            deadline = now;
+        }
+        sleepUntil(&deadline);
+
+        //utmpx o passwd modificati: si ricostruiscono solo le righe visibili
+        if (updateLiveSnapshot(&live) > 0) loadVisibleSessions(&ctx, &table, rows > 2 ? rows - 2 : 0);
+    }
+
+    outPuts(&out, "\033[?25h\033[?1049l"); //Ripristina cursore e schermo
+    outFlush(&out);
+    freeOutBuf(&out);
+    free(frames[0].text);
+    free(frames[0].lines);
+    free(frames[1].text);
+    free(frames[1].lines);
+    freeSessionTable(&table);
+    closeLiveSnapshot(&live);
+    return status;
+}
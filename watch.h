@@ -0,0 +1,34 @@
+// watch.h
+#ifndef WATCH_H
+#define WATCH_H
+
+/**
+ * Default interval between two refreshes of the watch view, in milliseconds.
+ */
+#define WATCH_INTERVAL_MS 1000
+
+/**
+ * Shortest interval accepted for -w, in milliseconds.
+ */
+#define WATCH_MIN_INTERVAL_MS 100
+
+/**
+ * Bytes of strings after which the rows on the screen are rebuilt, dropping
+ * the commands of the previous refreshes.
+ */
+#define WATCH_MAX_STRINGS (1 << 20)
+
+/**
+ * Shows the list of the logged-in users with the columns of a plain run and
+ * the command in the foreground of each terminal, like w, refreshed every
+ * intervalMs milliseconds until SIGINT or SIGTERM. Sessions and passwd
+ * entries come from a live snapshot kept current with inotify; each refresh
+ * stats only the terminals of the sessions that fit on the screen, walks
+ * /proc once and rewrites only the lines that changed since the previous one.
+ *
+ * @param intervalMs The interval between two refreshes, in milliseconds.
+ * @return 0 on a clean exit, 1 on error.
+ */
+int runWatch(long intervalMs);
+
+#endif
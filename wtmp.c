@@ -0,0 +1,518 @@
+#include <stdio.h> //Per fopen() e rename()
+#include <stdlib.h> //Per l'allocazione della memoria
+#include <string.h> //Per operazioni sulle stringhe
+#include <errno.h> //Per EINTR
+#include <fcntl.h> //Per open()
+#include <unistd.h> //Per pread(), close() e getpid()
+#include <utmpx.h> //Per i record di wtmp
+#include <sys/mman.h> //Per mappare l'indice
+#include <sys/stat.h> //Per lo stato di wtmp
+#include "wtmp.h"
+#include "lib.h"
+#include "stats.h"
+
+/**
+ * Slots of a new index (power of two).
+ */
+#define LAST_LOGIN_MIN_SLOTS 64
+
+/**
+ * Computes the hash of a login name (64-bit FNV-1a).
+ *
+ * @param login The login name.
+ * @return The hash value.
+ */
+static uint64_t hashLogin(const char *login) {
+    uint64_t hash = 14695981039346656037ull;
+    while (*login) {
+        hash ^= (unsigned char)*login++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Copies a field of a wtmp record, which may lack the terminator.
+ *
+ * @param dest The destination.
+ * @param size The size of the destination.
+ * @param src The field.
+ * @param len The size of the field.
+ */
+static void copyField(char *dest, size_t size, const char *src, size_t len) {
+    size_t n = strnlen(src, len);
+    if (n >= size) n = size - 1;
+    memcpy(dest, src, n);
+    dest[n] = '\0';
+}
+
+/**
+ * Tells whether a wtmp record is a login and extracts its login name.
+ *
+ * @param ut The record.
+ * @param login Receives the login name.
+ * @return 1 for a login, 0 for any other record.
+ */
+static int recordLogin(const struct utmpx *ut, char login[__UT_NAMESIZE + 1]) {
+    if (ut->ut_type != USER_PROCESS || ut->ut_user[0] == '\0' || ut->ut_tv.tv_sec <= 0) return 0;
+    copyField(login, __UT_NAMESIZE + 1, ut->ut_user, sizeof(ut->ut_user));
+    return 1;
+}
+
+/**
+ * Stores terminal, host and time of a login record.
+ *
+ * @param last The last login to fill.
+ * @param ut The record.
+ */
+static void fillLogin(LastLogin *last, const struct utmpx *ut) {
+    copyField(last->tty, sizeof(last->tty), ut->ut_line, sizeof(ut->ut_line));
+    copyField(last->host, sizeof(last->host), ut->ut_host, sizeof(ut->ut_host));
+    last->time = ut->ut_tv.tv_sec;
+}
+
+/**
+ * Reads consecutive records with pread(), retrying short reads.
+ *
+ * @param fd The descriptor of wtmp.
+ * @param records The buffer.
+ * @param count The number of records to read.
+ * @param offset The offset of the first record.
+ * @return The number of whole records read.
+ */
+static size_t readRecords(int fd, struct utmpx *records, size_t count, off_t offset) {
+    size_t want = count * sizeof(struct utmpx), got = 0;
+
+    while (got < want) {
+        ssize_t n = pread(fd, (char *)records + got, want - got, offset + (off_t)got);
+        STAT_ADD(STAT_SYS_READ, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    return got / sizeof(struct utmpx);
+}
+
+/**
+ * Compares a login name with a last login, for bsearch().
+ */
+static int compareKey(const void *key, const void *entry) {
+    return strcmp(key, ((const LastLogin *)entry)->login);
+}
+
+/**
+ * Orders last logins by login, for qsort().
+ */
+static int compareLogins(const void *a, const void *b) {
+    return strcmp(((const LastLogin *)a)->login, ((const LastLogin *)b)->login);
+}
+
+/**
+ * Writes the default path of the index.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int lastLoginIndexPath(char *buf, size_t size) {
+    return cacheFilePath(buf, size, "lastlogin-index");
+}
+
+/**
+ * Reads wtmp backwards and stops as soon as every login has been found.
+ *
+ * @param path The path of wtmp.
+ * @param logins The logins to resolve, sorted by login; those with a time of 0 are filled.
+ * @param count The number of logins.
+ * @return The number of logins found, or -1 if wtmp cannot be read.
+ */
+long scanLastLogins(const char *path, LastLogin logins[], size_t count) {
+    size_t remaining = 0;
+    long found = 0;
+    struct stat st;
+
+    for (size_t i = 0; i < count; i++) remaining += logins[i].time == 0;
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct utmpx *records = fstat(fd, &st) == 0 ? malloc(WTMP_CHUNK_RECORDS * sizeof(struct utmpx)) : NULL;
+    if (records == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    //Dalla fine verso l'inizio: il primo record incontrato per un login è il suo ultimo accesso
+    STAT_BEGIN(STAT_PHASE_WTMP);
+    off_t end = st.st_size - st.st_size % (off_t)sizeof(struct utmpx); //Un record a metà (scrittura in corso) è ignorato
+    while (remaining > 0 && end > 0) {
+        size_t wanted = (size_t)(end / (off_t)sizeof(struct utmpx));
+        if (wanted > WTMP_CHUNK_RECORDS) wanted = WTMP_CHUNK_RECORDS;
+        off_t start = end - (off_t)(wanted * sizeof(struct utmpx));
+        size_t n = readRecords(fd, records, wanted, start);
+        if (n < wanted) break; //File troncato o ruotato durante la lettura
+        STAT_ADD(STAT_WTMP_RECORDS, n);
+        for (size_t i = n; i-- > 0 && remaining > 0;) {
+            char login[__UT_NAMESIZE + 1];
+            if (!recordLogin(&records[i], login)) continue;
+            LastLogin *last = bsearch(login, logins, count, sizeof(LastLogin), compareKey);
+            if (last != NULL && last->time == 0) {
+                fillLogin(last, &records[i]);
+                remaining--;
+            }
+        }
+        end = start;
+    }
+    STAT_END(STAT_PHASE_WTMP);
+
+    free(records);
+    close(fd);
+    for (size_t i = 0; i < count; i++) found += logins[i].time != 0;
+    return found;
+}
+
+/**
+ * Finds the slot of a login in the table of the index.
+ *
+ * @param index The index, with at least one slot.
+ * @param login The login name.
+ * @return The slot holding the login, or the free slot where it would go;
+ *         slotCount if the table is full (only in a damaged file).
+ */
+static size_t findSlot(const LastLoginIndex *index, const char *login) {
+    size_t mask = index->header.slotCount - 1;
+    size_t slot = hashLogin(login) & mask;
+
+    for (size_t probes = 0; probes < index->header.slotCount; probes++) {
+        const LastLogin *last = &index->slots[slot];
+        if (last->login[0] == '\0' || strncmp(last->login, login, sizeof(last->login)) == 0) return slot;
+        slot = (slot + 1) & mask;
+    }
+    return index->header.slotCount;
+}
+
+/**
+ * Doubles the table of the index (or allocates the first one).
+ *
+ * @param index The index, with an allocated table.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int growIndex(LastLoginIndex *index) {
+    LastLoginIndex grown = *index;
+    grown.header.slotCount = index->header.slotCount ? index->header.slotCount * 2 : LAST_LOGIN_MIN_SLOTS;
+    grown.slots = calloc(grown.header.slotCount, sizeof(LastLogin));
+    if (grown.slots == NULL) return -1;
+    for (size_t i = 0; i < index->header.slotCount; i++) {
+        if (index->slots[i].login[0] != '\0') grown.slots[findSlot(&grown, index->slots[i].login)] = index->slots[i];
+    }
+    free(index->slots);
+    *index = grown;
+    return 0;
+}
+
+/**
+ * Records a wtmp record in the table if it is a login newer than the one known.
+ *
+ * @param index The index, with an allocated table.
+ * @param ut The record.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int storeLogin(LastLoginIndex *index, const struct utmpx *ut) {
+    char login[__UT_NAMESIZE + 1];
+
+    if (!recordLogin(ut, login)) return 0;
+    //Al massimo metà degli slot occupati: le ricerche restano brevi
+    if ((index->header.count + 1) * 2 > index->header.slotCount && growIndex(index) != 0) return -1;
+    LastLogin *last = &index->slots[findSlot(index, login)];
+    if (last->login[0] == '\0') {
+        strcpy(last->login, login);
+        index->header.count++;
+    } else if (ut->ut_tv.tv_sec < last->time) {
+        return 0; //Record fuori ordine (es. orologio corretto all'indietro): resta il più recente
+    }
+    fillLogin(last, ut);
+    return 0;
+}
+
+/**
+ * Applies the records of a range of wtmp to the table, in file order.
+ *
+ * @param index The index, with an allocated table.
+ * @param fd The descriptor of wtmp.
+ * @param from The offset of the first record.
+ * @param to The offset after the last record.
+ * @return 0 on success, -1 if the file could not be read or memory allocated.
+ */
+static int applyWtmp(LastLoginIndex *index, int fd, off_t from, off_t to) {
+    struct utmpx *records = malloc(WTMP_CHUNK_RECORDS * sizeof(struct utmpx));
+    int result = records != NULL ? 0 : -1;
+
+    while (result == 0 && from < to) {
+        size_t wanted = (size_t)((to - from) / (off_t)sizeof(struct utmpx));
+        if (wanted > WTMP_CHUNK_RECORDS) wanted = WTMP_CHUNK_RECORDS;
+        size_t n = readRecords(fd, records, wanted, from);
+        if (n < wanted) result = -1;
+        STAT_ADD(STAT_WTMP_RECORDS, n);
+        for (size_t i = 0; result == 0 && i < n; i++) result = storeLogin(index, &records[i]);
+        from += (off_t)(wanted * sizeof(struct utmpx));
+    }
+    free(records);
+    return result;
+}
+
+/**
+ * Applies the records that the index had not read yet from the file that
+ * wtmp was rotated to ("wtmp.1"), if that is the file the index followed.
+ *
+ * @param index The index, with an allocated table.
+ * @param wtmpPath The path of wtmp.
+ * @return 0 on success (also when there is no such file), -1 on error.
+ */
+static int applyRotated(LastLoginIndex *index, const char *wtmpPath) {
+    char rotated[512];
+    struct stat st;
+    int result = 0;
+
+    if (snprintf(rotated, sizeof(rotated), "%s.1", wtmpPath) >= (int)sizeof(rotated)) return 0;
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(rotated, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_dev == index->header.wtmpDevice &&
+        (uint64_t)st.st_ino == index->header.wtmpInode) {
+        off_t end = st.st_size - st.st_size % (off_t)sizeof(struct utmpx);
+        if ((off_t)index->header.wtmpOffset < end) result = applyWtmp(index, fd, (off_t)index->header.wtmpOffset, end);
+    }
+    close(fd);
+    return result;
+}
+
+/**
+ * Maps the index file if it is valid.
+ *
+ * @param index The LastLoginIndex structure to populate.
+ * @param path The path of the index.
+ * @return 0 on success, -1 if the file is missing or invalid.
+ */
+static int mapIndex(LastLoginIndex *index, const char *path) {
+    struct stat st;
+
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || st.st_uid != geteuid() || (size_t)st.st_size < sizeof(LastLoginIndexHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    //Il file deve contenere esattamente la tabella annunciata dall'intestazione
+    const LastLoginIndexHeader *header = map;
+    uint32_t slots = header->slotCount;
+    if (memcmp(header->magic, LAST_LOGIN_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != LAST_LOGIN_INDEX_VERSION || slots == 0 || (slots & (slots - 1)) != 0 ||
+        header->count >= slots ||
+        sizeof(LastLoginIndexHeader) + (uint64_t)slots * sizeof(LastLogin) != (uint64_t)st.st_size) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    index->map = map;
+    index->size = st.st_size;
+    index->header = *header;
+    index->slots = (LastLogin *)((char *)map + sizeof(LastLoginIndexHeader));
+    return 0;
+}
+
+/**
+ * Copies a mapped table into memory, so records can be added to it.
+ *
+ * @param index The index.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+static int detachIndex(LastLoginIndex *index) {
+    if (index->map == NULL) return 0;
+    LastLogin *slots = malloc(index->header.slotCount * sizeof(LastLogin));
+    if (slots == NULL) return -1;
+    memcpy(slots, index->slots, index->header.slotCount * sizeof(LastLogin));
+    munmap(index->map, index->size);
+    index->map = NULL;
+    index->size = 0;
+    index->slots = slots;
+    return 0;
+}
+
+/**
+ * Writes the index to a temporary file and renames it over the old one.
+ *
+ * @param path The path of the index.
+ * @param index The index, with an allocated table.
+ * @return 0 on success, -1 on error.
+ */
+static int writeIndex(const char *path, const LastLoginIndex *index) {
+    char tmp[512];
+
+    if (snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmp)) return -1;
+    makeParentDirectories(path);
+    FILE *out = fopen(tmp, "wb");
+    if (out == NULL) return -1;
+    int ok = fwrite(&index->header, sizeof(LastLoginIndexHeader), 1, out) == 1 &&
+             fwrite(index->slots, sizeof(LastLogin), index->header.slotCount, out) == index->header.slotCount;
+    //Chi sta leggendo il vecchio indice tiene la sua mappatura
+    if (fclose(out) != 0 || !ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Opens the index and applies the wtmp records appended since the last run.
+ *
+ * @param index The LastLoginIndex structure to populate.
+ * @param path The path of the index.
+ * @param wtmpPath The path of wtmp.
+ * @param create 1 to build the index when it is missing or invalid.
+ * @return 0 on success, -1 if there is no usable index.
+ */
+int openLastLoginIndex(LastLoginIndex *index, const char *path, const char *wtmpPath, int create) {
+    LastLoginIndexHeader *header = &index->header;
+    struct stat st;
+
+    memset(index, 0, sizeof(*index));
+    if (mapIndex(index, path) != 0) {
+        if (!create) return -1;
+        memcpy(header->magic, LAST_LOGIN_INDEX_MAGIC, sizeof(header->magic));
+        header->version = LAST_LOGIN_INDEX_VERSION;
+    }
+
+    STAT_ADD(STAT_SYS_OPEN, 1);
+    int fd = open(wtmpPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        //Senza wtmp l'indice resta quello dell'ultima esecuzione
+        if (fd >= 0) close(fd);
+        if (index->map != NULL) return 0;
+        closeLastLoginIndex(index);
+        return -1;
+    }
+    off_t end = st.st_size - st.st_size % (off_t)sizeof(struct utmpx);
+    int same = header->wtmpDevice == (uint64_t)st.st_dev && header->wtmpInode == (uint64_t)st.st_ino;
+    if (index->map != NULL && same && header->wtmpOffset == (uint64_t)end) {
+        close(fd); //Nessun record nuovo: basta la mappatura
+        return 0;
+    }
+
+    //Solo i record nuovi; un file più corto di prima è stato troncato e si rilegge da capo
+    STAT_BEGIN(STAT_PHASE_WTMP);
+    int failed = detachIndex(index) != 0 || (header->slotCount == 0 && growIndex(index) != 0);
+    if (!failed && !same && header->wtmpInode != 0) failed = applyRotated(index, wtmpPath) != 0;
+    off_t from = same && header->wtmpOffset <= (uint64_t)end ? (off_t)header->wtmpOffset : 0;
+    if (!failed) failed = applyWtmp(index, fd, from, end) != 0;
+    STAT_END(STAT_PHASE_WTMP);
+    close(fd);
+    if (failed) {
+        closeLastLoginIndex(index);
+        return -1;
+    }
+    header->wtmpDevice = st.st_dev;
+    header->wtmpInode = st.st_ino;
+    header->wtmpOffset = end;
+
+    //Se la cartella di cache non è scrivibile l'indice aggiornato vale solo per questa esecuzione
+    if (writeIndex(path, index) != 0 && create) {
+        closeLastLoginIndex(index);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Looks up a login in the index.
+ *
+ * @param index The open index.
+ * @param login The login name.
+ * @return The last login, or NULL if the user never logged in.
+ */
+const LastLogin *findLastLoginIndex(const LastLoginIndex *index, const char *login) {
+    if (index->header.slotCount == 0 || login[0] == '\0' || strlen(login) >= sizeof(index->slots->login)) return NULL;
+    size_t slot = findSlot(index, login);
+    if (slot == index->header.slotCount || index->slots[slot].login[0] == '\0') return NULL;
+    return &index->slots[slot];
+}
+
+/**
+ * Releases the index.
+ *
+ * @param index The index to close.
+ */
+void closeLastLoginIndex(LastLoginIndex *index) {
+    if (index->map != NULL) munmap(index->map, index->size);
+    else free(index->slots);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * Finds the last login of a list of users, from the index or with one scan of wtmp.
+ *
+ * @param set The LastLoginSet structure to populate.
+ * @param logins The login names, duplicates allowed.
+ * @param count The number of names.
+ * @param wtmpPath The path of wtmp.
+ * @param indexPath The path of the index, NULL to always scan wtmp.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int resolveLastLogins(LastLoginSet *set, const char *const logins[], size_t count, const char *wtmpPath,
+                      const char *indexPath) {
+    LastLoginIndex index;
+
+    set->count = 0;
+    set->logins = calloc(count ? count : 1, sizeof(LastLogin));
+    if (set->logins == NULL) return -1;
+    //Un nome più lungo di quelli di wtmp non può avere login
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(logins[i]) < sizeof(set->logins->login)) strcpy(set->logins[set->count++].login, logins[i]);
+    }
+    if (set->count > 1) qsort(set->logins, set->count, sizeof(LastLogin), compareLogins);
+    size_t unique = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        if (unique == 0 || strcmp(set->logins[unique - 1].login, set->logins[i].login) != 0) {
+            set->logins[unique++] = set->logins[i];
+        }
+    }
+    set->count = unique;
+    if (set->count == 0) return 0;
+
+    if (indexPath != NULL && openLastLoginIndex(&index, indexPath, wtmpPath, 0) == 0) {
+        for (size_t i = 0; i < set->count; i++) {
+            const LastLogin *last = findLastLoginIndex(&index, set->logins[i].login);
+            if (last != NULL) set->logins[i] = *last;
+        }
+        closeLastLoginIndex(&index);
+    } else {
+        scanLastLogins(wtmpPath, set->logins, set->count); //wtmp illeggibile: nessun login noto
+    }
+    return 0;
+}
+
+/**
+ * Looks up a login in a set.
+ *
+ * @param set The resolved set.
+ * @param login The login name.
+ * @return The last login, or NULL if the login is not in the set or never logged in.
+ */
+const LastLogin *findLastLogin(const LastLoginSet *set, const char *login) {
+    if (set->count == 0) return NULL;
+    const LastLogin *last = bsearch(login, set->logins, set->count, sizeof(LastLogin), compareKey);
+    return last != NULL && last->time != 0 ? last : NULL;
+}
+
+/**
+ * Releases the memory held by a set.
+ *
+ * @param set The set to free.
+ */
+void freeLastLoginSet(LastLoginSet *set) {
+    free(set->logins);
+    set->logins = NULL;
+    set->count = 0;
+}
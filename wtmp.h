@@ -0,0 +1,149 @@
+// wtmp.h
+#ifndef WTMP_H
+#define WTMP_H
+
+#include <stddef.h> //Per size_t
+#include <stdint.h> //Per i tipi a larghezza fissa
+
+/**
+ * History of the logins, read for the users who are not logged in.
+ */
+#define WTMP_FILE "/var/log/wtmp"
+
+/**
+ * Records read by each pread() of a scan (1.5 MiB with 384-byte records).
+ */
+#define WTMP_CHUNK_RECORDS 4096
+
+/**
+ * Identifies the last-login index file and its layout.
+ */
+#define LAST_LOGIN_INDEX_MAGIC "MFLL"
+#define LAST_LOGIN_INDEX_VERSION 1
+
+/**
+ * The last login of a user. It is also the record of the index file.
+ */
+typedef struct {
+    char login[40];  /**< Login name, empty for a free slot of the index */
+    char tty[40];    /**< Terminal of the login */
+    char host[64];   /**< Remote host, truncated; empty for a local login */
+    int64_t time;    /**< Time of the login, 0 if the user never logged in */
+} LastLogin;
+
+/**
+ * Header of the index file, followed by slotCount LastLogin records: an open
+ * addressing table keyed by login, so a lookup reads one or two records.
+ * The offset tells how much of wtmp is already in the table; the next run
+ * only reads the records appended after it.
+ */
+typedef struct {
+    char magic[4];        /**< LAST_LOGIN_INDEX_MAGIC */
+    uint32_t version;     /**< LAST_LOGIN_INDEX_VERSION */
+    uint64_t wtmpDevice;  /**< Device of the wtmp file read last */
+    uint64_t wtmpInode;   /**< Inode of the wtmp file read last */
+    uint64_t wtmpOffset;  /**< Bytes of that file already applied */
+    uint32_t count;       /**< Number of logins */
+    uint32_t slotCount;   /**< Number of records (power of two) */
+} LastLoginIndexHeader;
+
+/**
+ * The last-login index, mapped if it is current, otherwise brought up to
+ * date in memory.
+ */
+typedef struct {
+    void *map;                    /**< Mapping of the file, NULL if the table is allocated */
+    size_t size;                  /**< Size of the mapping */
+    LastLoginIndexHeader header;  /**< State of the table */
+    LastLogin *slots;             /**< The table, into the mapping or allocated */
+} LastLoginIndex;
+
+/**
+ * Last logins of a set of users, sorted by login.
+ */
+typedef struct {
+    LastLogin *logins;  /**< One per distinct login */
+    size_t count;       /**< Number of logins */
+} LastLoginSet;
+
+/**
+ * Writes the default path of the index: $XDG_CACHE_HOME/myFinger/lastlogin-index,
+ * or ~/.cache/myFinger/lastlogin-index.
+ *
+ * @param buf The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @return 0 on success, -1 if neither variable is set or the path does not fit.
+ */
+int lastLoginIndexPath(char *buf, size_t size);
+
+/**
+ * Reads wtmp backwards, WTMP_CHUNK_RECORDS records at a time, and stops as
+ * soon as every login has been found.
+ *
+ * @param path The path of wtmp.
+ * @param logins The logins to resolve, sorted by login; those with a time of 0 are filled.
+ * @param count The number of logins.
+ * @return The number of logins found, or -1 if wtmp cannot be read.
+ */
+long scanLastLogins(const char *path, LastLogin logins[], size_t count);
+
+/**
+ * Opens the index and applies the wtmp records appended since the last run
+ * (also those left in "wtmp.1" after a rotation), rewriting the file if any
+ * were. A missing index is built from the whole of wtmp only if create is set.
+ *
+ * @param index The LastLoginIndex structure to populate.
+ * @param path The path of the index.
+ * @param wtmpPath The path of wtmp.
+ * @param create 1 to build the index when it is missing or invalid.
+ * @return 0 on success, -1 if there is no usable index.
+ */
+int openLastLoginIndex(LastLoginIndex *index, const char *path, const char *wtmpPath, int create);
+
+/**
+ * Looks up a login in the index.
+ *
+ * @param index The open index.
+ * @param login The login name.
+ * @return The last login, or NULL if the user never logged in.
+ */
+const LastLogin *findLastLoginIndex(const LastLoginIndex *index, const char *login);
+
+/**
+ * Releases the index.
+ *
+ * @param index The index to close.
+ */
+void closeLastLoginIndex(LastLoginIndex *index);
+
+/**
+ * Finds the last login of a list of users: from the index if there is one,
+ * otherwise with a single backwards scan of wtmp for all of them.
+ *
+ * @param set The LastLoginSet structure to populate.
+ * @param logins The login names, duplicates allowed.
+ * @param count The number of names.
+ * @param wtmpPath The path of wtmp.
+ * @param indexPath The path of the index, NULL to always scan wtmp.
+ * @return 0 on success, -1 if memory could not be allocated.
+ */
+int resolveLastLogins(LastLoginSet *set, const char *const logins[], size_t count, const char *wtmpPath,
+                      const char *indexPath);
+
+/**
+ * Looks up a login in a set.
+ *
+ * @param set The resolved set.
+ * @param login The login name.
+ * @return The last login, or NULL if the login is not in the set or never logged in.
+ */
+const LastLogin *findLastLogin(const LastLoginSet *set, const char *login);
+
+/**
+ * Releases the memory held by a set.
+ *
+ * @param set The set to free.
+ */
+void freeLastLoginSet(LastLoginSet *set);
+
+#endif